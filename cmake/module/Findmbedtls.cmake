@@ -155,11 +155,17 @@ set(MBEDTLS_LIBRARIES ${MBEDTLS_CRYPTO_LIBRARY} ${MBEDTLS_X509_LIBRARY} ${MBEDTL
 # Mark Variables As Advanced
 mark_as_advanced(MBEDTLS_INCLUDE_DIR MBEDTLS_LIBRARIES MBEDTLS_CRYPTO_LIBRARY MBEDTLS_X509_LIBRARY MBEDTLS_SSL_LIBRARY MBEDTLS_TLS_LIBRARY)
 
-# Find Version File
-if(MBEDTLS_INCLUDE_DIR AND EXISTS "${MBEDTLS_INCLUDE_DIR}/mbedtls/version.h")
+# Find Version File (Mbed TLS 3.x defines version in build_info.h)
+if(MBEDTLS_INCLUDE_DIR AND EXISTS "${MBEDTLS_INCLUDE_DIR}/mbedtls/build_info.h")
+    set(MBEDTLS_VERSION_FILE "${MBEDTLS_INCLUDE_DIR}/mbedtls/build_info.h")
+elseif(MBEDTLS_INCLUDE_DIR AND EXISTS "${MBEDTLS_INCLUDE_DIR}/mbedtls/version.h")
+    set(MBEDTLS_VERSION_FILE "${MBEDTLS_INCLUDE_DIR}/mbedtls/version.h")
+endif()
+
+if(MBEDTLS_VERSION_FILE)
 
     # Get Version From File
-    file(STRINGS "${MBEDTLS_INCLUDE_DIR}/mbedtls/version.h" VERSIONH REGEX "#define MBEDTLS_VERSION_STRING[ ]+\".*\"")
+    file(STRINGS "${MBEDTLS_VERSION_FILE}" VERSIONH REGEX "#define MBEDTLS_VERSION_STRING[ ]+\".*\"")
 
     # Match Version String
     string(REGEX REPLACE ".*\".*([0-9]+)\\.([0-9]+)\\.([0-9]+)\"" "\\1;\\2;\\3" MBEDTLS_VERSION_LIST "${VERSIONH}")
@@ -0,0 +1,487 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "Allocator.hpp"
+
+#include "mbedtls/platform.h"
+#include "mbedtls/ssl.h"
+
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !(defined(MBEDTLS_PLATFORM_CALLOC_MACRO) && defined(MBEDTLS_PLATFORM_FREE_MACRO))
+#define OATPP_MBEDTLS_ALLOCATOR_AVAILABLE
+#endif
+
+namespace oatpp { namespace mbedtls {
+
+namespace {
+
+/* Header in front of every block - 16 bytes keep user memory aligned the same as malloc does */
+struct BlockHeader {
+  v_uint64 sizeClass;
+  v_uint64 size;
+};
+
+static_assert(sizeof(BlockHeader) == 16, "BlockHeader must be 16 bytes");
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head;
+  v_int64 count;
+};
+
+constexpr v_uint64 ROUNDED_CLASSES_COUNT = 19;
+constexpr v_uint64 EXACT_CLASSES_COUNT = 2;
+constexpr v_uint64 CLASSES_COUNT = ROUNDED_CLASSES_COUNT + EXACT_CLASSES_COUNT;
+constexpr v_uint64 LARGE_CLASS = CLASSES_COUNT;
+
+/* Largest block which may get an exact size class */
+constexpr v_buff_size EXACT_CLASS_MAX_SIZE = 64 * 1024;
+
+struct Pool {
+  std::mutex lock;
+  FreeList list;
+};
+
+struct State {
+
+  Pool pools[CLASSES_COUNT];
+
+  v_buff_size threadCacheSize;
+  v_buff_size poolSize;
+
+  std::atomic<v_int64> allocations;
+  std::atomic<v_int64> frees;
+  std::atomic<v_int64> cacheHits;
+  std::atomic<v_int64> poolHits;
+  std::atomic<v_int64> systemAllocations;
+  std::atomic<v_int64> bytesInUse;
+  std::atomic<v_int64> bytesPooled;
+
+  /*
+   * Sizes of exact classes - record buffers of a TLS context (about 16.7 KB each).
+   * Rounding them up to a 1.5x class would waste 8 KB per buffer.
+   * Measured by install() with a throwaway TLS context and never changed after.
+   */
+  v_buff_size exactSizes[EXACT_CLASSES_COUNT];
+  bool measuringExactSizes;
+
+  std::atomic<bool> installed;
+
+  State()
+    : threadCacheSize(0)
+    , poolSize(0)
+    , allocations(0)
+    , frees(0)
+    , cacheHits(0)
+    , poolHits(0)
+    , systemAllocations(0)
+    , bytesInUse(0)
+    , bytesPooled(0)
+    , measuringExactSizes(false)
+    , installed(false)
+  {
+    for(auto& pool : pools) {
+      pool.list.head = nullptr;
+      pool.list.count = 0;
+    }
+    for(auto& exactSize : exactSizes) {
+      exactSize = 0;
+    }
+  }
+
+};
+
+/* Never destroyed - threads may free blocks while the process exits */
+State& state() {
+  static State* instance = new State();
+  return *instance;
+}
+
+/* 32, 48, 64, 96, ... 12288, 16384 bytes - header included. Then exact classes */
+v_buff_size classSize(v_uint64 sizeClass) {
+  if(sizeClass >= ROUNDED_CLASSES_COUNT) {
+    return state().exactSizes[sizeClass - ROUNDED_CLASSES_COUNT];
+  }
+  v_buff_size base = (v_buff_size) 32 << (sizeClass / 2);
+  return (sizeClass % 2 == 0) ? base : base + base / 2;
+}
+
+v_uint64 classOf(v_buff_size size) {
+  for(v_uint64 i = 0; i < ROUNDED_CLASSES_COUNT; i ++) {
+    if(size <= classSize(i)) {
+      return i;
+    }
+  }
+  if(size > EXACT_CLASS_MAX_SIZE) {
+    return LARGE_CLASS;
+  }
+  auto& s = state();
+  for(v_uint64 i = 0; i < EXACT_CLASSES_COUNT; i ++) {
+    if(s.exactSizes[i] == size) {
+      return ROUNDED_CLASSES_COUNT + i;
+    }
+  }
+  /* Only record buffers of the throwaway TLS context of install() are allocated while sizes are measured */
+  if(s.measuringExactSizes) {
+    for(v_uint64 i = 0; i < EXACT_CLASSES_COUNT; i ++) {
+      if(s.exactSizes[i] == 0) {
+        s.exactSizes[i] = size;
+        return ROUNDED_CLASSES_COUNT + i;
+      }
+    }
+  }
+  return LARGE_CLASS;
+}
+
+v_int64 cacheLimit(v_uint64 sizeClass) {
+  v_int64 limit = state().threadCacheSize / classSize(sizeClass);
+  return limit < 2 ? 2 : limit;
+}
+
+/* Move count blocks from the head of the local list to the shared pool. Blocks which don't fit the pool are freed */
+void pushToPool(v_uint64 sizeClass, FreeList& local, v_int64 count) {
+
+  auto& s = state();
+
+  FreeBlock* first = local.head;
+  FreeBlock* last = first;
+  for(v_int64 i = 1; i < count; i ++) {
+    last = last->next;
+  }
+  local.head = last->next;
+  local.count -= count;
+  last->next = nullptr;
+
+  v_int64 bytes = count * classSize(sizeClass);
+
+  if(s.bytesPooled.fetch_add(bytes, std::memory_order_relaxed) + bytes > s.poolSize) {
+    s.bytesPooled.fetch_sub(bytes, std::memory_order_relaxed);
+    while(first != nullptr) {
+      auto next = first->next;
+      std::free(first);
+      first = next;
+    }
+    return;
+  }
+
+  auto& pool = s.pools[sizeClass];
+  std::lock_guard<std::mutex> lock(pool.lock);
+  last->next = pool.list.head;
+  pool.list.head = first;
+  pool.list.count += count;
+
+}
+
+/* Move up to count blocks from the shared pool to the local list */
+bool pullFromPool(v_uint64 sizeClass, FreeList& local, v_int64 count) {
+
+  auto& s = state();
+  auto& pool = s.pools[sizeClass];
+
+  FreeBlock* first;
+  v_int64 taken = 1;
+
+  {
+
+    std::lock_guard<std::mutex> lock(pool.lock);
+
+    if(pool.list.head == nullptr) {
+      return false;
+    }
+
+    first = pool.list.head;
+    FreeBlock* last = first;
+    while(taken < count && last->next != nullptr) {
+      last = last->next;
+      taken ++;
+    }
+
+    pool.list.head = last->next;
+    pool.list.count -= taken;
+    last->next = local.head;
+
+  }
+
+  local.head = first;
+  local.count += taken;
+
+  s.bytesPooled.fetch_sub(taken * classSize(sizeClass), std::memory_order_relaxed);
+
+  return true;
+
+}
+
+thread_local bool t_cacheDestroyed = false;
+
+class ThreadCache {
+public:
+
+  FreeList lists[CLASSES_COUNT];
+
+  ThreadCache() {
+    for(auto& list : lists) {
+      list.head = nullptr;
+      list.count = 0;
+    }
+  }
+
+  ~ThreadCache() {
+    t_cacheDestroyed = true;
+    for(v_uint64 i = 0; i < CLASSES_COUNT; i ++) {
+      if(lists[i].count > 0) {
+        pushToPool(i, lists[i], lists[i].count);
+      }
+    }
+  }
+
+};
+
+/* nullptr once the thread is exiting and its cache is gone */
+ThreadCache* threadCache() {
+  if(t_cacheDestroyed) {
+    return nullptr;
+  }
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+void* allocate(size_t nmemb, size_t size) {
+
+  if(size != 0 && nmemb > (SIZE_MAX - sizeof(BlockHeader)) / size) {
+    return nullptr;
+  }
+
+  auto& s = state();
+
+  size_t length = nmemb * size;
+  v_buff_size total = (v_buff_size) (length + sizeof(BlockHeader));
+  v_uint64 sizeClass = classOf(total);
+
+  s.allocations.fetch_add(1, std::memory_order_relaxed);
+
+  FreeBlock* block = nullptr;
+
+  if(sizeClass != LARGE_CLASS) {
+
+    auto cache = threadCache();
+
+    if(cache != nullptr) {
+
+      auto& list = cache->lists[sizeClass];
+      if(list.head != nullptr) {
+        s.cacheHits.fetch_add(1, std::memory_order_relaxed);
+      } else if(pullFromPool(sizeClass, list, cacheLimit(sizeClass) / 2)) {
+        s.poolHits.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      if(list.head != nullptr) {
+        block = list.head;
+        list.head = block->next;
+        list.count --;
+      }
+
+    } else {
+
+      FreeList list {nullptr, 0};
+      if(pullFromPool(sizeClass, list, 1)) {
+        s.poolHits.fetch_add(1, std::memory_order_relaxed);
+        block = list.head;
+      }
+
+    }
+
+  }
+
+  v_buff_size blockSize = (sizeClass == LARGE_CLASS) ? total : classSize(sizeClass);
+
+  if(block == nullptr) {
+    block = static_cast<FreeBlock*>(std::malloc(blockSize));
+    if(block == nullptr) {
+      return nullptr;
+    }
+    s.systemAllocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto header = reinterpret_cast<BlockHeader*>(block);
+  header->sizeClass = sizeClass;
+  header->size = blockSize;
+
+  s.bytesInUse.fetch_add(blockSize, std::memory_order_relaxed);
+
+  void* data = header + 1;
+  std::memset(data, 0, length);
+  return data;
+
+}
+
+void deallocate(void* ptr) {
+
+  if(ptr == nullptr) {
+    return;
+  }
+
+  auto& s = state();
+
+  auto header = static_cast<BlockHeader*>(ptr) - 1;
+  v_uint64 sizeClass = header->sizeClass;
+
+  s.frees.fetch_add(1, std::memory_order_relaxed);
+  s.bytesInUse.fetch_sub(header->size, std::memory_order_relaxed);
+
+  if(sizeClass == LARGE_CLASS) {
+    std::free(header);
+    return;
+  }
+
+  auto block = reinterpret_cast<FreeBlock*>(header);
+  auto cache = threadCache();
+
+  if(cache != nullptr) {
+    auto& list = cache->lists[sizeClass];
+    block->next = list.head;
+    list.head = block;
+    list.count ++;
+    if(list.count > cacheLimit(sizeClass)) {
+      pushToPool(sizeClass, list, list.count / 2);
+    }
+  } else {
+    block->next = nullptr;
+    FreeList list {block, 1};
+    pushToPool(sizeClass, list, 1);
+  }
+
+}
+
+int measureRandom(void* context, unsigned char* buffer, size_t size) {
+  (void) context;
+  std::memset(buffer, 0, size);
+  return 0;
+}
+
+/* Allocate record buffers of a throwaway TLS context, so that their sizes take the exact classes */
+void measureExactSizes() {
+
+  auto& s = state();
+  s.measuringExactSizes = true;
+
+  mbedtls_ssl_config config;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config_init(&config);
+  mbedtls_ssl_init(&ssl);
+
+  auto res = mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if(res == 0) {
+    /* No handshake is done - RNG is never called */
+    mbedtls_ssl_conf_rng(&config, &measureRandom, nullptr);
+    res = mbedtls_ssl_setup(&ssl, &config);
+  }
+
+  mbedtls_ssl_free(&ssl);
+  mbedtls_ssl_config_free(&config);
+
+  s.measuringExactSizes = false;
+
+  if(res != 0) {
+    OATPP_LOGE("[oatpp::mbedtls::Allocator::install()]", "Error. Call to mbedtls_ssl_setup() failed. Return value=%d. "
+               "Record buffers may be allocated from the system heap.", res);
+  }
+
+}
+
+}
+
+bool Allocator::isAvailable() {
+#if defined(OATPP_MBEDTLS_ALLOCATOR_AVAILABLE)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Allocator::install(v_buff_size threadCacheSize, v_buff_size poolSize) {
+
+#if defined(OATPP_MBEDTLS_ALLOCATOR_AVAILABLE)
+
+  static std::mutex installLock;
+  std::lock_guard<std::mutex> lock(installLock);
+
+  auto& s = state();
+
+  if(s.installed) {
+    throw std::runtime_error("[oatpp::mbedtls::Allocator::install()]: Error. Allocator is already installed.");
+  }
+
+  if(threadCacheSize < 0 || poolSize < 0) {
+    throw std::runtime_error("[oatpp::mbedtls::Allocator::install()]: Error. Invalid cache size.");
+  }
+
+  s.threadCacheSize = threadCacheSize;
+  s.poolSize = poolSize;
+
+  auto res = mbedtls_platform_set_calloc_free(&allocate, &deallocate);
+  if(res != 0) {
+    OATPP_LOGE("[oatpp::mbedtls::Allocator::install()]", "Error. Call to mbedtls_platform_set_calloc_free() failed. Return value=%d", res);
+    throw std::runtime_error("[oatpp::mbedtls::Allocator::install()]: Error. Call to mbedtls_platform_set_calloc_free() failed.");
+  }
+
+  measureExactSizes();
+
+  s.installed = true;
+
+#else
+  (void) threadCacheSize;
+  (void) poolSize;
+  OATPP_LOGE("[oatpp::mbedtls::Allocator::install()]", "Error. Mbed TLS is built without MBEDTLS_PLATFORM_MEMORY.");
+  throw std::runtime_error("[oatpp::mbedtls::Allocator::install()]: Error. Mbed TLS is built without MBEDTLS_PLATFORM_MEMORY.");
+#endif
+
+}
+
+bool Allocator::isInstalled() {
+  return state().installed;
+}
+
+Allocator::Statistics Allocator::getStatistics() {
+  auto& s = state();
+  Statistics stats;
+  stats.allocations = s.allocations;
+  stats.frees = s.frees;
+  stats.cacheHits = s.cacheHits;
+  stats.poolHits = s.poolHits;
+  stats.systemAllocations = s.systemAllocations;
+  stats.bytesInUse = s.bytesInUse;
+  stats.bytesPooled = s.bytesPooled;
+  return stats;
+}
+
+}}
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_Allocator_hpp
+#define oatpp_mbedtls_Allocator_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Process-wide allocator for Mbed TLS heap memory, installed with `mbedtls_platform_set_calloc_free()`.<br>
+ * Blocks are rounded up to size classes. Freed blocks go to a cache of the calling thread
+ * and overflow in batches to a shared pool, so handshake state, record buffers and bignums freed
+ * when a connection closes are handed to the next connection without a trip to the system heap.
+ * Size classes are 1x and 1.5x powers of two up to 16 KB. Sizes of the input and output record buffers of a TLS context
+ * get exact size classes - a rounded class would inflate them by a half. They are measured by &l:Allocator::install ();
+ * with a throwaway TLS context.
+ * Other blocks larger than 16 KB are allocated from the system heap directly.<br>
+ * *Requires Mbed TLS built with `MBEDTLS_PLATFORM_MEMORY`.*
+ */
+class Allocator {
+public:
+
+  /**
+   * Allocation statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of calls to calloc.
+     */
+    v_int64 allocations;
+
+    /**
+     * Number of calls to free with non-null pointer.
+     */
+    v_int64 frees;
+
+    /**
+     * Allocations served from the thread cache.
+     */
+    v_int64 cacheHits;
+
+    /**
+     * Allocations served from the shared pool.
+     */
+    v_int64 poolHits;
+
+    /**
+     * Allocations which went to the system heap.
+     */
+    v_int64 systemAllocations;
+
+    /**
+     * Bytes allocated by Mbed TLS and not freed yet. Counted in size class bytes.
+     */
+    v_int64 bytesInUse;
+
+    /**
+     * Bytes of free blocks kept in the shared pool.
+     */
+    v_int64 bytesPooled;
+
+  };
+
+public:
+
+  /**
+   * Check if Mbed TLS is built with custom allocator support.
+   * @return - `true` if &l:Allocator::install (); can be called.
+   */
+  static bool isAvailable();
+
+  /**
+   * Install allocator. Opt-in.<br>
+   * *Must be called once, after `oatpp::base::Environment::init()` and before the first &id:oatpp::mbedtls::Config;
+   * is created - Mbed TLS memory allocated before the allocator is installed can't be freed by it.
+   * Allocator stays installed until the process exits.*
+   * @param threadCacheSize - max bytes of free blocks of one size class kept by each thread.
+   * @param poolSize - max bytes of free blocks kept in the shared pool.
+   */
+  static void install(v_buff_size threadCacheSize = 256 * 1024, v_buff_size poolSize = 64 * 1024 * 1024);
+
+  /**
+   * Check if allocator is installed.
+   * @return - `true` if installed.
+   */
+  static bool isInstalled();
+
+  /**
+   * Get allocation statistics.
+   * @return - &l:Allocator::Statistics;.
+   */
+  static Statistics getStatistics();
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_Allocator_hpp
@@ -27,6 +27,18 @@
 
 #include "oatpp/core/base/Environment.hpp"
 
+#if defined(MBEDTLS_PSA_CRYPTO_C)
+#include "psa/crypto.h"
+#endif
+
+/*
+ * Handshakes of connections sharing one Config run concurrently, and lanes of a private key are shared by them -
+ * the RSA contexts, the DRBG and the session caches of Mbed TLS must be locked.
+ */
+#if !defined(MBEDTLS_THREADING_C)
+#error "oatpp-mbedtls requires Mbed TLS built with MBEDTLS_THREADING_C. Run 'python3 scripts/config.py set MBEDTLS_THREADING_C' in the Mbed TLS tree."
+#endif
+
 #if defined(OATPP_MBEDTLS_DEBUG)
 #include <mbedtls/debug.h>
 namespace oatpp { namespace mbedtls {
@@ -39,7 +51,152 @@ static void mbedtlsDebug( void *ctx, int level, const char *file, int line, cons
 
 namespace oatpp { namespace mbedtls {
 
-Config::Config() {
+void Config::initPSA() {
+#if defined(MBEDTLS_PSA_CRYPTO_C)
+  /* TLS 1.3 key schedule runs on PSA Crypto - it must be initialized once per process before any handshake */
+  static std::once_flag flag;
+  std::call_once(flag, [] {
+    auto res = psa_crypto_init();
+    if(res != PSA_SUCCESS) {
+      OATPP_LOGE("[oatpp::mbedtls::Config::initPSA()]", "Error. Call to psa_crypto_init() failed. Return value=%d", (int) res);
+      throw std::runtime_error("[oatpp::mbedtls::Config::initPSA()]: Error. Call to psa_crypto_init() failed.");
+    }
+  });
+#endif
+}
+
+int Config::random(void* ctx, unsigned char* output, size_t length) {
+  return static_cast<Config*>(ctx)->getRandom(output, length);
+}
+
+int Config::certificateCallback(mbedtls_ssl_context* ssl) {
+  /* mbedtls_ssl_conf_get_user_data_p() takes non-const config, the config pointer is only read */
+  auto config = static_cast<Config*>(mbedtls_ssl_conf_get_user_data_p(const_cast<mbedtls_ssl_config*>(mbedtls_ssl_context_get_config(ssl))));
+  /* Each handshake gets the next copy of the key - concurrent handshakes don't wait on a single RSA context */
+  return mbedtls_ssl_set_hs_own_cert(ssl, &config->m_srvcert, config->m_privateKey.getHandshakeKey());
+}
+
+int Config::asyncStart(PrivateKeyOperation::Type type, mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert,
+                       mbedtls_md_type_t mdAlg, const unsigned char* input, size_t inputLength)
+{
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+
+  auto config = static_cast<Config*>(mbedtls_ssl_conf_get_async_config_data(mbedtls_ssl_context_get_config(ssl)));
+  auto key = config->findPrivateKey(cert);
+
+  if(key == nullptr || !config->m_cryptoWorkers) {
+    return MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH;
+  }
+
+  auto operation = std::make_shared<PrivateKeyOperation>(type, key, &Config::random, config, mdAlg, input, inputLength);
+  mbedtls_ssl_set_async_operation_data(ssl, new std::shared_ptr<PrivateKeyOperation>(operation));
+  config->m_cryptoWorkers->submit(operation);
+
+  return 0;
+
+#else
+  (void) type; (void) ssl; (void) cert; (void) mdAlg; (void) input; (void) inputLength;
+  return MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH;
+#endif
+}
+
+int Config::asyncSign(mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert, mbedtls_md_type_t mdAlg, const unsigned char* hash, size_t hashLength) {
+  return asyncStart(PrivateKeyOperation::SIGN, ssl, cert, mdAlg, hash, hashLength);
+}
+
+int Config::asyncDecrypt(mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert, const unsigned char* input, size_t inputLength) {
+  return asyncStart(PrivateKeyOperation::DECRYPT, ssl, cert, MBEDTLS_MD_NONE, input, inputLength);
+}
+
+int Config::asyncResume(mbedtls_ssl_context* ssl, unsigned char* output, size_t* outputLength, size_t outputSize) {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+
+  auto holder = static_cast<std::shared_ptr<PrivateKeyOperation>*>(mbedtls_ssl_get_async_operation_data(ssl));
+  if(holder == nullptr) {
+    return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+  }
+
+  if(!(*holder)->isDone()) {
+    return MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS;
+  }
+
+  auto res = (*holder)->getResult(output, outputLength, outputSize);
+  mbedtls_ssl_set_async_operation_data(ssl, nullptr);
+  delete holder;
+  return res;
+
+#else
+  (void) ssl; (void) output; (void) outputLength; (void) outputSize;
+  return MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+#endif
+}
+
+void Config::asyncCancel(mbedtls_ssl_context* ssl) {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+  auto holder = static_cast<std::shared_ptr<PrivateKeyOperation>*>(mbedtls_ssl_get_async_operation_data(ssl));
+  if(holder != nullptr) {
+    (*holder)->cancel();
+    mbedtls_ssl_set_async_operation_data(ssl, nullptr);
+    delete holder;
+  }
+#else
+  (void) ssl;
+#endif
+}
+
+std::shared_ptr<PrivateKeyOperation> Config::getPendingOperation(mbedtls_ssl_context* ssl) {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+  auto holder = static_cast<std::shared_ptr<PrivateKeyOperation>*>(mbedtls_ssl_get_async_operation_data(ssl));
+  if(holder != nullptr) {
+    return *holder;
+  }
+#else
+  (void) ssl;
+#endif
+  return nullptr;
+}
+
+void Config::enableTLS13Tickets() {
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3) && defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C) && MBEDTLS_VERSION_NUMBER >= 0x03060100
+  /* Client ignores TLS 1.3 NewSessionTicket unless it's signalled - tickets are needed for PSK resumption */
+  mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets(&m_config, MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED);
+#endif
+}
+
+PrivateKey* Config::findPrivateKey(mbedtls_x509_crt* cert) {
+  if(m_certificateStore) {
+    auto key = m_certificateStore->findPrivateKey(cert);
+    if(key != nullptr) {
+      return key;
+    }
+  }
+  if(m_privateKey.isLoaded()) {
+    return &m_privateKey;
+  }
+  return nullptr;
+}
+
+Config::Config()
+  : m_privateKey(&Config::random, this)
+  , m_reseedInterval(0)
+  , m_handshakeTimeout(0)
+  , m_readTimeout(0)
+  , m_writeTimeout(0)
+  , m_idleBufferRelease(0)
+  , m_idleTimeout(0)
+  , m_writeCoalescing(0)
+  , m_writeBatchSize(0)
+  , m_readAheadSize(0)
+  , m_maxEarlyDataSize(0)
+  , m_maxFragmentLength(0)
+  , m_trimPeerCertificate(false)
+  , m_earlyDataWindow(60)
+  , m_tls12Handshakes(0)
+  , m_tls13Handshakes(0)
+  , m_throwOnVerificationFailed(false)
+{
+
+  initPSA();
 
   mbedtls_ssl_config_init(&m_config);
 
@@ -48,7 +205,6 @@ Config::Config() {
   mbedtls_x509_crt_init(&m_srvcert);
   mbedtls_x509_crt_init(&m_clientcert);
   mbedtls_x509_crt_init(&m_cachain);
-  mbedtls_pk_init(&m_privateKey);
 
   auto res = mbedtls_ctr_drbg_seed(&m_ctr_drbg, mbedtls_entropy_func, &m_entropy, nullptr, 0);
   if(res != 0) {
@@ -60,6 +216,9 @@ Config::Config() {
 
 Config::~Config() {
 
+  /* Pooled contexts reference m_config */
+  m_contextPool.reset();
+
   mbedtls_ssl_config_free(&m_config);
 
   mbedtls_entropy_free(&m_entropy);
@@ -69,8 +228,6 @@ Config::~Config() {
   mbedtls_x509_crt_free(&m_clientcert);
   mbedtls_x509_crt_free(&m_cachain);
 
-  mbedtls_pk_free(&m_privateKey);
-
 }
 
 std::shared_ptr<Config> Config::createShared() {
@@ -92,7 +249,7 @@ std::shared_ptr<Config> Config::createDefaultServerConfigShared(const char* serv
     throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]: Error. Can't parse serverCertFile");
   }
 
-  res = mbedtls_pk_parse_keyfile(&result->m_privateKey, privateKeyFile, pkPassword);
+  res = result->m_privateKey.parseFile(privateKeyFile, pkPassword);
   if(res != 0) {
     OATPP_LOGD("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]", "Error. Can't parse privateKeyFile path='%s', return value=%d", privateKeyFile, res);
     throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]: Error. Can't parse privateKeyFile");
@@ -104,14 +261,42 @@ std::shared_ptr<Config> Config::createDefaultServerConfigShared(const char* serv
     throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]: Error. Call to mbedtls_ssl_config_defaults() failed.");
   }
 
-  mbedtls_ssl_conf_rng(&result->m_config, mbedtls_ctr_drbg_random, &result->m_ctr_drbg);
+  mbedtls_ssl_conf_rng(&result->m_config, &Config::random, result.get());
 
-  res = mbedtls_ssl_conf_own_cert(&result->m_config, &result->m_srvcert, &result->m_privateKey);
+  res = mbedtls_ssl_conf_own_cert(&result->m_config, &result->m_srvcert, result->m_privateKey.getHandshakeKey());
   if(res != 0) {
     OATPP_LOGD("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]", "Error. Call to mbedtls_ssl_conf_own_cert() failed, return value=%d.", res);
     throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]: Error. Call to mbedtls_ssl_conf_own_cert() failed.");
   }
 
+  if(result->m_privateKey.isReplicated()) {
+    mbedtls_ssl_conf_set_user_data_p(&result->m_config, result.get());
+    mbedtls_ssl_conf_cert_cb(&result->m_config, &Config::certificateCallback);
+  }
+
+  return result;
+
+}
+
+std::shared_ptr<Config> Config::createDefaultServerConfigShared(const std::shared_ptr<server::CertificateStore>& certificateStore) {
+
+  auto result = createShared();
+
+#if defined(OATPP_MBEDTLS_DEBUG)
+  mbedtls_ssl_conf_dbg( &result->m_config, mbedtlsDebug, (void*)"Server" );
+  mbedtls_debug_set_threshold( OATPP_MBEDTLS_DEBUG );
+#endif
+
+  auto res = mbedtls_ssl_config_defaults(&result->m_config, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]", "Error. Call to mbedtls_ssl_config_defaults() failed, return value=%d.", res);
+    throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultServerConfigShared()]: Error. Call to mbedtls_ssl_config_defaults() failed.");
+  }
+
+  mbedtls_ssl_conf_rng(&result->m_config, &Config::random, result.get());
+
+  result->setCertificateStore(certificateStore);
+
   return result;
 
 }
@@ -147,7 +332,8 @@ std::shared_ptr<Config> Config::createDefaultClientConfigShared(bool throwOnVeri
     mbedtls_ssl_conf_authmode(&result->m_config, MBEDTLS_SSL_VERIFY_NONE);
   }
 
-  mbedtls_ssl_conf_rng(&result->m_config, mbedtls_ctr_drbg_random, &result->m_ctr_drbg);
+  mbedtls_ssl_conf_rng(&result->m_config, &Config::random, result.get());
+  result->enableTLS13Tickets();
 
   return result;
 
@@ -182,7 +368,8 @@ std::shared_ptr<Config> Config::createDefaultClientConfigShared(bool throwOnVeri
   } else {
     mbedtls_ssl_conf_authmode(&result->m_config, MBEDTLS_SSL_VERIFY_NONE);
   }
-  mbedtls_ssl_conf_rng(&result->m_config, mbedtls_ctr_drbg_random, &result->m_ctr_drbg);
+  mbedtls_ssl_conf_rng(&result->m_config, &Config::random, result.get());
+  result->enableTLS13Tickets();
 
   if (clientCert.size())
   {
@@ -195,14 +382,14 @@ std::shared_ptr<Config> Config::createDefaultClientConfigShared(bool throwOnVeri
 
   if (privateKey.size())
   {
-	res = mbedtls_pk_parse_key(&result->m_privateKey, (const unsigned char *)privateKey.data(), privateKey.size()+1, NULL, 0);
+	res = result->m_privateKey.parse((const unsigned char *)privateKey.data(), privateKey.size()+1);
 	if (res != 0) {
 		OATPP_LOGD("[oatpp::mbedtls::Config::createDefaultClientConfigShared()]", "Error. Call to mbedtls_pk_parse_key() failed, return value=%d.", res);
 		throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultClientConfigShared()]: Error. Call to mbedtls_pk_parse_key() failed.");
 	}
   }
 
-  res = mbedtls_ssl_conf_own_cert(&result->m_config, &result->m_clientcert, &result->m_privateKey);
+  res = mbedtls_ssl_conf_own_cert(&result->m_config, &result->m_clientcert, result->m_privateKey.getHandshakeKey());
   if(res != 0) {
     OATPP_LOGD("[oatpp::mbedtls::Config::createDefaultClientConfigShared()]", "Error. Call to mbedtls_ssl_conf_own_cert() failed, return value=%d.", res);
     throw std::runtime_error("[oatpp::mbedtls::Config::createDefaultClientConfigShared()]: Error. Call to mbedtls_ssl_conf_own_cert() failed.");
@@ -223,6 +410,42 @@ mbedtls_ctr_drbg_context* Config::getCTR_DRBG() {
   return &m_ctr_drbg;
 }
 
+void Config::addEntropySource(mbedtls_entropy_f_source_ptr source, void* data, size_t threshold, int strong) {
+  auto res = mbedtls_entropy_add_source(&m_entropy, source, data, threshold, strong);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::Config::addEntropySource()]", "Error. Call to mbedtls_entropy_add_source() failed, return value=%d.", res);
+    throw std::runtime_error("[oatpp::mbedtls::Config::addEntropySource()]: Error. Call to mbedtls_entropy_add_source() failed.");
+  }
+}
+
+void Config::setReseedInterval(int interval) {
+  m_reseedInterval = interval;
+  mbedtls_ctr_drbg_set_reseed_interval(&m_ctr_drbg, interval > 0 ? interval : MBEDTLS_CTR_DRBG_RESEED_INTERVAL);
+  if(m_randomGenerator) {
+    setRandomShards(m_randomGenerator->getShardsCount());
+  }
+}
+
+void Config::setRandomShards(v_int32 shardsCount) {
+  if(shardsCount > 0) {
+    m_randomGenerator = std::make_shared<RandomGenerator>(&m_entropy, shardsCount, m_reseedInterval);
+  } else {
+    m_randomGenerator.reset();
+  }
+}
+
+std::shared_ptr<RandomGenerator> Config::getRandomGenerator() {
+  return m_randomGenerator;
+}
+
+int Config::getRandom(unsigned char* output, size_t length) {
+  if(m_randomGenerator) {
+    return m_randomGenerator->generate(output, length);
+  }
+  std::lock_guard<std::mutex> lock(m_randomLock);
+  return mbedtls_ctr_drbg_random(&m_ctr_drbg, output, length);
+}
+
 mbedtls_x509_crt* Config::getServerCertificate() {
   return &m_srvcert;
 }
@@ -232,7 +455,284 @@ mbedtls_x509_crt* Config::getCAChain() {
 }
 
 mbedtls_pk_context* Config::getPrivateKey() {
-  return &m_privateKey;
+  return m_privateKey.getKey();
+}
+
+void Config::setCertificateStore(const std::shared_ptr<server::CertificateStore>& certificateStore) {
+  if(!certificateStore) {
+    throw std::runtime_error("[oatpp::mbedtls::Config::setCertificateStore()]: Error. Certificate store is null.");
+  }
+  certificateStore->configure(&m_config);
+  m_certificateStore = certificateStore;
+}
+
+std::shared_ptr<server::CertificateStore> Config::getCertificateStore() {
+  return m_certificateStore;
+}
+
+void Config::setSessionCache(const std::shared_ptr<server::SessionCache>& sessionCache) {
+  m_sessionCache = sessionCache;
+  if(m_sessionCache) {
+    m_sessionCache->configure(&m_config);
+  } else {
+    mbedtls_ssl_conf_session_cache(&m_config, nullptr, nullptr, nullptr);
+  }
+}
+
+std::shared_ptr<server::SessionCache> Config::getSessionCache() {
+  return m_sessionCache;
+}
+
+void Config::setSessionTickets(const std::shared_ptr<server::SessionTickets>& sessionTickets) {
+  if(sessionTickets) {
+    sessionTickets->setEarlyDataWindow(m_earlyDataWindow);
+    sessionTickets->configure(&m_config);
+  } else {
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_SRV_C)
+    mbedtls_ssl_conf_session_tickets_cb(&m_config, nullptr, nullptr, nullptr);
+#endif
+  }
+  m_sessionTickets = sessionTickets;
+}
+
+std::shared_ptr<server::SessionTickets> Config::getSessionTickets() {
+  return m_sessionTickets;
+}
+
+void Config::setHandshakeTimeout(v_int64 milliseconds) {
+  m_handshakeTimeout = milliseconds;
+}
+
+v_int64 Config::getHandshakeTimeout() const {
+  return m_handshakeTimeout;
+}
+
+void Config::setReadTimeout(v_int64 milliseconds) {
+  m_readTimeout = milliseconds;
+}
+
+v_int64 Config::getReadTimeout() const {
+  return m_readTimeout;
+}
+
+void Config::setWriteTimeout(v_int64 milliseconds) {
+  m_writeTimeout = milliseconds;
+}
+
+v_int64 Config::getWriteTimeout() const {
+  return m_writeTimeout;
+}
+
+void Config::setIdleBufferRelease(v_int64 milliseconds) {
+  m_idleBufferRelease = milliseconds;
+}
+
+v_int64 Config::getIdleBufferRelease() const {
+  return m_idleBufferRelease;
+}
+
+void Config::setIdleTimeout(v_int64 milliseconds) {
+  m_idleTimeout = milliseconds;
+}
+
+v_int64 Config::getIdleTimeout() const {
+  return m_idleTimeout;
+}
+
+void Config::setWriteCoalescing(v_buff_size size) {
+  m_writeCoalescing = size > 0 ? size : 0;
+}
+
+v_buff_size Config::getWriteCoalescing() const {
+  return m_writeCoalescing;
+}
+
+void Config::setWriteBatchSize(v_buff_size size) {
+  m_writeBatchSize = size > 0 ? size : 0;
+}
+
+v_buff_size Config::getWriteBatchSize() const {
+  return m_writeBatchSize;
+}
+
+void Config::setReadAheadSize(v_buff_size size) {
+  m_readAheadSize = size > 0 ? size : 0;
+}
+
+v_buff_size Config::getReadAheadSize() const {
+  return m_readAheadSize;
+}
+
+void Config::setTLSVersions(mbedtls_ssl_protocol_version minVersion, mbedtls_ssl_protocol_version maxVersion) {
+  if(minVersion > maxVersion) {
+    throw std::runtime_error("[oatpp::mbedtls::Config::setTLSVersions()]: Error. minVersion is greater than maxVersion.");
+  }
+  mbedtls_ssl_conf_min_tls_version(&m_config, minVersion);
+  mbedtls_ssl_conf_max_tls_version(&m_config, maxVersion);
+}
+
+void Config::setPreset(const Preset& preset) {
+
+  if(!preset.getCipherSuites().empty()) {
+    m_cipherSuites = preset.getCipherSuites();
+    m_cipherSuites.push_back(0);
+    mbedtls_ssl_conf_ciphersuites(&m_config, m_cipherSuites.data());
+  }
+
+  if(!preset.getGroups().empty()) {
+    m_groups.assign(preset.getGroups().begin(), preset.getGroups().end());
+    m_groups.push_back(MBEDTLS_SSL_IANA_TLS_GROUP_NONE);
+    mbedtls_ssl_conf_groups(&m_config, m_groups.data());
+  }
+
+  if(!preset.getSignatureAlgorithms().empty()) {
+    m_signatureAlgorithms.assign(preset.getSignatureAlgorithms().begin(), preset.getSignatureAlgorithms().end());
+    m_signatureAlgorithms.push_back(MBEDTLS_TLS1_3_SIG_NONE);
+    mbedtls_ssl_conf_sig_algs(&m_config, m_signatureAlgorithms.data());
+  }
+
+}
+
+void Config::setEarlyData(v_uint32 maxSize, v_int64 antiReplayWindowSeconds) {
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+  mbedtls_ssl_conf_early_data(&m_config, maxSize > 0 ? MBEDTLS_SSL_EARLY_DATA_ENABLED : MBEDTLS_SSL_EARLY_DATA_DISABLED);
+#if defined(MBEDTLS_SSL_SRV_C)
+  if(maxSize > 0) {
+    mbedtls_ssl_conf_max_early_data_size(&m_config, maxSize);
+  }
+#endif
+  m_maxEarlyDataSize = maxSize;
+  m_earlyDataWindow = antiReplayWindowSeconds;
+  if(m_sessionTickets) {
+    m_sessionTickets->setEarlyDataWindow(m_earlyDataWindow);
+  }
+#else
+  (void) antiReplayWindowSeconds;
+  if(maxSize > 0) {
+    throw std::runtime_error("[oatpp::mbedtls::Config::setEarlyData()]: Error. Mbed TLS is built without MBEDTLS_SSL_EARLY_DATA.");
+  }
+#endif
+}
+
+v_uint32 Config::getMaxEarlyDataSize() const {
+  return m_maxEarlyDataSize;
+}
+
+void Config::setMaxFragmentLength(v_uint32 length) {
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+
+  unsigned char code;
+  switch(length) {
+    case 0: code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE; break;
+    case 512: code = MBEDTLS_SSL_MAX_FRAG_LEN_512; break;
+    case 1024: code = MBEDTLS_SSL_MAX_FRAG_LEN_1024; break;
+    case 2048: code = MBEDTLS_SSL_MAX_FRAG_LEN_2048; break;
+    case 4096: code = MBEDTLS_SSL_MAX_FRAG_LEN_4096; break;
+    default:
+      throw std::runtime_error("[oatpp::mbedtls::Config::setMaxFragmentLength()]: Error. Length must be 0, 512, 1024, 2048 or 4096.");
+  }
+
+  auto res = mbedtls_ssl_conf_max_frag_len(&m_config, code);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::Config::setMaxFragmentLength()]", "Error. Call to mbedtls_ssl_conf_max_frag_len() failed, return value=%d.", res);
+    throw std::runtime_error("[oatpp::mbedtls::Config::setMaxFragmentLength()]: Error. Call to mbedtls_ssl_conf_max_frag_len() failed.");
+  }
+
+  m_maxFragmentLength = length;
+
+#else
+  if(length > 0) {
+    throw std::runtime_error("[oatpp::mbedtls::Config::setMaxFragmentLength()]: Error. Mbed TLS is built without MBEDTLS_SSL_MAX_FRAGMENT_LENGTH.");
+  }
+#endif
+}
+
+v_uint32 Config::getMaxFragmentLength() const {
+  return m_maxFragmentLength;
+}
+
+void Config::setTrimPeerCertificate(bool trim) {
+  m_trimPeerCertificate = trim;
+}
+
+bool Config::getTrimPeerCertificate() const {
+  return m_trimPeerCertificate;
+}
+
+void Config::setContextPool(v_int32 maxSize) {
+  if(maxSize > 0) {
+    m_contextPool = std::make_shared<ContextPool>(&m_config, maxSize);
+  } else {
+    m_contextPool.reset();
+  }
+}
+
+std::shared_ptr<ContextPool> Config::getContextPool() {
+  return m_contextPool;
+}
+
+mbedtls_ssl_context* Config::createTLSContext() {
+
+  if(m_contextPool) {
+    return m_contextPool->acquire();
+  }
+
+  auto context = new mbedtls_ssl_context();
+  mbedtls_ssl_init(context);
+
+  auto res = mbedtls_ssl_setup(context, &m_config);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::Config::createTLSContext()]", "Error. Call to mbedtls_ssl_setup() failed. Return value=%d", res);
+    mbedtls_ssl_free(context);
+    delete context;
+    return nullptr;
+  }
+
+  return context;
+
+}
+
+void Config::destroyTLSContext(mbedtls_ssl_context* context) {
+  if(m_contextPool) {
+    m_contextPool->release(context);
+  } else {
+    mbedtls_ssl_free(context);
+    delete context;
+  }
+}
+
+void Config::countHandshake(mbedtls_ssl_protocol_version version) {
+  if(version == MBEDTLS_SSL_VERSION_TLS1_3) {
+    ++ m_tls13Handshakes;
+  } else {
+    ++ m_tls12Handshakes;
+  }
+}
+
+Config::ProtocolStatistics Config::getProtocolStatistics() const {
+  ProtocolStatistics stats;
+  stats.tls12Handshakes = m_tls12Handshakes;
+  stats.tls13Handshakes = m_tls13Handshakes;
+  return stats;
+}
+
+void Config::setCryptoWorkerPool(const std::shared_ptr<CryptoWorkerPool>& pool) {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+  if(pool) {
+    mbedtls_ssl_conf_async_private_cb(&m_config, &Config::asyncSign, &Config::asyncDecrypt, &Config::asyncResume, &Config::asyncCancel, this);
+  } else {
+    mbedtls_ssl_conf_async_private_cb(&m_config, nullptr, nullptr, nullptr, nullptr, nullptr);
+  }
+  m_cryptoWorkers = pool;
+#else
+  if(pool) {
+    throw std::runtime_error("[oatpp::mbedtls::Config::setCryptoWorkerPool()]: Error. Mbed TLS is built without MBEDTLS_SSL_ASYNC_PRIVATE.");
+  }
+#endif
+}
+
+std::shared_ptr<CryptoWorkerPool> Config::getCryptoWorkerPool() {
+  return m_cryptoWorkers;
 }
 
 bool Config::shouldThrowOnVerificationFailed() {
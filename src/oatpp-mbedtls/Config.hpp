@@ -28,21 +28,69 @@
 
 #include "mbedtls/entropy.h"
 #include "mbedtls/ctr_drbg.h"
-#include "mbedtls/certs.h"
 #include "mbedtls/x509.h"
 #include "mbedtls/ssl.h"
 #include "mbedtls/net_sockets.h"
 #include "mbedtls/error.h"
 
+#include "oatpp-mbedtls/server/CertificateStore.hpp"
+#include "oatpp-mbedtls/server/SessionCache.hpp"
+#include "oatpp-mbedtls/server/SessionTickets.hpp"
+#include "oatpp-mbedtls/PrivateKey.hpp"
+#include "oatpp-mbedtls/CryptoWorkerPool.hpp"
+#include "oatpp-mbedtls/RandomGenerator.hpp"
+#include "oatpp-mbedtls/Preset.hpp"
+#include "oatpp-mbedtls/ContextPool.hpp"
+
+#include "oatpp/core/base/Environment.hpp"
+
 #include <string>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
 namespace oatpp { namespace mbedtls {
 
 /**
- * Wrapper over `mbedtls_ssl_config`.
+ * Wrapper over `mbedtls_ssl_config`.<br>
+ * Config is shared by all connections created with it, and handshakes of those connections run concurrently.
+ * Shared state (random generator, private keys) is safe to be used from several threads.
  */
 class Config {
+public:
+
+  /**
+   * Number of completed handshakes per negotiated protocol version.
+   */
+  struct ProtocolStatistics {
+
+    /**
+     * Handshakes which negotiated TLS 1.2.
+     */
+    v_int64 tls12Handshakes;
+
+    /**
+     * Handshakes which negotiated TLS 1.3.
+     */
+    v_int64 tls13Handshakes;
+
+  };
+
+private:
+  static void initPSA();
+  static int random(void* ctx, unsigned char* output, size_t length);
+  static int certificateCallback(mbedtls_ssl_context* ssl);
+private:
+  static int asyncStart(PrivateKeyOperation::Type type, mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert,
+                        mbedtls_md_type_t mdAlg, const unsigned char* input, size_t inputLength);
+  static int asyncSign(mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert, mbedtls_md_type_t mdAlg, const unsigned char* hash, size_t hashLength);
+  static int asyncDecrypt(mbedtls_ssl_context* ssl, mbedtls_x509_crt* cert, const unsigned char* input, size_t inputLength);
+  static int asyncResume(mbedtls_ssl_context* ssl, unsigned char* output, size_t* outputLength, size_t outputSize);
+  static void asyncCancel(mbedtls_ssl_context* ssl);
+private:
+  PrivateKey* findPrivateKey(mbedtls_x509_crt* cert);
+  void enableTLS13Tickets();
 private:
 
   mbedtls_ssl_config m_config;
@@ -52,7 +100,41 @@ private:
   mbedtls_x509_crt m_srvcert;
   mbedtls_x509_crt m_clientcert;
   mbedtls_x509_crt m_cachain;
-  mbedtls_pk_context m_privateKey;
+  PrivateKey m_privateKey;
+
+  std::mutex m_randomLock;
+  std::shared_ptr<RandomGenerator> m_randomGenerator;
+  int m_reseedInterval;
+
+  std::shared_ptr<server::CertificateStore> m_certificateStore;
+  std::shared_ptr<server::SessionCache> m_sessionCache;
+  std::shared_ptr<server::SessionTickets> m_sessionTickets;
+
+  v_int64 m_handshakeTimeout;
+  v_int64 m_readTimeout;
+  v_int64 m_writeTimeout;
+  v_int64 m_idleBufferRelease;
+  v_int64 m_idleTimeout;
+  v_buff_size m_writeCoalescing;
+  v_buff_size m_writeBatchSize;
+  v_buff_size m_readAheadSize;
+
+  std::shared_ptr<CryptoWorkerPool> m_cryptoWorkers;
+
+  v_uint32 m_maxEarlyDataSize;
+  v_uint32 m_maxFragmentLength;
+  bool m_trimPeerCertificate;
+  v_int64 m_earlyDataWindow;
+
+  std::shared_ptr<ContextPool> m_contextPool;
+
+  /* Zero-terminated lists referenced by m_config */
+  std::vector<int> m_cipherSuites;
+  std::vector<uint16_t> m_groups;
+  std::vector<uint16_t> m_signatureAlgorithms;
+
+  std::atomic<v_int64> m_tls12Handshakes;
+  std::atomic<v_int64> m_tls13Handshakes;
 
   bool m_throwOnVerificationFailed;
 
@@ -83,6 +165,15 @@ public:
    */
   static std::shared_ptr<Config> createDefaultServerConfigShared(const char* serverCertFile, const char* privateKeyFile, const char* pkPassword = nullptr);
 
+  /**
+   * Create default server config serving certificates of the store. Certificate is selected by the name
+   * the client requested in the ClientHello (SNI). Add an ECDSA and an RSA certificate for the same names
+   * to serve ECDSA to clients which accept it and RSA to the rest.
+   * @param certificateStore - &id:oatpp::mbedtls::server::CertificateStore;. Must have at least one certificate.
+   * @return - `std::shared_ptr` to Config.
+   */
+  static std::shared_ptr<Config> createDefaultServerConfigShared(const std::shared_ptr<server::CertificateStore>& certificateStore);
+
   /**
    * Create default client config.
    * @param throwOnVerificationFailed - throw error on server certificate
@@ -114,11 +205,54 @@ public:
   mbedtls_entropy_context* getEntropy();
 
   /**
-   * Get CTR_DRBG.
+   * Get CTR_DRBG.<br>
+   * *CTR_DRBG context is NOT thread-safe. Use &l:Config::getRandom (); to draw random bytes from several threads.*
    * @return - `mbedtls_ctr_drbg_context*`
    */
   mbedtls_ctr_drbg_context* getCTR_DRBG();
 
+  /**
+   * Add entropy source to the entropy of this config. Source is polled by all following (re)seeds of the config's
+   * random generators.<br>
+   * *Must be set before connections are created with this config.*
+   * @param source - entropy source function.
+   * @param data - source function context.
+   * @param threshold - minimum number of bytes required from the source before release.
+   * @param strong - `MBEDTLS_ENTROPY_SOURCE_STRONG` or `MBEDTLS_ENTROPY_SOURCE_WEAK`.
+   */
+  void addEntropySource(mbedtls_entropy_f_source_ptr source, void* data, size_t threshold, int strong);
+
+  /**
+   * Set number of draws after which random generators of this config reseed from the entropy.<br>
+   * *Must be set before connections are created with this config.*
+   * @param interval - reseed interval. `0` - Mbed TLS default (`MBEDTLS_CTR_DRBG_RESEED_INTERVAL`).
+   */
+  void setReseedInterval(int interval);
+
+  /**
+   * Draw random bytes from several generators instead of the single shared CTR_DRBG.
+   * Every handshake and record encryption draws random bytes - with one generator concurrent connections contend on its lock.
+   * See &id:oatpp::mbedtls::RandomGenerator;.<br>
+   * *Must be set before connections are created with this config.*
+   * @param shardsCount - number of generators. Ex.: number of threads running handshakes and I/O.
+   * `0` - use the single shared CTR_DRBG (default).
+   */
+  void setRandomShards(v_int32 shardsCount);
+
+  /**
+   * Get sharded random generator.
+   * @return - &id:oatpp::mbedtls::RandomGenerator; or `nullptr` if the single shared CTR_DRBG is used.
+   */
+  std::shared_ptr<RandomGenerator> getRandomGenerator();
+
+  /**
+   * Fill buffer with random bytes. Thread-safe.
+   * @param output - output buffer.
+   * @param length - number of bytes to generate.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int getRandom(unsigned char* output, size_t length);
+
   /**
    * Get server certificate.
    * @return - `mbedtls_x509_crt*`
@@ -137,6 +271,297 @@ public:
    */
   mbedtls_pk_context* getPrivateKey();
 
+  /**
+   * Set server certificate store. Certificate is selected by the name the client requested in the ClientHello (SNI).
+   * Default certificate of the store replaces own certificate of the config.<br>
+   * *Must be set before connections are created with this config.*
+   * @param certificateStore - &id:oatpp::mbedtls::server::CertificateStore;. Must have at least one certificate.
+   */
+  void setCertificateStore(const std::shared_ptr<server::CertificateStore>& certificateStore);
+
+  /**
+   * Get server certificate store.
+   * @return - &id:oatpp::mbedtls::server::CertificateStore; or `nullptr` if not set.
+   */
+  std::shared_ptr<server::CertificateStore> getCertificateStore();
+
+  /**
+   * Set server session cache. Enables abbreviated handshakes for clients resuming sessions by session ID.<br>
+   * *Must be set before connections are created with this config.*
+   * @param sessionCache - &id:oatpp::mbedtls::server::SessionCache;.
+   */
+  void setSessionCache(const std::shared_ptr<server::SessionCache>& sessionCache);
+
+  /**
+   * Get server session cache.
+   * @return - &id:oatpp::mbedtls::server::SessionCache; or `nullptr` if not set.
+   */
+  std::shared_ptr<server::SessionCache> getSessionCache();
+
+  /**
+   * Set server session tickets. Enables abbreviated handshakes for clients resuming sessions by ticket.
+   * Pass `nullptr` to disable tickets.<br>
+   * *Must be set before connections are created with this config.*
+   * @param sessionTickets - &id:oatpp::mbedtls::server::SessionTickets;.
+   */
+  void setSessionTickets(const std::shared_ptr<server::SessionTickets>& sessionTickets);
+
+  /**
+   * Get server session tickets.
+   * @return - &id:oatpp::mbedtls::server::SessionTickets; or `nullptr` if not set.
+   */
+  std::shared_ptr<server::SessionTickets> getSessionTickets();
+
+  /**
+   * Set handshake timeout. Connection is closed if handshake doesn't finish in time.
+   * Applies to blocking and to asynchronous handshakes.<br>
+   * *Must be set before connections are created with this config.*
+   * @param milliseconds - timeout in milliseconds. `0` - no timeout (default).
+   */
+  void setHandshakeTimeout(v_int64 milliseconds);
+
+  /**
+   * Get handshake timeout.
+   * @return - timeout in milliseconds. `0` - no timeout.
+   */
+  v_int64 getHandshakeTimeout() const;
+
+  /**
+   * Set read idle timeout. Connection is closed if a read operation waits for data longer than the timeout.<br>
+   * *Must be set before connections are created with this config.*
+   * @param milliseconds - timeout in milliseconds. `0` - no timeout (default).
+   */
+  void setReadTimeout(v_int64 milliseconds);
+
+  /**
+   * Get read idle timeout.
+   * @return - timeout in milliseconds. `0` - no timeout.
+   */
+  v_int64 getReadTimeout() const;
+
+  /**
+   * Set write idle timeout. Connection is closed if a write operation can't proceed longer than the timeout.<br>
+   * *Must be set before connections are created with this config.*
+   * @param milliseconds - timeout in milliseconds. `0` - no timeout (default).
+   */
+  void setWriteTimeout(v_int64 milliseconds);
+
+  /**
+   * Get write idle timeout.
+   * @return - timeout in milliseconds. `0` - no timeout.
+   */
+  v_int64 getWriteTimeout() const;
+
+  /**
+   * Release record buffers of connection idle longer than the given time. Buffers are allocated again
+   * by the next operation on the connection. Connection is idle when no bytes moved through its transport
+   * and it has no buffered data. Blocking reader waits for the next record outside of Mbed TLS, reading the record
+   * header from the transport itself - buffers of a connection parked in a blocking read are released too.<br>
+   * *Requires Mbed TLS built with `MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH`.*<br>
+   * *Must be set before connections are created with this config.*
+   * @param milliseconds - idle time in milliseconds. `0` - keep buffers (default).
+   */
+  void setIdleBufferRelease(v_int64 milliseconds);
+
+  /**
+   * Get idle time after which record buffers are released.
+   * @return - idle time in milliseconds. `0` - buffers are kept.
+   */
+  v_int64 getIdleBufferRelease() const;
+
+  /**
+   * Set idle timeout. Connection is closed if no bytes moved through its transport longer than the timeout.
+   * close_notify is written without blocking if no record is being written or read - a blocking reader waiting for the
+   * next record doesn't prevent it. The reader is woken up once close_notify is written.<br>
+   * *Must be set before connections are created with this config.*
+   * @param milliseconds - timeout in milliseconds. `0` - no timeout (default).
+   */
+  void setIdleTimeout(v_int64 milliseconds);
+
+  /**
+   * Get idle timeout.
+   * @return - timeout in milliseconds. `0` - no timeout.
+   */
+  v_int64 getIdleTimeout() const;
+
+  /**
+   * Gather small writes of connections into records of up to `size` bytes of plaintext.
+   * See &id:oatpp::mbedtls::Connection::setWriteCoalescing;. Connections may opt out.<br>
+   * *Gathered data must be flushed with &id:oatpp::mbedtls::Connection::flush; before the connection is released.*<br>
+   * *Must be set before connections are created with this config.*
+   * @param size - max size of gathered data in bytes, `16384` fills a record. `0` - writes are not gathered (default).
+   */
+  void setWriteCoalescing(v_buff_size size);
+
+  /**
+   * Get write coalescing size.
+   * @return - max size of gathered data in bytes. `0` - writes are not gathered.
+   */
+  v_buff_size getWriteCoalescing() const;
+
+  /**
+   * Collect encrypted records of a write operation and pass them to the transport in one write of up to `size` bytes,
+   * instead of one transport write per record. Records larger than the batch are written directly.<br>
+   * *Must be set before connections are created with this config.*
+   * @param size - max size of the batch in bytes, `65536` holds three full records. `0` - write each record separately (default).
+   */
+  void setWriteBatchSize(v_buff_size size);
+
+  /**
+   * Get write batch size.
+   * @return - max size of the batch in bytes. `0` - records are written separately.
+   */
+  v_buff_size getWriteBatchSize() const;
+
+  /**
+   * Read from the transport up to `size` bytes at once and serve Mbed TLS from the connection's buffer.
+   * Mbed TLS reads a record as its header and then its body - with read-ahead both usually come with one transport read.
+   * Buffered bytes are served without waiting for the transport to become readable. Reads not smaller than `size` go to the transport directly.<br>
+   * *Must be set before connections are created with this config.*
+   * @param size - size of the read-ahead buffer in bytes. `0` - no read-ahead (default).
+   */
+  void setReadAheadSize(v_buff_size size);
+
+  /**
+   * Get read-ahead buffer size.
+   * @return - size in bytes. `0` - no read-ahead.
+   */
+  v_buff_size getReadAheadSize() const;
+
+  /**
+   * Set range of protocol versions allowed for connections created with this config.
+   * By default both TLS 1.2 and TLS 1.3 are negotiated if Mbed TLS is built with them.<br>
+   * *Must be set before connections are created with this config.*
+   * @param minVersion - `MBEDTLS_SSL_VERSION_TLS1_2` or `MBEDTLS_SSL_VERSION_TLS1_3`.
+   * @param maxVersion - `MBEDTLS_SSL_VERSION_TLS1_2` or `MBEDTLS_SSL_VERSION_TLS1_3`.
+   */
+  void setTLSVersions(mbedtls_ssl_protocol_version minVersion, mbedtls_ssl_protocol_version maxVersion);
+
+  /**
+   * Set cipher suites, key exchange groups and signature algorithms in order of preference.
+   * Ex.: `config->setPreset(oatpp::mbedtls::Preset::createFastModern());`.<br>
+   * *Must be set before connections are created with this config.*
+   * @param preset - &id:oatpp::mbedtls::Preset;.
+   */
+  void setPreset(const Preset& preset);
+
+  /**
+   * Enable TLS 1.3 early data (0-RTT) on resumed sessions.<br>
+   * Server: accept up to `maxSize` bytes of early data. Received early data is read from the connection as usual and
+   * is flagged by the `tls_early_data` (`accepted`) and `tls_early_data_size` context properties -
+   * it can be replayed by an attacker, so serve only idempotent requests from it.
+   * Each ticket is accepted for early data once, within `antiReplayWindowSeconds` after it was issued.
+   * Requires &l:Config::setSessionTickets ();.<br>
+   * Client: allow sending early data. See &id:oatpp::mbedtls::client::ConnectionProvider::getWithEarlyData;.<br>
+   * Requires Mbed TLS built with `MBEDTLS_SSL_EARLY_DATA`.<br>
+   * *Must be set before connections are created with this config.*
+   * @param maxSize - max size of early data in bytes. `0` - disable early data (default).
+   * @param antiReplayWindowSeconds - server: max age of a ticket which may be used for early data.
+   */
+  void setEarlyData(v_uint32 maxSize, v_int64 antiReplayWindowSeconds = 60);
+
+  /**
+   * Get max size of early data.
+   * @return - max size in bytes. `0` - early data is disabled.
+   */
+  v_uint32 getMaxEarlyDataSize() const;
+
+  /**
+   * Limit size of TLS records to save connection memory.
+   * Client requests the limit from the server (`max_fragment_length` extension, TLS 1.2).
+   * Server grants lengths requested by clients and limits records it sends to this length.<br>
+   * With Mbed TLS built with `MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH` record buffers of a connection shrink to the
+   * negotiated length once handshake is done - ex.: from about 2 x 16 KB to 2 x 4 KB. See &id:oatpp::mbedtls::Connection::getMemoryUsage;.<br>
+   * *Must be set before connections are created with this config.*
+   * @param length - `512`, `1024`, `2048` or `4096`. `0` - no limit (default).
+   */
+  void setMaxFragmentLength(v_uint32 length);
+
+  /**
+   * Get max fragment length.
+   * @return - max fragment length in bytes. `0` - no limit.
+   */
+  v_uint32 getMaxFragmentLength() const;
+
+  /**
+   * Free client certificate of server connections once handshake is done. Certificate is verified during
+   * the handshake and stored sessions/tickets are created before it's freed,
+   * but `mbedtls_ssl_get_peer_cert()` returns `NULL` afterwards.<br>
+   * *Mbed TLS built without `MBEDTLS_SSL_KEEP_PEER_CERTIFICATE` keeps only a digest of the certificate anyway.*
+   * @param trim - `true` to free peer certificate after handshake.
+   */
+  void setTrimPeerCertificate(bool trim);
+
+  /**
+   * Check if peer certificate is freed after handshake.
+   * @return - `true` if peer certificate is freed.
+   */
+  bool getTrimPeerCertificate() const;
+
+  /**
+   * Reuse TLS contexts of closed connections. See &id:oatpp::mbedtls::ContextPool;.<br>
+   * *Must be set before connections are created with this config.*
+   * @param maxSize - max number of free contexts kept. `0` - don't reuse contexts.
+   */
+  void setContextPool(v_int32 maxSize);
+
+  /**
+   * Get context pool.
+   * @return - &id:oatpp::mbedtls::ContextPool; or `nullptr` if contexts aren't reused.
+   */
+  std::shared_ptr<ContextPool> getContextPool();
+
+  /**
+   * Create TLS context set up with this config. Context is taken from the context pool if it's enabled.
+   * @return - `mbedtls_ssl_context*` or `nullptr` if `mbedtls_ssl_setup()` failed.
+   */
+  mbedtls_ssl_context* createTLSContext();
+
+  /**
+   * Destroy TLS context created with &l:Config::createTLSContext ();. Context is returned to the context pool if it's enabled.
+   * @param context - `mbedtls_ssl_context*`.
+   */
+  void destroyTLSContext(mbedtls_ssl_context* context);
+
+  /**
+   * Count completed handshake. Called by &id:oatpp::mbedtls::Connection; once handshake is done.
+   * @param version - negotiated protocol version.
+   */
+  void countHandshake(mbedtls_ssl_protocol_version version);
+
+  /**
+   * Get number of completed handshakes per protocol version.
+   * @return - &l:Config::ProtocolStatistics;.
+   */
+  ProtocolStatistics getProtocolStatistics() const;
+
+  /**
+   * Offload server private key operations to the crypto worker pool.
+   * Handshakes don't run the signature (or RSA decryption) on the thread driving the handshake -
+   * blocking handshakes wait for the worker, asynchronous handshakes yield until the operation is done.<br>
+   * Requires Mbed TLS built with `MBEDTLS_SSL_ASYNC_PRIVATE`.<br>
+   * **Offloads TLS 1.2 handshakes only.** Mbed TLS invokes asynchronous private key callbacks for TLS 1.2 handshakes only -
+   * TLS 1.3 handshakes sign inline on the thread driving the handshake (in parallel, see &id:oatpp::mbedtls::PrivateKey;),
+   * and asynchronous TLS 1.3 handshakes block the executor thread for the duration of the signature.
+   * Limit the server to TLS 1.2 with &l:Config::setTLSVersions (); if every signature must go to the pool.<br>
+   * *Must be set before connections are created with this config.*
+   * @param pool - &id:oatpp::mbedtls::CryptoWorkerPool;. `nullptr` to run private key operations inline.
+   */
+  void setCryptoWorkerPool(const std::shared_ptr<CryptoWorkerPool>& pool);
+
+  /**
+   * Get crypto worker pool.
+   * @return - &id:oatpp::mbedtls::CryptoWorkerPool; or `nullptr` if not set.
+   */
+  std::shared_ptr<CryptoWorkerPool> getCryptoWorkerPool();
+
+  /**
+   * Get private key operation the handshake of `ssl` is waiting for.
+   * @param ssl - `mbedtls_ssl_context*`.
+   * @return - &id:oatpp::mbedtls::PrivateKeyOperation; or `nullptr` if there is no pending operation.
+   */
+  static std::shared_ptr<PrivateKeyOperation> getPendingOperation(mbedtls_ssl_context* ssl);
+
   /**
    * Returns true if server certificate verification is required
    * @return - `bool`
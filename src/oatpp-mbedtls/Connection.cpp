@@ -22,20 +22,86 @@
  *
  ***************************************************************************/
 
+/* Record buffers and peer certificate are reached in the TLS context - fields are private in Mbed TLS 3.x */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
 #include "Connection.hpp"
 
+#include "ConnectionMonitor.hpp"
+
+#include "oatpp/core/utils/ConversionUtils.hpp"
+
 #include "mbedtls/error.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/platform_util.h"
 
+#include <mutex>
 #include <thread>
-#include <chrono>
+#include <cstring>
 
 namespace oatpp { namespace mbedtls {
 
+constexpr int Connection::HANDSHAKE_PENDING;
+constexpr v_int32 Connection::OPERATIONS_EXCLUSIVE;
+constexpr size_t Connection::IDLE_BUFFER_SIZE;
+constexpr v_buff_size Connection::RECORD_HEADER_SIZE;
+
+namespace {
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+
+/* Move record buffer to a new allocation of another size. Pointers into the buffer keep their offsets */
+bool resizeRecordBuffer(unsigned char*& buffer, size_t& bufferLength, size_t length, unsigned char** pointers[], size_t pointersCount) {
+
+  auto resized = static_cast<unsigned char*>(mbedtls_calloc(1, length));
+  if(resized == nullptr) {
+    return false;
+  }
+
+  std::memcpy(resized, buffer, length < bufferLength ? length : bufferLength);
+
+  for(size_t i = 0; i < pointersCount; i ++) {
+    if(*pointers[i] != nullptr) {
+      *pointers[i] = resized + (*pointers[i] - buffer);
+    }
+  }
+
+  mbedtls_zeroize_and_free(buffer, bufferLength);
+
+  buffer = resized;
+  bufferLength = length;
+
+  return true;
+
+}
+
+bool resizeInputBuffer(mbedtls_ssl_context* ssl, size_t length) {
+  unsigned char** pointers[] = {
+    &ssl->in_ctr, &ssl->in_hdr, &ssl->in_len, &ssl->in_iv, &ssl->in_msg, &ssl->in_offt,
+#if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
+    &ssl->in_cid,
+#endif
+  };
+  return resizeRecordBuffer(ssl->in_buf, ssl->in_buf_len, length, pointers, sizeof(pointers) / sizeof(pointers[0]));
+}
+
+bool resizeOutputBuffer(mbedtls_ssl_context* ssl, size_t length) {
+  unsigned char** pointers[] = {
+    &ssl->out_ctr, &ssl->out_hdr, &ssl->out_len, &ssl->out_iv, &ssl->out_msg,
+#if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
+    &ssl->out_cid,
+#endif
+  };
+  return resizeRecordBuffer(ssl->out_buf, ssl->out_buf_len, length, pointers, sizeof(pointers) / sizeof(pointers[0]));
+}
+
+#endif
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ConnectionContext
 
-std::mutex Connection::ConnectionContext::HANDSHAKE_MUTEX;
-
 Connection::ConnectionContext::ConnectionContext(Connection* connection, data::stream::StreamType streamType, Properties&& properties)
   : Context(std::forward<Properties>(properties))
   , m_connection(connection)
@@ -50,69 +116,80 @@ void Connection::ConnectionContext::init() {
 
   m_connection->m_initialized = true;
 
+  /*
+   * Handshake is driven by blocking transport I/O.
+   * BIO callbacks block in the transport until it is ready,
+   * so handshake latency depends on network and crypto only.
+   */
+
   auto inIOMode = m_connection->getInputStreamIOMode();
   auto outIOMode = m_connection->getOutputStreamIOMode();
 
-  m_connection->setInputStreamIOMode(data::stream::IOMode::ASYNCHRONOUS);
-  m_connection->setOutputStreamIOMode(data::stream::IOMode::ASYNCHRONOUS);
+  m_connection->setInputStreamIOMode(data::stream::IOMode::BLOCKING);
+  m_connection->setOutputStreamIOMode(data::stream::IOMode::BLOCKING);
 
-  int res = -1;
-  while(true) {
+  if(m_connection->m_config) {
+    armDeadline(m_connection->m_handshakeDeadline, m_connection->m_config->getHandshakeTimeout());
+  }
 
-    {
+  int res = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
 
-      std::lock_guard<std::mutex> lock(HANDSHAKE_MUTEX);
+  while(true) {
 
-      async::Action action;
+    async::Action action;
+
+    {
 
       IOLockGuard ioGuard(m_connection, &action);
 
-      res = mbedtls_ssl_handshake(m_connection->m_tlsHandle);
+      res = m_connection->handshakeStep();
 
       if(!ioGuard.unpackAndCheck()) {
         OATPP_LOGE("[oatpp::mbedtls::Connection::ConnectionContext::init()]", "Error. Packed action check failed!!!");
-        return;
+        res = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+        break;
       }
 
-      //////////////////////////////////////////////////
-      //**********************************************//
-      //** NOTE: ASYNC ACTION IS INORED             **//
-      //**********************************************//
-
-      // Ignoring an async action is NOT correct !!!
-      //
-      // The Reason:
-      // The connection is intentionally set to IOMode::ASYNCHRONOUS.
-      // This is a workaround for MbedTLS in order NOT to
-      // block accepting thread having HANDSHAKE_MUTEX locked.
-
-//      if(!action.isNone()) {
-//        OATPP_LOGE("[oatpp::mbedtls::Connection::ConnectionContext::init()]", "Error. Using Async stream as transport for blocking stream!!!");
-//        break;
-//      }
+    }
 
-      //////////////////////////////////////////////////
+    if(!action.isNone()) {
+      OATPP_LOGE("[oatpp::mbedtls::Connection::ConnectionContext::init()]", "Error. Transport stream doesn't support blocking I/O.");
+      res = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+      break;
+    }
 
-      if(res == 0) {
-        break;
-      } else if (res != MBEDTLS_ERR_SSL_WANT_READ && res != MBEDTLS_ERR_SSL_WANT_WRITE) {
-//        v_char8 buff[512];
-//        mbedtls_strerror(res, (char *) &buff, 512);
-//        OATPP_LOGE("[oatpp::mbedtls::Connection::ConnectionContext::init()]", "Error. Handshake failed. Return value=%d. '%s'", res, buff);
-        break;
+    // Private key operation is running on the crypto worker pool. Wait for it and continue.
+    if(res == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS) {
+      auto operation = Config::getPendingOperation(m_connection->m_tlsHandle);
+      if(operation) {
+        operation->wait();
       }
-
+      continue;
     }
 
-    if (res == MBEDTLS_ERR_SSL_WANT_READ || res == MBEDTLS_ERR_SSL_WANT_WRITE) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // In blocking mode WANT_READ/WANT_WRITE means that transport call was interrupted. Just repeat.
+    if(res != MBEDTLS_ERR_SSL_WANT_READ && res != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      break;
     }
 
   }
 
+  m_connection->m_handshakeDeadline = 0;
+
+  if(m_connection->m_timedOut) {
+    OATPP_LOGD("[oatpp::mbedtls::Connection::ConnectionContext::init()]", "Error. Handshake timed out.");
+    res = MBEDTLS_ERR_SSL_TIMEOUT;
+  }
+
   m_connection->setInputStreamIOMode(inIOMode);
   m_connection->setOutputStreamIOMode(outIOMode);
 
+  if(res == 0) {
+    m_connection->onHandshakeSuccess();
+  }
+
+  m_connection->m_handshakeResult = res;
+
 }
 
 async::CoroutineStarter Connection::ConnectionContext::initAsync() {
@@ -120,6 +197,7 @@ async::CoroutineStarter Connection::ConnectionContext::initAsync() {
   class HandshakeCoroutine : public oatpp::async::Coroutine<HandshakeCoroutine> {
   private:
     Connection* m_connection;
+    std::shared_ptr<PrivateKeyOperation> m_pendingOperation;
   public:
 
     HandshakeCoroutine(Connection* connection)
@@ -133,22 +211,34 @@ async::CoroutineStarter Connection::ConnectionContext::initAsync() {
       }
 
       m_connection->m_initialized = true;
+
+      if(m_connection->m_config) {
+        armDeadline(m_connection->m_handshakeDeadline, m_connection->m_config->getHandshakeTimeout());
+      }
+
       return yieldTo(&HandshakeCoroutine::doInit);
 
     }
 
     Action doInit() {
 
-      std::lock_guard<std::mutex> lock(HANDSHAKE_MUTEX);
+      /* Deadline is checked on every resume - monitor closes the transport to wake up the coroutine */
+      if(m_connection->m_timedOut || isExpired(m_connection->m_handshakeDeadline, oatpp::base::Environment::getMicroTickCount())) {
+        m_connection->m_timedOut = true;
+        m_connection->m_handshakeDeadline = 0;
+        m_connection->m_handshakeResult = MBEDTLS_ERR_SSL_TIMEOUT;
+        return error<Error>("[oatpp::mbedtls::Connection::ConnectionContext::initAsync()]: Error. Handshake timed out.");
+      }
 
       async::Action action;
       IOLockGuard ioGuard(m_connection, &action);
 
       /* handshake iteration */
-      auto res = mbedtls_ssl_handshake(m_connection->m_tlsHandle);
+      auto res = m_connection->handshakeStep();
 
       if(!ioGuard.unpackAndCheck()) {
         OATPP_LOGE("[oatpp::mbedtls::Connection::ConnectionContext::initAsync()]", "Error. Packed action check failed!!!");
+        m_connection->m_handshakeResult = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
         return error<Error>("[oatpp::mbedtls::Connection::ConnectionContext::initAsync()]: Error. Packed action check failed!!!");
       }
 
@@ -164,12 +254,26 @@ async::CoroutineStarter Connection::ConnectionContext::initAsync() {
         case MBEDTLS_ERR_SSL_WANT_WRITE:
           return repeat();
 
+        case MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS:
+          /* Private key operation is running on the crypto worker pool. Don't block the executor - wait to be notified */
+          m_pendingOperation = Config::getPendingOperation(m_connection->m_tlsHandle);
+          if(m_pendingOperation && !m_pendingOperation->isDone()) {
+            return Action::createWaitListAction(&m_pendingOperation->getWaitList());
+          }
+          return repeat();
+
         case 0:
           /* Handshake successful */
+          m_connection->m_handshakeDeadline = 0;
+          m_connection->onHandshakeSuccess();
+          m_connection->m_handshakeResult = 0;
           return finish();
 
       }
 
+      m_connection->m_handshakeDeadline = 0;
+      m_connection->m_handshakeResult = res;
+
 //      v_char8 buff[512];
 //      mbedtls_strerror(res, (char*)&buff, 512);
 //      OATPP_LOGD("[oatpp::mbedtls::Connection::ConnectionContext::initAsync()]", "Error. Handshake failed. Return value=%d. '%s'", res, buff);
@@ -197,6 +301,10 @@ data::stream::StreamType Connection::ConnectionContext::getStreamType() const {
   return m_streamType;
 }
 
+void Connection::ConnectionContext::putProperty(const oatpp::String& key, const oatpp::String& value) {
+  getMutableProperties().put(key, value);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // IOLockGuard
 
@@ -204,14 +312,17 @@ Connection::IOLockGuard::IOLockGuard(Connection* connection, async::Action* chec
   : m_connection(connection)
   , m_checkAction(checkAction)
 {
+  m_connection->enterOperation();
   m_connection->packIOAction(m_checkAction);
   m_locked = true;
+  m_connection->restoreRecordBuffers();
 }
 
 Connection::IOLockGuard::~IOLockGuard() {
   if(m_locked) {
     m_connection->m_ioLock.unlock();
   }
+  m_connection->leaveOperation();
 }
 
 bool Connection::IOLockGuard::unpackAndCheck() {
@@ -230,10 +341,25 @@ int Connection::writeCallback(void *ctx, const unsigned char *buf, size_t len) {
   async::Action* ioAction = connection->unpackIOAction();
 
   v_io_size res;
-  if(ioAction && ioAction->isNone()) {
+  if(connection->m_captureClientHello) {
+    /* Server replies before the certificate is selected only with a HelloRetryRequest - the next ClientHello is captured anew */
+    connection->m_clientHello.clear();
+  }
+
+  res = 0;
+  if(connection->m_writeBatchSize > 0) {
+    std::lock_guard<std::mutex> lock(connection->m_writeBatchLock);
+    res = connection->stageRecord(buf, len, ioAction);
+  }
+
+  if(res != 0) {
+    // record is staged, or staged records must go first
+  } else if(ioAction && ioAction->isNone()) {
     res = connection->m_stream.object->write(buf, len, *ioAction);
     if(res == IOError::RETRY_READ || res == IOError::RETRY_WRITE) {
       res = MBEDTLS_ERR_SSL_WANT_WRITE;
+    } else if(res > 0 && connection->m_monitored) {
+      connection->m_lastActivity = oatpp::base::Environment::getMicroTickCount();
     }
   } else if(ioAction == nullptr) {
     res = len; // NOTE: Ignore client notification on connection close;
@@ -254,15 +380,46 @@ int Connection::readCallback(void *ctx, unsigned char *buf, size_t len) {
   async::Action* ioAction = connection->unpackIOAction();
 
   v_io_size res;
-  if(ioAction && ioAction->isNone()) {
-    res = connection->m_stream.object->read(buf, len, *ioAction);
+  if(connection->m_recordHeaderPosition < connection->m_recordHeaderLength) {
+    /* Bytes read while the reader waited outside of Mbed TLS go first */
+    auto available = connection->m_recordHeaderLength - connection->m_recordHeaderPosition;
+    res = (v_buff_size) len < available ? (v_buff_size) len : available;
+    std::memcpy(buf, connection->m_recordHeader + connection->m_recordHeaderPosition, (size_t) res);
+    connection->m_recordHeaderPosition += res;
+  } else if(connection->m_readAheadPosition < connection->m_readAheadLength) {
+    /* Bytes read ahead are served without transport I/O - they never wait for the transport to become readable */
+    res = connection->serveReadAhead(buf, len);
+  } else if(ioAction && ioAction->isNone()) {
+    if((v_buff_size) len < connection->m_readAheadSize) {
+      res = connection->fillReadAhead(*ioAction);
+      if(res > 0) {
+        connection->serveReadAhead(buf, len);
+      }
+    } else {
+      res = connection->m_stream.object->read(buf, len, *ioAction);
+    }
     if(res == IOError::RETRY_READ || res == IOError::RETRY_WRITE) {
       res = MBEDTLS_ERR_SSL_WANT_READ;
+    } else if(res > 0) {
+      if(connection->m_monitored) {
+        connection->m_lastActivity = oatpp::base::Environment::getMicroTickCount();
+      }
+      res = res < (v_io_size) len ? res : (v_io_size) len;
     }
   } else {
     res = MBEDTLS_ERR_SSL_WANT_READ;
   }
 
+  /* ClientHello is captured as it's served to Mbed TLS */
+  if(res > 0 && connection->m_captureClientHello) {
+    if((v_buff_size) connection->m_clientHello.size() + res <= CLIENT_HELLO_MAX_SIZE) {
+      connection->m_clientHello.append((const char*) buf, (size_t) res);
+    } else {
+      connection->m_captureClientHello = false;
+      std::string().swap(connection->m_clientHello);
+    }
+  }
+
   connection->packIOAction(ioAction);
 
   return (int)res;
@@ -270,18 +427,78 @@ int Connection::readCallback(void *ctx, unsigned char *buf, size_t len) {
 
 }
 
+v_io_size Connection::fillReadAhead(async::Action& action) {
+  if((v_buff_size) m_readAhead.size() < m_readAheadSize) {
+    m_readAhead.resize((size_t) m_readAheadSize);
+  }
+  auto res = m_stream.object->read(&m_readAhead[0], m_readAheadSize, action);
+  if(res > 0) {
+    m_readAheadPosition = 0;
+    m_readAheadLength = res;
+  }
+  return res;
+}
+
+v_io_size Connection::serveReadAhead(unsigned char* buf, size_t len) {
+  auto available = m_readAheadLength - m_readAheadPosition;
+  auto size = (v_buff_size) len < available ? (v_buff_size) len : available;
+  std::memcpy(buf, m_readAhead.data() + m_readAheadPosition, (size_t) size);
+  m_readAheadPosition += size;
+  return size;
+}
+
 void Connection::setTLSStreamBIOCallbacks(mbedtls_ssl_context* tlsHandle, Connection* connection) {
   mbedtls_ssl_set_bio(tlsHandle, connection, writeCallback, readCallback, NULL);
 }
 
-Connection::Connection(mbedtls_ssl_context* tlsHandle, const provider::ResourceHandle<data::stream::IOStream>& stream, bool initialized)
+Connection::Connection(mbedtls_ssl_context* tlsHandle,
+                       const provider::ResourceHandle<data::stream::IOStream>& stream,
+                       bool initialized,
+                       const std::shared_ptr<Config>& config)
   : m_tlsHandle(tlsHandle)
   , m_stream(stream)
   , m_initialized(initialized)
+  , m_handshakeResult(initialized ? 0 : HANDSHAKE_PENDING)
   , m_ioAction(nullptr)
+  , m_config(config)
+  , m_handshakeDeadline(0)
+  , m_readDeadline(0)
+  , m_writeDeadline(0)
+  , m_timedOut(false)
+  , m_monitored(false)
+  , m_earlyDataPosition(0)
+  , m_earlyDataState(EARLY_DATA_NONE)
+  , m_earlyDataStatus(nullptr)
+  , m_captureClientHello(false)
+  , m_selectedCertificate(nullptr)
+  , m_operations(0)
+  , m_lastActivity(oatpp::base::Environment::getMicroTickCount())
+  , m_buffersReleased(false)
+  , m_inBufferLength(0)
+  , m_outBufferLength(0)
+  , m_waitOutsideTLS(config && (config->getIdleBufferRelease() > 0 || config->getIdleTimeout() > 0))
+  , m_recordHeaderPosition(0)
+  , m_recordHeaderLength(0)
+  , m_writeCoalescing(config ? config->getWriteCoalescing() : 0)
+  , m_writeBufferPosition(0)
+  , m_pendingWriteSize(0)
+  , m_gatheredSize(0)
+  , m_writeBatchSize(config ? config->getWriteBatchSize() : 0)
+  , m_writeBatchPosition(0)
+  , m_writeBatchAccepted(0)
+  , m_gathering(false)
+  , m_readAheadSize(config ? config->getReadAheadSize() : 0)
+  , m_readAheadPosition(0)
+  , m_readAheadLength(0)
 {
 
   setTLSStreamBIOCallbacks(m_tlsHandle, this);
+  mbedtls_ssl_set_user_data_p(m_tlsHandle, this);
+
+  if(!m_initialized && m_config) {
+    auto certificateStore = m_config->getCertificateStore();
+    m_captureClientHello = certificateStore && certificateStore->hasKeyAlternatives();
+  }
 
   auto& streamInContext = stream.object->getInputStreamContext();
 
@@ -305,10 +522,21 @@ Connection::Connection(mbedtls_ssl_context* tlsHandle, const provider::ResourceH
 
   }
 
+  if(m_config && (m_config->getHandshakeTimeout() > 0 || m_config->getReadTimeout() > 0 || m_config->getWriteTimeout() > 0 ||
+                  m_config->getIdleBufferRelease() > 0 || m_config->getIdleTimeout() > 0))
+  {
+    m_monitored = true;
+    ConnectionMonitor::getInstance().add(this);
+  }
+
 }
 
 Connection::~Connection(){
 
+  if(m_monitored) {
+    ConnectionMonitor::getInstance().remove(this);
+  }
+
   if(m_inContext == m_outContext) {
     delete m_inContext;
   } else {
@@ -316,8 +544,16 @@ Connection::~Connection(){
     delete m_outContext;
   }
   closeTLS();
-  mbedtls_ssl_free(m_tlsHandle);
-  delete m_tlsHandle;
+  if(m_config) {
+    if(m_config->getContextPool()) {
+      /* Next connection gets the context with full size buffers */
+      restoreRecordBuffers();
+    }
+    m_config->destroyTLSContext(m_tlsHandle);
+  } else {
+    mbedtls_ssl_free(m_tlsHandle);
+    delete m_tlsHandle;
+  }
 }
 
 void Connection::packIOAction(async::Action* action) {
@@ -334,6 +570,28 @@ async::Action* Connection::unpackIOAction() {
 
 v_io_size Connection::write(const void *buff, v_buff_size count, async::Action& action){
 
+  if(m_timedOut) {
+    return oatpp::IOError::BROKEN_PIPE;
+  }
+
+  if(m_writeCoalescing > 0) {
+    return writeCoalesced(buff, count, action);
+  }
+
+  return writeRecords(buff, count, action);
+
+}
+
+v_io_size Connection::writeRecords(const void *buff, v_buff_size count, async::Action& action) {
+
+  if(m_writeBatchSize > 0) {
+    return writeBatched(buff, count, action);
+  }
+
+  if(m_config) {
+    armDeadline(m_writeDeadline, m_config->getWriteTimeout());
+  }
+
   IOLockGuard ioGuard(this, &action);
 
   auto result = mbedtls_ssl_write(m_tlsHandle, (const unsigned char *) buff, (size_t)count);
@@ -350,18 +608,359 @@ v_io_size Connection::write(const void *buff, v_buff_size count, async::Action&
       case MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS:   return oatpp::IOError::RETRY_WRITE;
       case MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS:  return oatpp::IOError::RETRY_WRITE;
       default:
+        m_writeDeadline = 0;
         return oatpp::IOError::BROKEN_PIPE;
     }
   }
 
+  /* Write deadline is kept while operation is being retried */
+  m_writeDeadline = 0;
   return result;
 
 }
 
+v_io_size Connection::writeBatched(const void *buff, v_buff_size count, async::Action& action) {
+
+  if(m_config) {
+    armDeadline(m_writeDeadline, m_config->getWriteTimeout());
+  }
+
+  /* Previous call encrypted the data, but the transport didn't take all of it. The call is repeated with the same data */
+  if(m_writeBatchAccepted > 0) {
+    v_io_size res;
+    {
+      std::lock_guard<std::mutex> lock(m_writeBatchLock);
+      res = drainWriteBatch(action);
+    }
+    if(res != 0) {
+      if(res != oatpp::IOError::RETRY_WRITE) {
+        m_writeDeadline = 0;
+      }
+      return res;
+    }
+    auto accepted = m_writeBatchAccepted;
+    m_writeBatchAccepted = 0;
+    m_writeDeadline = 0;
+    return accepted;
+  }
+
+  v_buff_size accepted = 0;
+
+  while(true) {
+
+    int result = 0;
+
+    {
+
+      IOLockGuard ioGuard(this, &action);
+
+      /* Records are staged by writeCallback until the batch is full */
+      m_gathering = true;
+      while(accepted < count) {
+        result = mbedtls_ssl_write(m_tlsHandle, (const unsigned char *) buff + accepted, (size_t) (count - accepted));
+        if(result < 0) {
+          break;
+        }
+        accepted += result;
+      }
+      m_gathering = false;
+
+      if(!ioGuard.unpackAndCheck()) {
+        OATPP_LOGE("[oatpp::mbedtls::Connection::writeBatched(...)]", "Error. Packed action check failed!!!");
+        return oatpp::IOError::BROKEN_PIPE;
+      }
+
+    }
+
+    v_io_size res;
+    {
+      std::lock_guard<std::mutex> lock(m_writeBatchLock);
+      res = drainWriteBatch(action);
+    }
+
+    if(res == oatpp::IOError::RETRY_WRITE) {
+      m_writeBatchAccepted = accepted;
+      return oatpp::IOError::RETRY_WRITE;
+    }
+
+    if(res != 0) {
+      m_writeDeadline = 0;
+      return oatpp::IOError::BROKEN_PIPE;
+    }
+
+    if(result >= 0) {
+      break;
+    }
+
+    switch (result) {
+      /* Batch was full - it's written now, continue with the record Mbed TLS holds */
+      case MBEDTLS_ERR_SSL_WANT_WRITE:
+        if(!action.isNone()) {
+          /* Record larger than the batch went to the transport directly and has to wait */
+          m_writeBatchAccepted = accepted;
+          return oatpp::IOError::RETRY_WRITE;
+        }
+        continue;
+      case MBEDTLS_ERR_SSL_WANT_READ:
+      case MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS:
+      case MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS:
+        return accepted > 0 ? accepted : oatpp::IOError::RETRY_WRITE;
+      default:
+        m_writeDeadline = 0;
+        return accepted > 0 ? accepted : oatpp::IOError::BROKEN_PIPE;
+    }
+
+  }
+
+  m_writeDeadline = 0;
+  return accepted;
+
+}
+
+v_io_size Connection::stageRecord(const unsigned char* buf, size_t len, async::Action* ioAction) {
+
+  auto staged = (v_buff_size) m_writeBatch.size() - m_writeBatchPosition;
+
+  if(m_gathering) {
+    if(staged + (v_buff_size) len <= m_writeBatchSize) {
+      m_writeBatch.append((const char*) buf, len);
+      return (v_io_size) len;
+    }
+    if(staged > 0) {
+      return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    return 0; // record is larger than the batch
+  }
+
+  if(staged > 0) {
+    if(ioAction == nullptr) {
+      return 0;
+    }
+    if(!ioAction->isNone()) {
+      return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    auto res = drainWriteBatch(*ioAction);
+    if(res == oatpp::IOError::RETRY_WRITE) {
+      return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    if(res != 0) {
+      return res;
+    }
+  }
+
+  return 0;
+
+}
+
+v_io_size Connection::drainWriteBatch(async::Action& action) {
+
+  while(m_writeBatchPosition < (v_buff_size) m_writeBatch.size()) {
+
+    auto res = m_stream.object->write(m_writeBatch.data() + m_writeBatchPosition,
+                                      (v_buff_size) m_writeBatch.size() - m_writeBatchPosition, action);
+
+    if(res == oatpp::IOError::RETRY_READ || res == oatpp::IOError::RETRY_WRITE) {
+      return oatpp::IOError::RETRY_WRITE;
+    }
+
+    if(res <= 0) {
+      return oatpp::IOError::BROKEN_PIPE;
+    }
+
+    m_writeBatchPosition += res;
+
+    if(m_monitored) {
+      m_lastActivity = oatpp::base::Environment::getMicroTickCount();
+    }
+
+  }
+
+  m_writeBatch.clear();
+  m_writeBatchPosition = 0;
+
+  return 0;
+
+}
+
+v_io_size Connection::writeCoalesced(const void *buff, v_buff_size count, async::Action& action) {
+
+  std::lock_guard<std::mutex> lock(m_writeLock);
+
+  auto buffered = (v_buff_size) m_writeBuffer.size() - m_writeBufferPosition;
+
+  if(buffered + count <= m_writeCoalescing) {
+    m_writeBuffer.append((const char*) buff, (size_t) count);
+    m_gatheredSize = buffered + count;
+    if(buffered + count == m_writeCoalescing) {
+      /* Data is accepted either way - if transport isn't ready, it's written by the next call */
+      async::Action flushAction;
+      if(flushWriteBuffer(flushAction) == oatpp::IOError::BROKEN_PIPE) {
+        return oatpp::IOError::BROKEN_PIPE;
+      }
+    }
+    return count;
+  }
+
+  /* Doesn't fit - gathered data goes first */
+  auto res = flushWriteBuffer(action);
+  if(res != 0) {
+    return res;
+  }
+
+  if(count >= m_writeCoalescing) {
+    return writeRecords(buff, count, action);
+  }
+
+  m_writeBuffer.append((const char*) buff, (size_t) count);
+  m_gatheredSize = count;
+  return count;
+
+}
+
+v_io_size Connection::flushWriteBuffer(async::Action& action) {
+
+  while(m_writeBufferPosition < (v_buff_size) m_writeBuffer.size()) {
+
+    auto size = m_pendingWriteSize > 0 ? m_pendingWriteSize : (v_buff_size) m_writeBuffer.size() - m_writeBufferPosition;
+
+    auto res = writeRecords(m_writeBuffer.data() + m_writeBufferPosition, size, action);
+
+    if(res == oatpp::IOError::RETRY_WRITE || res == oatpp::IOError::RETRY_READ) {
+      m_pendingWriteSize = size;
+      return oatpp::IOError::RETRY_WRITE;
+    }
+
+    if(res <= 0) {
+      return oatpp::IOError::BROKEN_PIPE;
+    }
+
+    m_pendingWriteSize = 0;
+    m_writeBufferPosition += res;
+    m_gatheredSize = (v_buff_size) m_writeBuffer.size() - m_writeBufferPosition;
+
+  }
+
+  m_writeBuffer.clear();
+  m_writeBufferPosition = 0;
+
+  return 0;
+
+}
+
+void Connection::setWriteCoalescing(v_buff_size size) {
+  m_writeCoalescing = size > 0 ? size : 0;
+}
+
+v_buff_size Connection::getWriteCoalescing() const {
+  return m_writeCoalescing;
+}
+
+v_buff_size Connection::getGatheredSize() const {
+  return m_gatheredSize;
+}
+
+v_io_size Connection::flush(async::Action& action) {
+
+  if(m_timedOut) {
+    return oatpp::IOError::BROKEN_PIPE;
+  }
+
+  std::lock_guard<std::mutex> lock(m_writeLock);
+  return flushWriteBuffer(action);
+
+}
+
+async::CoroutineStarter Connection::flushAsync() {
+
+  class FlushCoroutine : public oatpp::async::Coroutine<FlushCoroutine> {
+  private:
+    Connection* m_connection;
+  public:
+
+    FlushCoroutine(Connection* connection)
+      : m_connection(connection)
+    {}
+
+    Action act() override {
+
+      async::Action action;
+      auto res = m_connection->flush(action);
+
+      if(res == 0) {
+        return finish();
+      }
+
+      if(res == oatpp::IOError::RETRY_WRITE) {
+        if(!action.isNone()) {
+          return action;
+        }
+        return repeat();
+      }
+
+      return error<Error>("[oatpp::mbedtls::Connection::flushAsync()]: Error. Failed to write gathered data.");
+
+    }
+
+  };
+
+  return FlushCoroutine::start(this);
+
+}
+
 v_io_size Connection::read(void *buff, v_buff_size count, async::Action& action){
 
+  if(m_timedOut) {
+    return oatpp::IOError::BROKEN_PIPE;
+  }
+
+  if(m_earlyDataState == EARLY_DATA_RECEIVED) {
+    auto available = (v_buff_size) m_earlyData.size() - m_earlyDataPosition;
+    if(available > 0) {
+      auto size = count < available ? count : available;
+      std::memcpy(buff, m_earlyData.data() + m_earlyDataPosition, size);
+      m_earlyDataPosition += size;
+      return size;
+    }
+    m_earlyDataState = EARLY_DATA_NONE;
+    std::string().swap(m_earlyData);
+  }
+
+  /* Peer likely waits for the gathered data before it sends anything */
+  if(m_writeCoalescing > 0) {
+    auto res = flush(action);
+    if(res == oatpp::IOError::RETRY_WRITE) {
+      return oatpp::IOError::RETRY_READ;
+    }
+    if(res != 0) {
+      return res;
+    }
+  }
+
+  if(m_config) {
+    armDeadline(m_readDeadline, m_config->getReadTimeout());
+  }
+
+  unsigned char header[RECORD_HEADER_SIZE];
+  v_io_size headerSize = 0;
+
+  if(m_waitOutsideTLS) {
+    headerSize = waitForRecord(header, action);
+    if(headerSize < 0) {
+      if(headerSize != oatpp::IOError::RETRY_READ) {
+        m_readDeadline = 0;
+      }
+      return headerSize;
+    }
+  }
+
   IOLockGuard ioGuard(this, &action);
 
+  if(headerSize > 0) {
+    std::memcpy(m_recordHeader, header, (size_t) headerSize);
+    m_recordHeaderPosition = 0;
+    m_recordHeaderLength = headerSize;
+  }
+
   auto result = mbedtls_ssl_read(m_tlsHandle, (unsigned char *) buff, (size_t)count);
 
   if(!ioGuard.unpackAndCheck()) {
@@ -375,11 +974,24 @@ v_io_size Connection::read(void *buff, v_buff_size count, async::Action& action)
       case MBEDTLS_ERR_SSL_WANT_WRITE:          return oatpp::IOError::RETRY_READ;
       case MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS:   return oatpp::IOError::RETRY_READ;
       case MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS:  return oatpp::IOError::RETRY_READ;
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+      /* TLS 1.3 ticket arrived after the handshake. It's stored in the session - read application data again */
+      case MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET: return oatpp::IOError::RETRY_READ;
+#endif
+#if defined(MBEDTLS_SSL_EARLY_DATA) && defined(MBEDTLS_SSL_SRV_C)
+      /* Handshake was driven by read and the client sent early data - buffer it and serve from the buffer */
+      case MBEDTLS_ERR_SSL_RECEIVED_EARLY_DATA:
+        receiveEarlyData();
+        return oatpp::IOError::RETRY_READ;
+#endif
       default:
+        m_readDeadline = 0;
         return oatpp::IOError::BROKEN_PIPE;
     }
   }
 
+  /* Read deadline is kept while operation is being retried */
+  m_readDeadline = 0;
   return result;
 
 }
@@ -412,6 +1024,478 @@ void Connection::closeTLS(){
   mbedtls_ssl_close_notify(m_tlsHandle);
 }
 
+const std::string& Connection::getClientHello() const {
+  return m_clientHello;
+}
+
+void Connection::onCertificateSelected(mbedtls_x509_crt* certificate) {
+  m_selectedCertificate = certificate;
+  m_captureClientHello = false;
+  std::string().swap(m_clientHello);
+}
+
+mbedtls_x509_crt* Connection::getSelectedCertificate() const {
+  return m_selectedCertificate;
+}
+
+int Connection::getHandshakeResult() const {
+  return m_handshakeResult;
+}
+
+int Connection::getSession(mbedtls_ssl_session* session) {
+  std::lock_guard<concurrency::SpinLock> lock(m_ioLock);
+  return mbedtls_ssl_get_session(m_tlsHandle, session);
+}
+
+int Connection::handshakeStep() {
+
+#if defined(MBEDTLS_SSL_EARLY_DATA) && defined(MBEDTLS_SSL_CLI_C)
+  while(m_earlyDataState == EARLY_DATA_WRITE) {
+    if(m_earlyDataPosition == (v_buff_size) m_earlyData.size()) {
+      m_earlyDataState = EARLY_DATA_HANDSHAKE;
+      break;
+    }
+    auto res = mbedtls_ssl_write_early_data(m_tlsHandle, (const unsigned char*) m_earlyData.data() + m_earlyDataPosition,
+                                            m_earlyData.size() - m_earlyDataPosition);
+    if(res == MBEDTLS_ERR_SSL_CANNOT_WRITE_EARLY_DATA) {
+      /* No ticket allowing early data, or the limit is reached - the rest goes after the handshake */
+      m_earlyDataState = EARLY_DATA_HANDSHAKE;
+      break;
+    }
+    if(res < 0) {
+      return res;
+    }
+    m_earlyDataPosition += res;
+  }
+#endif
+
+  if(m_earlyDataState == EARLY_DATA_WRITE) {
+    m_earlyDataState = EARLY_DATA_HANDSHAKE;
+  }
+
+  auto res = mbedtls_ssl_handshake(m_tlsHandle);
+
+#if defined(MBEDTLS_SSL_EARLY_DATA) && defined(MBEDTLS_SSL_SRV_C)
+  if(res == MBEDTLS_ERR_SSL_RECEIVED_EARLY_DATA) {
+    receiveEarlyData();
+    return MBEDTLS_ERR_SSL_WANT_READ; // continue handshake
+  }
+#endif
+
+  if(res != 0) {
+    return res;
+  }
+
+  if(m_earlyDataState == EARLY_DATA_HANDSHAKE) {
+    m_earlyDataStatus = "not_sent";
+#if defined(MBEDTLS_SSL_EARLY_DATA) && defined(MBEDTLS_SSL_CLI_C)
+    switch(mbedtls_ssl_get_early_data_status(m_tlsHandle)) {
+      case MBEDTLS_SSL_EARLY_DATA_STATUS_ACCEPTED: m_earlyDataStatus = "accepted"; break;
+      case MBEDTLS_SSL_EARLY_DATA_STATUS_REJECTED: m_earlyDataStatus = "rejected"; m_earlyDataPosition = 0; break;
+      default: m_earlyDataPosition = 0;
+    }
+#else
+    m_earlyDataPosition = 0;
+#endif
+    m_earlyDataState = EARLY_DATA_RESEND;
+  }
+
+  while(m_earlyDataState == EARLY_DATA_RESEND) {
+    if(m_earlyDataPosition == (v_buff_size) m_earlyData.size()) {
+      m_earlyDataState = EARLY_DATA_NONE;
+      break;
+    }
+    res = mbedtls_ssl_write(m_tlsHandle, (const unsigned char*) m_earlyData.data() + m_earlyDataPosition,
+                            m_earlyData.size() - m_earlyDataPosition);
+    if(res < 0) {
+      return res;
+    }
+    m_earlyDataPosition += res;
+  }
+
+  return 0;
+
+}
+
+void Connection::receiveEarlyData() {
+#if defined(MBEDTLS_SSL_EARLY_DATA) && defined(MBEDTLS_SSL_SRV_C)
+  /* Size of early data is limited by Config::setEarlyData() - Mbed TLS rejects more */
+  unsigned char buffer[1024];
+  while(true) {
+    auto res = mbedtls_ssl_read_early_data(m_tlsHandle, buffer, sizeof(buffer));
+    if(res <= 0) {
+      break;
+    }
+    m_earlyData.append((const char*) buffer, (size_t) res);
+  }
+  if(!m_earlyData.empty()) {
+    m_earlyDataState = EARLY_DATA_RECEIVED;
+    m_earlyDataStatus = "accepted";
+  }
+#endif
+}
+
+void Connection::setEarlyData(const oatpp::String& data) {
+  if(m_initialized) {
+    throw std::runtime_error("[oatpp::mbedtls::Connection::setEarlyData()]: Error. Handshake is already started.");
+  }
+  m_earlyData.assign(data ? data->data() : "", data ? data->size() : 0);
+  m_earlyDataPosition = 0;
+  m_earlyDataState = EARLY_DATA_WRITE;
+}
+
+void Connection::onHandshakeSuccess() {
+
+  /* Resumed handshakes may finish without selecting a certificate */
+  if(m_captureClientHello) {
+    m_captureClientHello = false;
+    std::string().swap(m_clientHello);
+  }
+
+  oatpp::String version = mbedtls_ssl_get_version(m_tlsHandle);
+  oatpp::String cipherSuite = mbedtls_ssl_get_ciphersuite(m_tlsHandle);
+
+  m_inContext->putProperty("tls_version", version);
+  m_inContext->putProperty("tls_ciphersuite", cipherSuite);
+  if(m_outContext != m_inContext) {
+    m_outContext->putProperty("tls_version", version);
+    m_outContext->putProperty("tls_ciphersuite", cipherSuite);
+  }
+
+  if(m_earlyDataStatus != nullptr) {
+    m_inContext->putProperty("tls_early_data", m_earlyDataStatus);
+    m_inContext->putProperty("tls_early_data_size", oatpp::utils::conversion::int64ToStr((v_int64) m_earlyData.size()));
+    if(m_outContext != m_inContext) {
+      m_outContext->putProperty("tls_early_data", m_earlyDataStatus);
+      m_outContext->putProperty("tls_early_data_size", oatpp::utils::conversion::int64ToStr((v_int64) m_earlyData.size()));
+    }
+  }
+
+  if(m_earlyDataState != EARLY_DATA_RECEIVED) {
+    std::string().swap(m_earlyData);
+  }
+
+  if(m_config) {
+    m_config->countHandshake(mbedtls_ssl_get_version_number(m_tlsHandle));
+    if(m_tlsHandle->conf->endpoint == MBEDTLS_SSL_IS_SERVER) {
+      auto certificateStore = m_config->getCertificateStore();
+      if(certificateStore) {
+        certificateStore->onHandshakeDone(m_tlsHandle, m_selectedCertificate);
+      }
+    }
+    if(m_config->getTrimPeerCertificate()) {
+      trimPeerCertificate();
+    }
+  }
+
+}
+
+void Connection::trimPeerCertificate() {
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+  /* Client side keeps it - client session cache tells resumption by the presence of the certificate */
+  auto session = m_tlsHandle->session;
+  if(m_tlsHandle->conf->endpoint == MBEDTLS_SSL_IS_SERVER && session != nullptr && session->peer_cert != nullptr) {
+    mbedtls_x509_crt_free(session->peer_cert);
+    mbedtls_free(session->peer_cert);
+    session->peer_cert = nullptr;
+  }
+#endif
+}
+
+v_buff_size Connection::getMemoryUsage() const {
+
+  v_buff_size result = sizeof(Connection) + sizeof(mbedtls_ssl_context);
+  result += (v_buff_size) (m_earlyData.capacity() + m_clientHello.capacity());
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+  if(m_tlsHandle->in_buf != nullptr) {
+    result += (v_buff_size) m_tlsHandle->in_buf_len;
+  }
+  if(m_tlsHandle->out_buf != nullptr) {
+    result += (v_buff_size) m_tlsHandle->out_buf_len;
+  }
+#else
+  if(m_tlsHandle->in_buf != nullptr) {
+    result += MBEDTLS_SSL_IN_CONTENT_LEN;
+  }
+  if(m_tlsHandle->out_buf != nullptr) {
+    result += MBEDTLS_SSL_OUT_CONTENT_LEN;
+  }
+#endif
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+  if(m_tlsHandle->session != nullptr) {
+    for(auto crt = m_tlsHandle->session->peer_cert; crt != nullptr; crt = crt->next) {
+      result += (v_buff_size) (sizeof(mbedtls_x509_crt) + crt->raw.len);
+    }
+  }
+#endif
+
+  return result;
+
+}
+
+void Connection::armDeadline(std::atomic<v_int64>& deadline, v_int64 timeoutMilliseconds) {
+  if(timeoutMilliseconds > 0 && deadline == 0) {
+    deadline = oatpp::base::Environment::getMicroTickCount() + timeoutMilliseconds * 1000;
+  }
+}
+
+bool Connection::isExpired(const std::atomic<v_int64>& deadline, v_int64 tick) {
+  v_int64 value = deadline;
+  return value != 0 && tick > value;
+}
+
+bool Connection::areRecordBuffersReleased() const {
+  return m_buffersReleased;
+}
+
+bool Connection::isTimedOut() const {
+  return m_timedOut;
+}
+
+void Connection::enterOperation() {
+  v_int32 operations = m_operations.load();
+  while(true) {
+    if(operations == OPERATIONS_EXCLUSIVE) {
+      /* Monitor is releasing buffers or closing the connection - it takes microseconds */
+      std::this_thread::yield();
+      operations = m_operations.load();
+    } else if(m_operations.compare_exchange_weak(operations, operations + 1)) {
+      break;
+    }
+  }
+}
+
+void Connection::leaveOperation() {
+  -- m_operations;
+}
+
+bool Connection::tryEnterExclusive() {
+  v_int32 expected = 0;
+  return m_operations.compare_exchange_strong(expected, OPERATIONS_EXCLUSIVE);
+}
+
+void Connection::leaveExclusive() {
+  m_operations = 0;
+}
+
+bool Connection::releaseRecordBuffers() {
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+
+  auto ssl = m_tlsHandle;
+
+  if(m_buffersReleased || ssl->in_buf == nullptr || ssl->out_buf == nullptr) {
+    return false;
+  }
+
+  if(!isBetweenRecords() || ssl->out_left != 0) {
+    return false;
+  }
+
+  /* Read-ahead buffer is allocated again by the next transport read */
+  std::string().swap(m_readAhead);
+
+  m_inBufferLength = ssl->in_buf_len;
+  m_outBufferLength = ssl->out_buf_len;
+
+  /* Idle buffers still hold an alert record, so close_notify is written without reallocation */
+  bool released = false;
+  if(ssl->in_buf_len > IDLE_BUFFER_SIZE) {
+    released = resizeInputBuffer(ssl, IDLE_BUFFER_SIZE) || released;
+  }
+  if(ssl->out_buf_len > IDLE_BUFFER_SIZE) {
+    released = resizeOutputBuffer(ssl, IDLE_BUFFER_SIZE) || released;
+  }
+
+  m_buffersReleased = released;
+  return released;
+
+#else
+  return false;
+#endif
+}
+
+void Connection::restoreRecordBuffers() {
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+
+  if(!m_buffersReleased) {
+    return;
+  }
+
+  auto ssl = m_tlsHandle;
+
+  /* On allocation failure buffers stay small - Mbed TLS rejects records which don't fit, and the next operation retries */
+  bool restored = true;
+  if(ssl->in_buf_len < m_inBufferLength) {
+    restored = resizeInputBuffer(ssl, m_inBufferLength) && restored;
+  }
+  if(ssl->out_buf_len < m_outBufferLength) {
+    restored = resizeOutputBuffer(ssl, m_outBufferLength) && restored;
+  }
+
+  m_buffersReleased = !restored;
+
+#endif
+}
+
+void Connection::sendCloseNotify() {
+
+  /* Monitor thread must not block on the transport */
+  auto ioMode = m_stream.object->getOutputStreamIOMode();
+  m_stream.object->setOutputStreamIOMode(data::stream::IOMode::ASYNCHRONOUS);
+
+  async::Action action;
+  packIOAction(&action);
+  mbedtls_ssl_close_notify(m_tlsHandle);
+  unpackIOAction();
+
+  m_stream.object->setOutputStreamIOMode(ioMode);
+
+}
+
+bool Connection::checkIdle(v_int64 tick) {
+
+  if(m_handshakeResult != 0 || m_timedOut) {
+    return false;
+  }
+
+  v_int64 idleTime = tick - m_lastActivity;
+  v_int64 idleTimeout = m_config->getIdleTimeout() * 1000;
+  v_int64 bufferRelease = m_config->getIdleBufferRelease() * 1000;
+
+  bool reap = idleTimeout > 0 && idleTime > idleTimeout;
+  bool release = bufferRelease > 0 && idleTime > bufferRelease && !m_buffersReleased;
+
+  if(!reap && !release) {
+    return false;
+  }
+
+  if(!tryEnterExclusive()) {
+    /*
+     * Operation is inside Mbed TLS - a record is being written or read, and close_notify can't be put in between.
+     * It's woken up by closing the transport. Blocking reader waiting for the next record isn't counted here.
+     */
+    if(reap && !m_timedOut.exchange(true)) {
+      m_stream.invalidator->invalidate(m_stream.object);
+    }
+    return false;
+  }
+
+  if(reap) {
+    /* Reader waiting for the next record sees the flag as soon as the transport is closed. Exclusive is kept until reap() */
+    m_timedOut = true;
+    return true;
+  }
+
+  releaseRecordBuffers();
+  leaveExclusive();
+
+  return false;
+
+}
+
+void Connection::reap() {
+  sendCloseNotify();
+  leaveExclusive();
+  m_stream.invalidator->invalidate(m_stream.object);
+}
+
+bool Connection::isBetweenRecords() const {
+  /* Nothing buffered - neither plaintext for the reader nor a partial incoming record */
+  return mbedtls_ssl_check_pending(m_tlsHandle) == 0 && m_tlsHandle->in_left == 0 &&
+         m_readAheadPosition >= m_readAheadLength && m_recordHeaderPosition >= m_recordHeaderLength;
+}
+
+v_io_size Connection::waitForRecord(unsigned char* header, async::Action& action) {
+
+  if(m_stream.object->getInputStreamIOMode() != data::stream::IOMode::BLOCKING || m_handshakeResult != 0) {
+    return 0;
+  }
+
+  bool betweenRecords;
+  enterOperation();
+  {
+    std::lock_guard<concurrency::SpinLock> lock(m_ioLock);
+    betweenRecords = isBetweenRecords();
+  }
+  leaveOperation();
+
+  if(!betweenRecords) {
+    return 0;
+  }
+
+  /*
+   * Reader blocks in the transport outside of Mbed TLS - while it waits, the monitor may release record buffers
+   * of the idle connection, or send close_notify and close the transport.
+   */
+  auto res = m_stream.object->read(header, RECORD_HEADER_SIZE, action);
+
+  if(res == oatpp::IOError::RETRY_READ || res == oatpp::IOError::RETRY_WRITE) {
+    return oatpp::IOError::RETRY_READ;
+  }
+
+  if(res <= 0 || m_timedOut) {
+    return oatpp::IOError::BROKEN_PIPE;
+  }
+
+  m_lastActivity = oatpp::base::Environment::getMicroTickCount();
+
+  return res;
+
+}
+
+bool Connection::checkDeadlines(v_int64 tick) {
+
+  if(isExpired(m_handshakeDeadline, tick) || isExpired(m_readDeadline, tick) || isExpired(m_writeDeadline, tick)) {
+    if(!m_timedOut.exchange(true)) {
+      /* Closing the transport wakes up both blocked threads and waiting coroutines */
+      m_stream.invalidator->invalidate(m_stream.object);
+    }
+  }
+
+  if(m_config->getIdleTimeout() > 0 || m_config->getIdleBufferRelease() > 0) {
+    return checkIdle(tick);
+  }
+
+  return false;
+
+}
+
+bool Connection::probe() {
+
+  if(m_handshakeResult != 0) {
+    return false;
+  }
+
+  /* Idle connection must not have unread application data */
+  if(mbedtls_ssl_get_bytes_avail(m_tlsHandle) > 0) {
+    return false;
+  }
+
+  /*
+   * Non-blocking read: nothing to read means connection is alive.
+   * Data, close_notify, EOF or transport error means it's not.
+   * read() arms the read deadline and keeps it armed on RETRY_READ - restore it.
+   */
+
+  auto ioMode = getInputStreamIOMode();
+  setInputStreamIOMode(data::stream::IOMode::ASYNCHRONOUS);
+
+  v_int64 readDeadline = m_readDeadline;
+
+  v_uint8 byte;
+  async::Action action;
+  auto res = read(&byte, 1, action);
+
+  m_readDeadline = readDeadline;
+
+  setInputStreamIOMode(ioMode);
+
+  return res == oatpp::IOError::RETRY_READ;
+
+}
+
 provider::ResourceHandle<data::stream::IOStream> Connection::getTransportStream() {
   return m_stream;
 }
@@ -25,6 +25,8 @@
 #ifndef oatpp_mbedtls_Connection_hpp
 #define oatpp_mbedtls_Connection_hpp
 
+#include "oatpp-mbedtls/Config.hpp"
+
 #include "oatpp/core/provider/Provider.hpp"
 #include "oatpp/core/data/stream/Stream.hpp"
 
@@ -37,6 +39,13 @@ namespace oatpp { namespace mbedtls {
  * TLS Connection implementation based on Mbed TLS. Extends &id:oatpp::base::Countable; and &id:oatpp::data::stream::IOStream;.
  */
 class Connection : public oatpp::base::Countable, public oatpp::data::stream::IOStream {
+public:
+
+  /**
+   * Value of &l:Connection::getHandshakeResult (); while handshake is not finished.
+   */
+  static constexpr int HANDSHAKE_PENDING = 1;
+
 private:
 
   class IOLockGuard {
@@ -56,8 +65,6 @@ private:
 private:
 
   class ConnectionContext : public oatpp::data::stream::Context {
-  private:
-    static std::mutex HANDSHAKE_MUTEX;
   private:
     Connection* m_connection;
     data::stream::StreamType m_streamType;
@@ -73,12 +80,15 @@ private:
 
     data::stream::StreamType getStreamType() const override;
 
+    void putProperty(const oatpp::String& key, const oatpp::String& value);
+
   };
 
 private:
   mbedtls_ssl_context* m_tlsHandle;
   provider::ResourceHandle<data::stream::IOStream> m_stream;
   std::atomic<bool> m_initialized;
+  std::atomic<int> m_handshakeResult;
 private:
   async::Action* m_ioAction;
   concurrency::SpinLock m_ioLock;
@@ -92,6 +102,92 @@ private:
   static void setTLSStreamBIOCallbacks(mbedtls_ssl_context* tlsHandle, Connection* connection);
   static int writeCallback(void *ctx, const unsigned char *buf, size_t len);
   static int readCallback(void *ctx, unsigned char *buf, size_t len);
+private:
+  std::shared_ptr<Config> m_config;
+  std::atomic<v_int64> m_handshakeDeadline;
+  std::atomic<v_int64> m_readDeadline;
+  std::atomic<v_int64> m_writeDeadline;
+  std::atomic<bool> m_timedOut;
+  bool m_monitored;
+  void onHandshakeSuccess();
+private:
+  enum EarlyDataState : v_int32 {
+    EARLY_DATA_NONE = 0,
+    EARLY_DATA_WRITE = 1,    // client: write data with the ClientHello
+    EARLY_DATA_HANDSHAKE = 2, // client: finish handshake, then check what the server accepted
+    EARLY_DATA_RESEND = 3,   // client: write data the server didn't accept as early data
+    EARLY_DATA_RECEIVED = 4  // server: early data is buffered for read()
+  };
+  std::string m_earlyData;
+  v_buff_size m_earlyDataPosition;
+  EarlyDataState m_earlyDataState;
+  const char* m_earlyDataStatus;
+  int handshakeStep();
+  void receiveEarlyData();
+  void trimPeerCertificate();
+private:
+  static constexpr v_buff_size CLIENT_HELLO_MAX_SIZE = 32 * 1024;
+  std::string m_clientHello;
+  bool m_captureClientHello;
+  mbedtls_x509_crt* m_selectedCertificate;
+  static void armDeadline(std::atomic<v_int64>& deadline, v_int64 timeoutMilliseconds);
+  static bool isExpired(const std::atomic<v_int64>& deadline, v_int64 tick);
+private:
+  static constexpr v_int32 OPERATIONS_EXCLUSIVE = -1;
+  static constexpr size_t IDLE_BUFFER_SIZE = 1024;
+  /* Number of operations inside Mbed TLS, or OPERATIONS_EXCLUSIVE while the monitor works on the idle context */
+  std::atomic<v_int32> m_operations;
+  std::atomic<v_int64> m_lastActivity;
+  std::atomic<bool> m_buffersReleased;
+  size_t m_inBufferLength;
+  size_t m_outBufferLength;
+  void enterOperation();
+  void leaveOperation();
+  bool tryEnterExclusive();
+  void leaveExclusive();
+  bool releaseRecordBuffers();
+  void restoreRecordBuffers();
+  void sendCloseNotify();
+  bool checkIdle(v_int64 tick);
+  bool isBetweenRecords() const;
+private:
+  static constexpr v_buff_size RECORD_HEADER_SIZE = 5;
+  /* Blocking reader waits for the next record outside of Mbed TLS, so the monitor can work on the idle context */
+  bool m_waitOutsideTLS;
+  /* First bytes of the next record - read while the reader waited outside of Mbed TLS */
+  unsigned char m_recordHeader[RECORD_HEADER_SIZE];
+  v_buff_size m_recordHeaderPosition;
+  v_buff_size m_recordHeaderLength;
+  v_io_size waitForRecord(unsigned char* header, async::Action& action);
+private:
+  v_buff_size m_writeCoalescing;
+  std::mutex m_writeLock;
+  std::string m_writeBuffer;
+  v_buff_size m_writeBufferPosition;
+  /* Mbed TLS expects the same data to be passed again after WANT_WRITE */
+  v_buff_size m_pendingWriteSize;
+  std::atomic<v_buff_size> m_gatheredSize;
+  v_io_size writeRecords(const void *data, v_buff_size count, async::Action& action);
+  v_io_size writeCoalesced(const void *data, v_buff_size count, async::Action& action);
+  v_io_size flushWriteBuffer(async::Action& action);
+private:
+  v_buff_size m_writeBatchSize;
+  std::mutex m_writeBatchLock;
+  std::string m_writeBatch;
+  v_buff_size m_writeBatchPosition;
+  /* Plaintext encrypted into the batch by a call which returned RETRY_WRITE */
+  v_buff_size m_writeBatchAccepted;
+  bool m_gathering;
+  v_io_size writeBatched(const void *data, v_buff_size count, async::Action& action);
+  v_io_size stageRecord(const unsigned char* buf, size_t len, async::Action* ioAction);
+  v_io_size drainWriteBatch(async::Action& action);
+private:
+  v_buff_size m_readAheadSize;
+  std::string m_readAhead;
+  v_buff_size m_readAheadPosition;
+  v_buff_size m_readAheadLength;
+  v_io_size fillReadAhead(async::Action& action);
+  v_io_size serveReadAhead(unsigned char* buf, size_t len);
 public:
 
   /**
@@ -99,8 +195,14 @@ public:
    * @param tlsHandle - `mbedtls_ssl_context*`.
    * @param stream - underlying transport stream. &id:oatpp::data::stream::IOStream;.
    * @param initialized - is stream initialized (do we have handshake already).
+   * @param config - &id:oatpp::mbedtls::Config; the connection was created with. Optional.
+   * If set, handshake and I/O timeouts of the config are applied to the connection,
+   * and `tlsHandle` is destroyed with &l:Config::destroyTLSContext ();.
    */
-  Connection(mbedtls_ssl_context* tlsHandle, const provider::ResourceHandle<data::stream::IOStream>& stream, bool initialized);
+  Connection(mbedtls_ssl_context* tlsHandle,
+             const provider::ResourceHandle<data::stream::IOStream>& stream,
+             bool initialized,
+             const std::shared_ptr<Config>& config = nullptr);
 
   /**
    * Virtual destructor.
@@ -168,6 +270,45 @@ public:
    */
   void closeTLS();
 
+  /**
+   * Gather small writes and write them as records of up to `size` bytes of plaintext.
+   * Gathered data is written once it reaches `size`, on &l:Connection::flush ();, and before the connection reads.<br>
+   * **Call &l:Connection::flush (); or &l:Connection::flushAsync (); before the connection is released** - connection
+   * providers don't write on invalidation, data still gathered then is dropped and logged.<br>
+   * Defaults to &id:oatpp::mbedtls::Config::setWriteCoalescing;. Set `0` to opt out - for latency-sensitive streams,
+   * and for streams written and read concurrently from different threads unless they flush explicitly.<br>
+   * *Must be called before the first write.*
+   * @param size - max size of gathered data in bytes. `0` - write each call right away.
+   */
+  void setWriteCoalescing(v_buff_size size);
+
+  /**
+   * Get write coalescing size.
+   * @return - max size of gathered data in bytes. `0` - writes are not gathered.
+   */
+  v_buff_size getWriteCoalescing() const;
+
+  /**
+   * Write gathered data.
+   * @param action - async specific action. If action is NOT &id:oatpp::async::Action::TYPE_NONE;, then
+   * caller MUST return this action on coroutine iteration.
+   * @return - `0` if all gathered data is written, `oatpp::IOError::RETRY_WRITE` if flush should be repeated,
+   * `oatpp::IOError::BROKEN_PIPE` on error.
+   */
+  v_io_size flush(async::Action& action);
+
+  /**
+   * Get size of gathered data which is not written yet.
+   * @return - size in bytes.
+   */
+  v_buff_size getGatheredSize() const;
+
+  /**
+   * Write gathered data in coroutine.
+   * @return - &id:oatpp::async::CoroutineStarter;.
+   */
+  async::CoroutineStarter flushAsync();
+
   /**
    * Get TLS handle.
    * @return - `mbedtls_ssl_context*`.
@@ -176,6 +317,97 @@ public:
     return m_tlsHandle;
   }
 
+  /**
+   * Set data to be delivered to the server as the first bytes of the connection.
+   * If the resumed session allows TLS 1.3 early data, the data is sent with the ClientHello (0-RTT).
+   * If the server doesn't accept early data, the data is written right after the handshake.
+   * Either way the data is delivered once the handshake succeeds.
+   * Outcome is exposed by the `tls_early_data` context property - `accepted`, `rejected` or `not_sent`.<br>
+   * *Client connections only. Must be called before the handshake.*
+   * @param data - first bytes to send. Only idempotent requests should be sent as early data - it can be replayed.
+   */
+  void setEarlyData(const oatpp::String& data);
+
+  /**
+   * Get ClientHello records as they were received from the client.<br>
+   * Server connections capture them only if the config's &id:oatpp::mbedtls::server::CertificateStore; has
+   * certificates of several key types for a name, and only until the certificate is selected.
+   * Records are dropped when the server replies - after a HelloRetryRequest the second ClientHello is captured.
+   * @return - raw TLS records. Empty if not captured.
+   */
+  const std::string& getClientHello() const;
+
+  /**
+   * Called by &id:oatpp::mbedtls::server::CertificateStore; once the certificate for the handshake is selected.
+   * Stops ClientHello capture.
+   * @param certificate - selected certificate. `nullptr` if several certificates were offered to Mbed TLS.
+   */
+  void onCertificateSelected(mbedtls_x509_crt* certificate);
+
+  /**
+   * Get certificate selected for the handshake by &id:oatpp::mbedtls::server::CertificateStore;.
+   * @return - `mbedtls_x509_crt*`. `nullptr` if not selected by the store, or if several certificates were offered to Mbed TLS.
+   */
+  mbedtls_x509_crt* getSelectedCertificate() const;
+
+  /**
+   * Get result of the TLS handshake.
+   * @return - `0` if handshake succeeded, Mbed TLS error code if it failed,
+   * &l:Connection::HANDSHAKE_PENDING; if handshake is not finished yet.
+   */
+  int getHandshakeResult() const;
+
+  /**
+   * Copy the negotiated session. Synchronized with I/O running on this connection.
+   * @param session - initialized `mbedtls_ssl_session` to copy session to.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int getSession(mbedtls_ssl_session* session);
+
+  /**
+   * Get approximate memory held by this connection: TLS context with its record buffers and peer certificate,
+   * plus buffers of the connection itself. Not synchronized with I/O - use for monitoring.
+   * @return - size in bytes.
+   */
+  v_buff_size getMemoryUsage() const;
+
+  /**
+   * Check if record buffers are released because the connection is idle.
+   * See &id:oatpp::mbedtls::Config::setIdleBufferRelease;.
+   * @return - `true` if record buffers are released.
+   */
+  bool areRecordBuffersReleased() const;
+
+  /**
+   * Check if the connection was closed because one of its deadlines expired or it was idle too long.
+   * @return - `true` if connection timed out.
+   */
+  bool isTimedOut() const;
+
+  /**
+   * Close the connection if any of its deadlines has expired, release record buffers of idle connection.
+   * Called by &id:oatpp::mbedtls::ConnectionMonitor;.<br>
+   * Connection idle too long is only claimed here - it's closed with close_notify by &l:Connection::reap ();,
+   * which the caller runs outside of its locks since it writes to the transport.
+   * @param tick - current tick in microseconds. See `oatpp::base::Environment::getMicroTickCount()`.
+   * @return - `true` if connection is claimed for reaping - caller must call &l:Connection::reap ();.
+   */
+  bool checkDeadlines(v_int64 tick);
+
+  /**
+   * Send close_notify and close the transport of connection claimed by &l:Connection::checkDeadlines ();.
+   * Doesn't block on the transport.
+   */
+  void reap();
+
+  /**
+   * Check without blocking if idle connection is still usable: handshake succeeded, there is no unread application data
+   * and peer sent nothing since the last read - no data, close_notify or EOF.<br>
+   * Read deadline is left as it was before the probe, so the probed connection is not timed out while it waits to be used.
+   * @return - `true` if connection is alive.
+   */
+  bool probe();
+
   /**
    * Get the underlying transport stream.
    * @return - underlying transport stream. &id:oatpp::data::stream::IOStream;.
@@ -0,0 +1,162 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ConnectionMonitor.hpp"
+
+#include "Connection.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace oatpp { namespace mbedtls {
+
+constexpr v_int32 ConnectionMonitor::SHARDS_COUNT;
+
+ConnectionMonitor::ConnectionMonitor(v_int64 resolutionMicroseconds)
+  : m_resolutionMicroseconds(resolutionMicroseconds)
+  , m_connectionsCount(0)
+  , m_stopped(false)
+{}
+
+ConnectionMonitor::~ConnectionMonitor() {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stopped = true;
+  }
+  m_condition.notify_all();
+  if(m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+ConnectionMonitor& ConnectionMonitor::getInstance() {
+  static ConnectionMonitor monitor(100 * 1000);
+  return monitor;
+}
+
+ConnectionMonitor::Shard& ConnectionMonitor::getShard(Connection* connection) {
+  /*
+   * std::hash of a pointer is usually the pointer itself, and heap allocations are aligned -
+   * low bits are the same for all connections. Drop alignment bits and take the high bits of a multiplicative hash.
+   */
+  auto key = (v_uint64) reinterpret_cast<std::uintptr_t>(connection) >> 4;
+  auto hash = key * 0x9E3779B97F4A7C15ULL;
+  return m_shards[(hash >> 32) % SHARDS_COUNT];
+}
+
+void ConnectionMonitor::add(Connection* connection) {
+
+  {
+    auto& shard = getShard(connection);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.connections.insert(connection);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    ++ m_connectionsCount;
+    if(!m_thread.joinable() && !m_stopped) {
+      m_thread = std::thread(&ConnectionMonitor::run, this);
+    }
+  }
+
+  m_condition.notify_one();
+
+}
+
+void ConnectionMonitor::remove(Connection* connection) {
+
+  {
+    auto& shard = getShard(connection);
+    std::unique_lock<std::mutex> lock(shard.lock);
+    shard.connections.erase(connection);
+    shard.reaped.wait(lock, [&shard, connection] { return shard.reaping.find(connection) == shard.reaping.end(); });
+  }
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  -- m_connectionsCount;
+
+}
+
+void ConnectionMonitor::run() {
+
+  std::vector<Connection*> reaping;
+
+  while(true) {
+
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_condition.wait(lock, [this] { return m_stopped || m_connectionsCount > 0; });
+      if(m_stopped) {
+        return;
+      }
+      m_condition.wait_for(lock, std::chrono::microseconds(m_resolutionMicroseconds), [this] { return m_stopped; });
+      if(m_stopped) {
+        return;
+      }
+    }
+
+    auto tick = oatpp::base::Environment::getMicroTickCount();
+
+    for(v_int32 i = 0; i < SHARDS_COUNT; i ++) {
+
+      auto& shard = m_shards[i];
+
+      {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for(auto connection : shard.connections) {
+          if(connection->checkDeadlines(tick)) {
+            reaping.push_back(connection);
+          }
+        }
+        shard.reaping.insert(reaping.begin(), reaping.end());
+      }
+
+      if(reaping.empty()) {
+        continue;
+      }
+
+      /* close_notify goes to the transport - add() and remove() of other connections don't wait for it */
+      for(auto connection : reaping) {
+        connection->reap();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for(auto connection : reaping) {
+          shard.reaping.erase(connection);
+        }
+      }
+      shard.reaped.notify_all();
+
+      reaping.clear();
+
+    }
+
+  }
+
+}
+
+}}
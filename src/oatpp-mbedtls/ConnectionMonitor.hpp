@@ -0,0 +1,107 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_ConnectionMonitor_hpp
+#define oatpp_mbedtls_ConnectionMonitor_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace oatpp { namespace mbedtls {
+
+class Connection;
+
+/**
+ * Process-wide monitor of connection deadlines.<br>
+ * One background thread periodically scans registered connections and lets each of them check its deadlines.
+ * Both blocking and asynchronous connections are served by the same thread - no timer per connection is needed.
+ * Registry is sharded so that connections created and destroyed concurrently don't contend on one lock.
+ * Idle connections are reaped with close_notify after the shard lock is released.
+ */
+class ConnectionMonitor {
+private:
+  static constexpr v_int32 SHARDS_COUNT = 16;
+private:
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_set<Connection*> connections;
+    /* Connections being reaped outside of the lock - remove() waits for them */
+    std::unordered_set<Connection*> reaping;
+    std::condition_variable reaped;
+  };
+
+private:
+  void run();
+  Shard& getShard(Connection* connection);
+private:
+  v_int64 m_resolutionMicroseconds;
+  Shard m_shards[SHARDS_COUNT];
+private:
+  std::mutex m_lock;
+  std::condition_variable m_condition;
+  v_int64 m_connectionsCount;
+  bool m_stopped;
+  std::thread m_thread;
+public:
+
+  /**
+   * Constructor.
+   * @param resolutionMicroseconds - how often deadlines are checked.
+   */
+  ConnectionMonitor(v_int64 resolutionMicroseconds);
+
+  /**
+   * Non-virtual destructor. Stops monitor thread.
+   */
+  ~ConnectionMonitor();
+
+  /**
+   * Get process-wide monitor. Deadlines are checked every 100 milliseconds.
+   * @return - &l:ConnectionMonitor;.
+   */
+  static ConnectionMonitor& getInstance();
+
+  /**
+   * Register connection. Monitor thread is started on the first registration.
+   * @param connection - &id:oatpp::mbedtls::Connection;.
+   */
+  void add(Connection* connection);
+
+  /**
+   * Unregister connection. Once this method returns monitor doesn't access the connection anymore.
+   * If monitor is reaping the connection, waits until it's done.
+   * @param connection - &id:oatpp::mbedtls::Connection;.
+   */
+  void remove(Connection* connection);
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_ConnectionMonitor_hpp
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ContextPool.hpp"
+
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+namespace oatpp { namespace mbedtls {
+
+ContextPool::ContextPool(mbedtls_ssl_config* config, v_int32 maxSize)
+  : m_config(config)
+  , m_hits(0)
+  , m_misses(0)
+  , m_discards(0)
+{
+
+  if(maxSize < 1) {
+    throw std::runtime_error("[oatpp::mbedtls::ContextPool::ContextPool()]: Error. Invalid pool size.");
+  }
+
+  v_int32 shardsCount = (v_int32) std::thread::hardware_concurrency();
+  if(shardsCount < 1) {
+    shardsCount = 1;
+  }
+  if(shardsCount > maxSize) {
+    shardsCount = maxSize;
+  }
+
+  m_shardCapacity = (maxSize + shardsCount - 1) / shardsCount;
+
+  for(v_int32 i = 0; i < shardsCount; i ++) {
+    m_shards.push_back(new Shard());
+  }
+
+}
+
+ContextPool::~ContextPool() {
+  for(auto shard : m_shards) {
+    for(auto context : shard->contexts) {
+      destroy(context);
+    }
+    delete shard;
+  }
+}
+
+void ContextPool::destroy(mbedtls_ssl_context* context) {
+  mbedtls_ssl_free(context);
+  delete context;
+}
+
+size_t ContextPool::homeShard() const {
+  return std::hash<std::thread::id>()(std::this_thread::get_id()) % m_shards.size();
+}
+
+mbedtls_ssl_context* ContextPool::acquire() {
+
+  const size_t size = m_shards.size();
+  const size_t home = homeShard();
+
+  /* Own shard first, then whatever other shard isn't busy */
+  for(size_t i = 0; i < size; i ++) {
+
+    auto shard = m_shards[(home + i) % size];
+
+    std::unique_lock<std::mutex> lock(shard->lock, std::defer_lock);
+    if(i == 0) {
+      lock.lock();
+    } else if(!lock.try_lock()) {
+      continue;
+    }
+
+    if(!shard->contexts.empty()) {
+      auto context = shard->contexts.back();
+      shard->contexts.pop_back();
+      ++ m_hits;
+      return context;
+    }
+
+  }
+
+  ++ m_misses;
+
+  auto context = new mbedtls_ssl_context();
+  mbedtls_ssl_init(context);
+
+  auto res = mbedtls_ssl_setup(context, m_config);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::ContextPool::acquire()]", "Error. Call to mbedtls_ssl_setup() failed. Return value=%d", res);
+    destroy(context);
+    return nullptr;
+  }
+
+  return context;
+
+}
+
+void ContextPool::release(mbedtls_ssl_context* context) {
+
+  if(mbedtls_ssl_context_get_config(context) != m_config || mbedtls_ssl_session_reset(context) != 0) {
+    ++ m_discards;
+    destroy(context);
+    return;
+  }
+
+  auto shard = m_shards[homeShard()];
+
+  {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    if((v_int32) shard->contexts.size() < m_shardCapacity) {
+      shard->contexts.push_back(context);
+      return;
+    }
+  }
+
+  ++ m_discards;
+  destroy(context);
+
+}
+
+ContextPool::Statistics ContextPool::getStatistics() const {
+  Statistics stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.discards = m_discards;
+  return stats;
+}
+
+}}
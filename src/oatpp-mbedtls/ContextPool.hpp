@@ -0,0 +1,124 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_ContextPool_hpp
+#define oatpp_mbedtls_ContextPool_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Pool of TLS contexts set up with one `mbedtls_ssl_config`.<br>
+ * Released context is reset with `mbedtls_ssl_session_reset()` and reused by the next connection -
+ * its record buffers and handshake state stay allocated, so a connection costs no `mbedtls_ssl_setup()`.
+ * Free contexts are kept in shards picked by thread id, so threads accepting connections don't contend on one list.
+ */
+class ContextPool {
+public:
+
+  /**
+   * Pool statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Contexts taken from the pool.
+     */
+    v_int64 hits;
+
+    /**
+     * Contexts created because the pool was empty.
+     */
+    v_int64 misses;
+
+    /**
+     * Released contexts freed because the pool was full or reset failed.
+     */
+    v_int64 discards;
+
+  };
+
+private:
+
+  struct Shard {
+    std::mutex lock;
+    std::vector<mbedtls_ssl_context*> contexts;
+  };
+
+private:
+  static void destroy(mbedtls_ssl_context* context);
+private:
+  mbedtls_ssl_config* m_config;
+  std::vector<Shard*> m_shards;
+  v_int32 m_shardCapacity;
+  size_t homeShard() const;
+private:
+  std::atomic<v_int64> m_hits;
+  std::atomic<v_int64> m_misses;
+  std::atomic<v_int64> m_discards;
+public:
+
+  /**
+   * Constructor.
+   * @param config - `mbedtls_ssl_config*` to set up contexts with. Must outlive the pool.
+   * @param maxSize - max number of free contexts kept in the pool.
+   */
+  ContextPool(mbedtls_ssl_config* config, v_int32 maxSize);
+
+  /**
+   * Non-virtual destructor. Frees contexts kept in the pool.
+   */
+  ~ContextPool();
+
+  /**
+   * Take a context from the pool or create a new one.
+   * @return - `mbedtls_ssl_context*` ready for handshake, or `nullptr` if `mbedtls_ssl_setup()` failed.
+   */
+  mbedtls_ssl_context* acquire();
+
+  /**
+   * Return context to the pool. Context is reset, or freed if the pool is full.
+   * Context set up with another config is freed.
+   * @param context - `mbedtls_ssl_context*` allocated with `new`.
+   */
+  void release(mbedtls_ssl_context* context);
+
+  /**
+   * Get pool statistics.
+   * @return - &l:ContextPool::Statistics;.
+   */
+  Statistics getStatistics() const;
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_ContextPool_hpp
@@ -0,0 +1,245 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "CryptoWorkerPool.hpp"
+
+#include <cstring>
+
+namespace oatpp { namespace mbedtls {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PrivateKeyOperation
+
+PrivateKeyOperation::PrivateKeyOperation(Type type, PrivateKey* key, PrivateKey::RandomFunction random, void* randomContext,
+                                         mbedtls_md_type_t mdAlg, const unsigned char* input, size_t inputSize)
+  : m_type(type)
+  , m_key(key)
+  , m_random(random)
+  , m_randomContext(randomContext)
+  , m_mdAlg(mdAlg)
+  , m_input(input, input + inputSize)
+  , m_result(MBEDTLS_ERR_SSL_INTERNAL_ERROR)
+  , m_state(QUEUED)
+  , m_done(false)
+{
+  m_waitList.setListener(this);
+}
+
+PrivateKeyOperation::~PrivateKeyOperation() {
+  m_waitList.setListener(nullptr);
+}
+
+void PrivateKeyOperation::onNewItem(oatpp::async::CoroutineWaitList& list) {
+  /* Operation may complete before the coroutine is added to the list - don't lose the wakeup */
+  if(m_done) {
+    list.notifyAll();
+  }
+}
+
+void PrivateKeyOperation::run() {
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(m_state != QUEUED) {
+      return;
+    }
+    m_state = RUNNING;
+  }
+
+  size_t outputLength = 0;
+  int result;
+
+  if(m_type == SIGN) {
+    m_output.resize(MBEDTLS_PK_SIGNATURE_MAX_SIZE);
+    result = mbedtls_pk_sign(m_key->getHandshakeKey(), m_mdAlg, m_input.data(), m_input.size(),
+                             m_output.data(), m_output.size(), &outputLength, m_random, m_randomContext);
+  } else {
+    m_output.resize(MBEDTLS_MPI_MAX_SIZE);
+    result = mbedtls_pk_decrypt(m_key->getHandshakeKey(), m_input.data(), m_input.size(),
+                                m_output.data(), &outputLength, m_output.size(), m_random, m_randomContext);
+  }
+
+  m_output.resize(result == 0 ? outputLength : 0);
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_result = result;
+    m_state = DONE;
+    m_done = true;
+  }
+
+  m_condition.notify_all();
+  m_waitList.notifyAll();
+
+}
+
+void PrivateKeyOperation::cancel() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  if(m_state == QUEUED) {
+    m_state = CANCELLED;
+    return;
+  }
+  while(m_state == RUNNING) {
+    m_condition.wait(lock);
+  }
+}
+
+bool PrivateKeyOperation::isDone() const {
+  return m_done;
+}
+
+void PrivateKeyOperation::wait() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  while(!m_done) {
+    m_condition.wait(lock);
+  }
+}
+
+oatpp::async::CoroutineWaitList& PrivateKeyOperation::getWaitList() {
+  return m_waitList;
+}
+
+int PrivateKeyOperation::getResult(unsigned char* output, size_t* outputLength, size_t outputSize) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if(m_result != 0) {
+    return m_result;
+  }
+  if(m_output.size() > outputSize) {
+    return MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL;
+  }
+  std::memcpy(output, m_output.data(), m_output.size());
+  *outputLength = m_output.size();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CryptoWorkerPool
+
+CryptoWorkerPool::CryptoWorkerPool(v_int32 threadsCount)
+  : m_running(true)
+  , m_operationsCompleted(0)
+  , m_operationTicksTotal(0)
+  , m_queueTicksTotal(0)
+{
+  if(threadsCount < 1) {
+    throw std::runtime_error("[oatpp::mbedtls::CryptoWorkerPool::CryptoWorkerPool()]: Error. Invalid threadsCount.");
+  }
+  for(v_int32 i = 0; i < threadsCount; i ++) {
+    m_workers.push_back(std::thread(&CryptoWorkerPool::run, this));
+  }
+}
+
+CryptoWorkerPool::~CryptoWorkerPool() {
+
+  std::list<Task> tasks;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_running = false;
+    tasks.swap(m_tasks);
+  }
+
+  m_condition.notify_all();
+
+  for(auto& worker : m_workers) {
+    worker.join();
+  }
+
+  /* Nobody will execute queued operations - complete them so that waiters don't hang */
+  for(auto& task : tasks) {
+    task.operation->run();
+  }
+
+}
+
+std::shared_ptr<CryptoWorkerPool> CryptoWorkerPool::createShared(v_int32 threadsCount) {
+  if(threadsCount < 1) {
+    threadsCount = (v_int32) std::thread::hardware_concurrency();
+    if(threadsCount < 1) {
+      threadsCount = 1;
+    }
+  }
+  return std::make_shared<CryptoWorkerPool>(threadsCount);
+}
+
+void CryptoWorkerPool::run() {
+
+  while(true) {
+
+    Task task;
+
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while(m_running && m_tasks.empty()) {
+        m_condition.wait(lock);
+      }
+      if(!m_running) {
+        return;
+      }
+      task = m_tasks.front();
+      m_tasks.pop_front();
+    }
+
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+    m_queueTicksTotal += startTick - task.queuedTick;
+
+    task.operation->run();
+
+    m_operationTicksTotal += oatpp::base::Environment::getMicroTickCount() - startTick;
+    ++ m_operationsCompleted;
+
+  }
+
+}
+
+void CryptoWorkerPool::submit(const std::shared_ptr<PrivateKeyOperation>& operation) {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_tasks.push_back({operation, oatpp::base::Environment::getMicroTickCount()});
+  }
+  m_condition.notify_one();
+}
+
+CryptoWorkerPool::Statistics CryptoWorkerPool::getStatistics() {
+
+  Statistics stats;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    stats.queueDepth = (v_int64) m_tasks.size();
+  }
+
+  stats.operationsCompleted = m_operationsCompleted;
+  stats.averageOperationMicroseconds = 0;
+  stats.averageQueueMicroseconds = 0;
+  if(stats.operationsCompleted > 0) {
+    stats.averageOperationMicroseconds = m_operationTicksTotal / stats.operationsCompleted;
+    stats.averageQueueMicroseconds = m_queueTicksTotal / stats.operationsCompleted;
+  }
+
+  return stats;
+
+}
+
+}}
@@ -0,0 +1,243 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_CryptoWorkerPool_hpp
+#define oatpp_mbedtls_CryptoWorkerPool_hpp
+
+#include "oatpp-mbedtls/PrivateKey.hpp"
+
+#include "oatpp/core/async/CoroutineWaitList.hpp"
+#include "oatpp/core/base/Environment.hpp"
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Private key operation (signature or decryption) executed by &l:CryptoWorkerPool;.<br>
+ * Handshake waits for the operation either by blocking on &l:PrivateKeyOperation::wait (); or,
+ * in asynchronous mode, by waiting on &l:PrivateKeyOperation::getWaitList ();.
+ */
+class PrivateKeyOperation : private oatpp::async::CoroutineWaitList::Listener {
+public:
+
+  /**
+   * Operation type.
+   */
+  enum Type : v_int32 {
+
+    /**
+     * Sign hash.
+     */
+    SIGN = 0,
+
+    /**
+     * Decrypt (RSA key exchange).
+     */
+    DECRYPT = 1
+
+  };
+
+private:
+
+  enum State : v_int32 {
+    QUEUED = 0,
+    RUNNING = 1,
+    DONE = 2,
+    CANCELLED = 3
+  };
+
+private:
+  void onNewItem(oatpp::async::CoroutineWaitList& list) override;
+private:
+  Type m_type;
+  PrivateKey* m_key;
+  PrivateKey::RandomFunction m_random;
+  void* m_randomContext;
+  mbedtls_md_type_t m_mdAlg;
+  std::vector<unsigned char> m_input;
+  std::vector<unsigned char> m_output;
+  int m_result;
+private:
+  std::mutex m_lock;
+  std::condition_variable m_condition;
+  State m_state;
+  std::atomic<bool> m_done;
+  oatpp::async::CoroutineWaitList m_waitList;
+public:
+
+  /**
+   * Constructor.
+   * @param type - &l:PrivateKeyOperation::Type;.
+   * @param key - &id:oatpp::mbedtls::PrivateKey;.
+   * @param random - random function.
+   * @param randomContext - context of the random function.
+   * @param mdAlg - hash algorithm (for signature).
+   * @param input - hash to sign or data to decrypt.
+   * @param inputSize - size of the input.
+   */
+  PrivateKeyOperation(Type type, PrivateKey* key, PrivateKey::RandomFunction random, void* randomContext,
+                      mbedtls_md_type_t mdAlg, const unsigned char* input, size_t inputSize);
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~PrivateKeyOperation();
+
+  /**
+   * Execute operation. Called by worker thread. Does nothing if the operation was cancelled.
+   */
+  void run();
+
+  /**
+   * Cancel operation. If the operation is running, waits for it to finish,
+   * so the key is not used after this method returns.
+   */
+  void cancel();
+
+  /**
+   * Check if operation is done.
+   * @return - `true` if done.
+   */
+  bool isDone() const;
+
+  /**
+   * Block until operation is done.
+   */
+  void wait();
+
+  /**
+   * Wait list notified when the operation is done.
+   * @return - `oatpp::async::CoroutineWaitList`.
+   */
+  oatpp::async::CoroutineWaitList& getWaitList();
+
+  /**
+   * Get operation result. Call only when operation is done.
+   * @param output - output buffer.
+   * @param outputLength - out parameter - length of the result.
+   * @param outputSize - size of the output buffer.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int getResult(unsigned char* output, size_t* outputLength, size_t outputSize);
+
+};
+
+/**
+ * Pool of threads executing private key operations off the threads driving handshakes.<br>
+ * Use with &id:oatpp::mbedtls::Config::setCryptoWorkerPool;.
+ */
+class CryptoWorkerPool {
+public:
+
+  /**
+   * Pool statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Operations waiting for a worker.
+     */
+    v_int64 queueDepth;
+
+    /**
+     * Number of operations executed.
+     */
+    v_int64 operationsCompleted;
+
+    /**
+     * Average operation time in microseconds (queue time not included).
+     */
+    v_int64 averageOperationMicroseconds;
+
+    /**
+     * Average time operations spent in queue, in microseconds.
+     */
+    v_int64 averageQueueMicroseconds;
+
+  };
+
+private:
+
+  struct Task {
+    std::shared_ptr<PrivateKeyOperation> operation;
+    v_int64 queuedTick;
+  };
+
+private:
+  void run();
+private:
+  std::vector<std::thread> m_workers;
+private:
+  std::mutex m_lock;
+  std::condition_variable m_condition;
+  std::list<Task> m_tasks;
+  bool m_running;
+private:
+  std::atomic<v_int64> m_operationsCompleted;
+  std::atomic<v_int64> m_operationTicksTotal;
+  std::atomic<v_int64> m_queueTicksTotal;
+public:
+
+  /**
+   * Constructor.
+   * @param threadsCount - number of worker threads.
+   */
+  CryptoWorkerPool(v_int32 threadsCount);
+
+  /**
+   * Non-virtual destructor. Stops and joins worker threads.
+   */
+  ~CryptoWorkerPool();
+
+  /**
+   * Create shared CryptoWorkerPool.
+   * @param threadsCount - number of worker threads. `0` - one thread per hardware thread.
+   * @return - `std::shared_ptr` to CryptoWorkerPool.
+   */
+  static std::shared_ptr<CryptoWorkerPool> createShared(v_int32 threadsCount = 0);
+
+  /**
+   * Queue operation.
+   * @param operation - &l:PrivateKeyOperation;.
+   */
+  void submit(const std::shared_ptr<PrivateKeyOperation>& operation);
+
+  /**
+   * Get pool statistics.
+   * @return - &l:CryptoWorkerPool::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_CryptoWorkerPool_hpp
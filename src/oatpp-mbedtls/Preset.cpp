@@ -0,0 +1,301 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "Preset.hpp"
+
+#include "mbedtls/ssl_ciphersuites.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace oatpp { namespace mbedtls {
+
+namespace {
+
+bool detectAESAcceleration() {
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+  /* CPUID.01H:ECX.AES[bit 25] */
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) != 0;
+#else
+  unsigned int a, b, c, d;
+  if(__get_cpuid(1, &a, &b, &c, &d) == 0) {
+    return false;
+  }
+  return (c & (1u << 25)) != 0;
+#endif
+
+#elif defined(__aarch64__) && defined(__APPLE__)
+  return true; // all Apple Silicon cores have ARMv8 Crypto Extensions
+#elif defined(__aarch64__) && defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+  return false;
+#endif
+
+}
+
+bool isGroupSupported(v_uint16 group) {
+
+  switch(group) {
+
+    case MBEDTLS_SSL_IANA_TLS_GROUP_FFDHE2048:
+#if defined(PSA_WANT_ALG_FFDH) && defined(PSA_WANT_DH_RFC7919_2048)
+      return true;
+#else
+      return false;
+#endif
+
+    case MBEDTLS_SSL_IANA_TLS_GROUP_FFDHE3072:
+#if defined(PSA_WANT_ALG_FFDH) && defined(PSA_WANT_DH_RFC7919_3072)
+      return true;
+#else
+      return false;
+#endif
+
+    case MBEDTLS_SSL_IANA_TLS_GROUP_FFDHE4096:
+#if defined(PSA_WANT_ALG_FFDH) && defined(PSA_WANT_DH_RFC7919_4096)
+      return true;
+#else
+      return false;
+#endif
+
+    case MBEDTLS_SSL_IANA_TLS_GROUP_FFDHE6144:
+#if defined(PSA_WANT_ALG_FFDH) && defined(PSA_WANT_DH_RFC7919_6144)
+      return true;
+#else
+      return false;
+#endif
+
+    case MBEDTLS_SSL_IANA_TLS_GROUP_FFDHE8192:
+#if defined(PSA_WANT_ALG_FFDH) && defined(PSA_WANT_DH_RFC7919_8192)
+      return true;
+#else
+      return false;
+#endif
+
+    default:
+      break;
+
+  }
+
+#if defined(MBEDTLS_ECP_LIGHT)
+  /* Curves compiled into the ECP module */
+  return mbedtls_ecp_curve_info_from_tls_id(group) != nullptr;
+#else
+  /* Elliptic curves are PSA only - Mbed TLS checks them itself when the group list is set */
+  return true;
+#endif
+
+}
+
+bool isSignatureAlgorithmSupported(v_uint16 algorithm) {
+
+  mbedtls_md_type_t md;
+  mbedtls_pk_type_t pk;
+  v_uint16 curve = 0;
+  bool pss = false;
+
+  switch(algorithm) {
+
+    case MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256:
+      md = MBEDTLS_MD_SHA256; pk = MBEDTLS_PK_ECDSA; curve = MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1;
+      break;
+    case MBEDTLS_TLS1_3_SIG_ECDSA_SECP384R1_SHA384:
+      md = MBEDTLS_MD_SHA384; pk = MBEDTLS_PK_ECDSA; curve = MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1;
+      break;
+    case MBEDTLS_TLS1_3_SIG_ECDSA_SECP521R1_SHA512:
+      md = MBEDTLS_MD_SHA512; pk = MBEDTLS_PK_ECDSA; curve = MBEDTLS_SSL_IANA_TLS_GROUP_SECP521R1;
+      break;
+
+    case MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA256:
+      md = MBEDTLS_MD_SHA256; pk = MBEDTLS_PK_RSA;
+      break;
+    case MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA384:
+      md = MBEDTLS_MD_SHA384; pk = MBEDTLS_PK_RSA;
+      break;
+    case MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA512:
+      md = MBEDTLS_MD_SHA512; pk = MBEDTLS_PK_RSA;
+      break;
+
+    case MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA256:
+      md = MBEDTLS_MD_SHA256; pk = MBEDTLS_PK_RSA; pss = true;
+      break;
+    case MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA384:
+      md = MBEDTLS_MD_SHA384; pk = MBEDTLS_PK_RSA; pss = true;
+      break;
+    case MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA512:
+      md = MBEDTLS_MD_SHA512; pk = MBEDTLS_PK_RSA; pss = true;
+      break;
+
+    default:
+      /* EdDSA, RSA-PSS with PSS keys, SHA-1 and others are not implemented by Mbed TLS */
+      return false;
+
+  }
+
+  if(mbedtls_md_info_from_type(md) == nullptr || mbedtls_pk_info_from_type(pk) == nullptr) {
+    return false;
+  }
+
+#if !defined(MBEDTLS_PKCS1_V21)
+  if(pss) {
+    return false;
+  }
+#else
+  (void) pss;
+#endif
+
+  return curve == 0 || isGroupSupported(curve);
+
+}
+
+}
+
+Preset Preset::createDefault() {
+  return Preset();
+}
+
+Preset Preset::createFastModern() {
+
+  Preset preset;
+
+  const std::vector<int> tls13AES = {MBEDTLS_TLS1_3_AES_128_GCM_SHA256, MBEDTLS_TLS1_3_AES_256_GCM_SHA384};
+  const std::vector<int> tls13ChaCha = {MBEDTLS_TLS1_3_CHACHA20_POLY1305_SHA256};
+  const std::vector<int> tls12AES = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384
+  };
+  const std::vector<int> tls12ChaCha = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256
+  };
+
+  /* Without AES instructions ChaCha20-Poly1305 is several times faster than AES-GCM */
+  bool aesFirst = hasAESAcceleration();
+
+  const std::vector<int>* order[] = {
+    aesFirst ? &tls13AES : &tls13ChaCha,
+    aesFirst ? &tls13ChaCha : &tls13AES,
+    aesFirst ? &tls12AES : &tls12ChaCha,
+    aesFirst ? &tls12ChaCha : &tls12AES
+  };
+
+  for(auto list : order) {
+    for(auto id : *list) {
+      preset.addCipherSuite(id);
+    }
+  }
+
+  preset.addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_X25519)
+        .addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1)
+        .addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1);
+
+  /* RSA PKCS#1 v1.5 is for TLS 1.2 peers only - TLS 1.3 signs with RSA-PSS */
+  preset.addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256)
+        .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_ECDSA_SECP384R1_SHA384)
+        .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA256)
+        .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA384)
+        .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA256)
+        .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA384);
+
+  return preset;
+
+}
+
+Preset Preset::createByName(const std::string& name) {
+  if(name == "default") {
+    return createDefault();
+  }
+  if(name == "fast-modern") {
+    return createFastModern();
+  }
+  throw std::runtime_error("[oatpp::mbedtls::Preset::createByName()]: Error. Unknown preset name '" + name + "'.");
+}
+
+bool Preset::hasAESAcceleration() {
+  static const bool result = detectAESAcceleration();
+  return result;
+}
+
+Preset& Preset::addCipherSuite(int id) {
+  if(mbedtls_ssl_ciphersuite_from_id(id) != nullptr) {
+    m_cipherSuites.push_back(id);
+  }
+  return *this;
+}
+
+Preset& Preset::addCipherSuite(const char* name) {
+  auto id = mbedtls_ssl_get_ciphersuite_id(name);
+  if(id == 0) {
+    OATPP_LOGW("[oatpp::mbedtls::Preset::addCipherSuite()]", "Warning. Cipher suite '%s' is not supported. Skipped.", name);
+    return *this;
+  }
+  return addCipherSuite(id);
+}
+
+Preset& Preset::addGroup(v_uint16 group) {
+  if(isGroupSupported(group)) {
+    m_groups.push_back(group);
+  }
+  return *this;
+}
+
+Preset& Preset::addSignatureAlgorithm(v_uint16 algorithm) {
+  if(isSignatureAlgorithmSupported(algorithm)) {
+    m_signatureAlgorithms.push_back(algorithm);
+  }
+  return *this;
+}
+
+const std::vector<int>& Preset::getCipherSuites() const {
+  return m_cipherSuites;
+}
+
+const std::vector<v_uint16>& Preset::getGroups() const {
+  return m_groups;
+}
+
+const std::vector<v_uint16>& Preset::getSignatureAlgorithms() const {
+  return m_signatureAlgorithms;
+}
+
+}}
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_Preset_hpp
+#define oatpp_mbedtls_Preset_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+
+#include <vector>
+#include <string>
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Cipher suites, key exchange groups and signature algorithms offered by &id:oatpp::mbedtls::Config;, in order of preference.<br>
+ * Use a named preset or build explicit lists. Empty list keeps the Mbed TLS default for that setting.
+ * Entries not supported by the Mbed TLS build are skipped.
+ * Apply with &id:oatpp::mbedtls::Config::setPreset;.
+ */
+class Preset {
+private:
+  std::vector<int> m_cipherSuites;
+  std::vector<v_uint16> m_groups;
+  std::vector<v_uint16> m_signatureAlgorithms;
+public:
+
+  /**
+   * Mbed TLS defaults (`MBEDTLS_SSL_PRESET_DEFAULT`).
+   * @return - &l:Preset;.
+   */
+  static Preset createDefault();
+
+  /**
+   * Modern clients, least CPU per handshake and per record: X25519 first, ECDSA signatures first,
+   * AEAD suites only (TLS 1.3 and ECDHE suites of TLS 1.2). AES-GCM goes first on CPUs with AES instructions,
+   * ChaCha20-Poly1305 goes first elsewhere - see &l:Preset::hasAESAcceleration ();.
+   * @return - &l:Preset;.
+   */
+  static Preset createFastModern();
+
+  /**
+   * Get preset by name.
+   * @param name - `default` or `fast-modern`.
+   * @return - &l:Preset;.
+   */
+  static Preset createByName(const std::string& name);
+
+  /**
+   * Check if CPU has AES instructions (AES-NI on x86, ARMv8 Crypto Extensions on Arm). Detected once at runtime.<br>
+   * *Mbed TLS uses them only if built with `MBEDTLS_AESNI_C` / `MBEDTLS_AESCE_C`.*
+   * @return - `true` if AES is hardware-accelerated.
+   */
+  static bool hasAESAcceleration();
+
+  /**
+   * Append cipher suite.
+   * @param id - IANA cipher suite id. Ex.: `MBEDTLS_TLS1_3_AES_128_GCM_SHA256`.
+   * @return - this preset.
+   */
+  Preset& addCipherSuite(int id);
+
+  /**
+   * Append cipher suite by name.
+   * @param name - Mbed TLS cipher suite name. Ex.: `TLS1-3-AES-128-GCM-SHA256`.
+   * @return - this preset.
+   */
+  Preset& addCipherSuite(const char* name);
+
+  /**
+   * Append key exchange group. Skipped if the curve or the finite field group is not built into Mbed TLS.
+   * @param group - IANA group id. Ex.: `MBEDTLS_SSL_IANA_TLS_GROUP_X25519`.
+   * @return - this preset.
+   */
+  Preset& addGroup(v_uint16 group);
+
+  /**
+   * Append signature algorithm. Skipped if Mbed TLS doesn't implement it, or is built without its hash, key type or curve.
+   * @param algorithm - IANA signature scheme. Ex.: `MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256`.
+   * @return - this preset.
+   */
+  Preset& addSignatureAlgorithm(v_uint16 algorithm);
+
+  /**
+   * Get cipher suites.
+   * @return - cipher suite ids.
+   */
+  const std::vector<int>& getCipherSuites() const;
+
+  /**
+   * Get key exchange groups.
+   * @return - group ids.
+   */
+  const std::vector<v_uint16>& getGroups() const;
+
+  /**
+   * Get signature algorithms.
+   * @return - signature schemes.
+   */
+  const std::vector<v_uint16>& getSignatureAlgorithms() const;
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_Preset_hpp
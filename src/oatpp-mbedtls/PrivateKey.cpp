@@ -0,0 +1,136 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+/* Blinding values of the RSA lanes are reached in the RSA context - fields are private in Mbed TLS 3.x */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include "PrivateKey.hpp"
+
+#include <thread>
+
+namespace oatpp { namespace mbedtls {
+
+PrivateKey::PrivateKey(RandomFunction random, void* randomContext)
+  : m_nextLane(0)
+  , m_random(random)
+  , m_randomContext(randomContext)
+{
+  mbedtls_pk_init(&m_key);
+}
+
+PrivateKey::~PrivateKey() {
+  for(auto lane : m_lanes) {
+    mbedtls_pk_free(lane);
+    delete lane;
+  }
+  mbedtls_pk_free(&m_key);
+}
+
+int PrivateKey::prepare() {
+
+  if(mbedtls_pk_get_type(&m_key) == MBEDTLS_PK_ECKEY || mbedtls_pk_get_type(&m_key) == MBEDTLS_PK_ECDSA) {
+
+    /*
+     * The first signature with a key computes the precomputed multiplication table of the curve
+     * and caches it in the key context. Do it here - not in concurrent handshakes.
+     */
+
+    unsigned char hash[32] = {0};
+    unsigned char sig[MBEDTLS_PK_SIGNATURE_MAX_SIZE];
+    size_t sigLength = 0;
+    return mbedtls_pk_sign(&m_key, MBEDTLS_MD_SHA256, hash, sizeof(hash), sig, sizeof(sig), &sigLength, m_random, m_randomContext);
+
+  }
+
+  if(mbedtls_pk_get_type(&m_key) == MBEDTLS_PK_RSA) {
+
+    unsigned int lanesCount = std::thread::hardware_concurrency();
+    if(lanesCount < 2) {
+      return 0;
+    }
+
+    /* Plain RSA copies - unlike RSA_ALT keys they sign RSA-PSS, which TLS 1.3 requires */
+    for(unsigned int i = 0; i < lanesCount; i ++) {
+      auto lane = new mbedtls_pk_context();
+      mbedtls_pk_init(lane);
+      m_lanes.push_back(lane);
+      auto res = mbedtls_pk_setup(lane, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA));
+      if(res != 0) {
+        return res;
+      }
+      res = mbedtls_rsa_copy(mbedtls_pk_rsa(*lane), mbedtls_pk_rsa(m_key));
+      if(res != 0) {
+        return res;
+      }
+      /*
+       * mbedtls_rsa_copy copies the blinding values too - drop them,
+       * so the lane generates its own blinding with the first operation instead of sharing the key's sequence.
+       */
+      auto rsa = mbedtls_pk_rsa(*lane);
+      mbedtls_mpi_free(&rsa->Vi);
+      mbedtls_mpi_free(&rsa->Vf);
+    }
+
+  }
+
+  return 0;
+
+}
+
+int PrivateKey::parseFile(const char* path, const char* password) {
+  auto res = mbedtls_pk_parse_keyfile(&m_key, path, password, m_random, m_randomContext);
+  if(res != 0) {
+    return res;
+  }
+  return prepare();
+}
+
+int PrivateKey::parse(const unsigned char* key, size_t keyLength) {
+  auto res = mbedtls_pk_parse_key(&m_key, key, keyLength, nullptr, 0, m_random, m_randomContext);
+  if(res != 0) {
+    return res;
+  }
+  return prepare();
+}
+
+bool PrivateKey::isLoaded() const {
+  return mbedtls_pk_get_type(&m_key) != MBEDTLS_PK_NONE;
+}
+
+mbedtls_pk_context* PrivateKey::getKey() {
+  return &m_key;
+}
+
+bool PrivateKey::isReplicated() const {
+  return !m_lanes.empty();
+}
+
+mbedtls_pk_context* PrivateKey::getHandshakeKey() {
+  if(m_lanes.empty()) {
+    return &m_key;
+  }
+  return m_lanes[m_nextLane.fetch_add(1, std::memory_order_relaxed) % m_lanes.size()];
+}
+
+}}
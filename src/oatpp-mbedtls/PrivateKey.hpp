@@ -0,0 +1,123 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_PrivateKey_hpp
+#define oatpp_mbedtls_PrivateKey_hpp
+
+#include "mbedtls/pk.h"
+#include "mbedtls/rsa.h"
+
+#include <atomic>
+#include <vector>
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Private key which may be used by several handshakes at the same time.<br>
+ * Mbed TLS RSA contexts keep blinding values which are updated on every private operation under the lock of the context,
+ * so handshakes signing with a single RSA context run one at a time.
+ * To let handshakes run in parallel, RSA keys are replicated into several lanes - full `mbedtls_pk_context` copies of the key.
+ * &l:PrivateKey::getHandshakeKey (); hands out lanes in turn, and the key is selected per handshake with
+ * `mbedtls_ssl_set_hs_own_cert`, so TLS 1.2 and TLS 1.3 (RSA-PSS) handshakes both spread across lanes.<br>
+ * Handshakes which get the same lane are serialized by the lock of its RSA context (`MBEDTLS_THREADING_C` is required - the build fails without it).
+ */
+class PrivateKey {
+public:
+
+  /**
+   * Random function used by private key operations which are not given one by the caller.
+   */
+  typedef int (*RandomFunction)(void*, unsigned char*, size_t);
+
+private:
+  int prepare();
+private:
+  mbedtls_pk_context m_key;
+  std::vector<mbedtls_pk_context*> m_lanes;
+  std::atomic<size_t> m_nextLane;
+  RandomFunction m_random;
+  void* m_randomContext;
+public:
+
+  /**
+   * Constructor.
+   * @param random - random function used for RSA blinding.
+   * @param randomContext - context of the random function.
+   */
+  PrivateKey(RandomFunction random, void* randomContext);
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~PrivateKey();
+
+  /**
+   * Parse key from file.
+   * @param path - path to the key file.
+   * @param password - optional key password.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int parseFile(const char* path, const char* password);
+
+  /**
+   * Parse key from buffer.
+   * @param key - key buffer (PEM must be null-terminated and `keyLength` must include the terminator).
+   * @param keyLength - size of the key buffer.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int parse(const unsigned char* key, size_t keyLength);
+
+  /**
+   * Check if key was loaded.
+   * @return - `true` if key was parsed successfully.
+   */
+  bool isLoaded() const;
+
+  /**
+   * Get parsed key.<br>
+   * *This context is NOT safe to be used for private operations from several threads.*
+   * @return - `mbedtls_pk_context*`.
+   */
+  mbedtls_pk_context* getKey();
+
+  /**
+   * Check if the key is replicated into lanes. Replicated keys should be selected per handshake
+   * with `mbedtls_ssl_set_hs_own_cert` and &l:PrivateKey::getHandshakeKey (); for handshakes to run in parallel.
+   * @return - `true` if the key is replicated.
+   */
+  bool isReplicated() const;
+
+  /**
+   * Get key to be passed to `mbedtls_ssl_set_hs_own_cert` or `mbedtls_ssl_conf_own_cert`.
+   * For replicated keys each call returns the next lane.<br>
+   * Safe to be used by concurrent handshakes.
+   * @return - `mbedtls_pk_context*`.
+   */
+  mbedtls_pk_context* getHandshakeKey();
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_PrivateKey_hpp
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "RandomGenerator.hpp"
+
+#include <thread>
+#include <functional>
+#include <string>
+
+namespace oatpp { namespace mbedtls {
+
+RandomGenerator::RandomGenerator(mbedtls_entropy_context* entropy, v_int32 shardsCount, int reseedInterval)
+  : m_contentions(0)
+{
+
+  if(shardsCount < 1) {
+    throw std::runtime_error("[oatpp::mbedtls::RandomGenerator::RandomGenerator()]: Error. Invalid shards count.");
+  }
+
+  for(v_int32 i = 0; i < shardsCount; i ++) {
+
+    auto shard = new Shard();
+    mbedtls_ctr_drbg_init(&shard->drbg);
+    m_shards.push_back(shard);
+
+    /* Personalization keeps shards distinct even if entropy source misbehaves */
+    std::string personalization = "oatpp-mbedtls-shard-" + std::to_string(i);
+
+    auto res = mbedtls_ctr_drbg_seed(&shard->drbg, mbedtls_entropy_func, entropy,
+                                     (const unsigned char*) personalization.data(), personalization.size());
+    if(res != 0) {
+      OATPP_LOGD("[oatpp::mbedtls::RandomGenerator::RandomGenerator()]", "Error. Call to mbedtls_ctr_drbg_seed() failed, return value=%d.", res);
+      for(auto s : m_shards) {
+        mbedtls_ctr_drbg_free(&s->drbg);
+        delete s;
+      }
+      throw std::runtime_error("[oatpp::mbedtls::RandomGenerator::RandomGenerator()]: Error. Call to mbedtls_ctr_drbg_seed() failed.");
+    }
+
+    if(reseedInterval > 0) {
+      mbedtls_ctr_drbg_set_reseed_interval(&shard->drbg, reseedInterval);
+    }
+
+  }
+
+}
+
+RandomGenerator::~RandomGenerator() {
+  for(auto shard : m_shards) {
+    mbedtls_ctr_drbg_free(&shard->drbg);
+    delete shard;
+  }
+}
+
+RandomGenerator::Shard* RandomGenerator::acquireShard() {
+
+  const size_t size = m_shards.size();
+  const size_t home = std::hash<std::thread::id>()(std::this_thread::get_id()) % size;
+
+  for(size_t i = 0; i < size; i ++) {
+    auto shard = m_shards[(home + i) % size];
+    if(shard->lock.try_lock()) {
+      if(i > 0) {
+        ++ m_contentions;
+      }
+      return shard;
+    }
+  }
+
+  ++ m_contentions;
+  auto shard = m_shards[home];
+  shard->lock.lock();
+  return shard;
+
+}
+
+int RandomGenerator::generate(unsigned char* output, size_t length) {
+  auto shard = acquireShard();
+  auto res = mbedtls_ctr_drbg_random(&shard->drbg, output, length);
+  shard->lock.unlock();
+  return res;
+}
+
+v_int32 RandomGenerator::getShardsCount() const {
+  return (v_int32) m_shards.size();
+}
+
+v_int64 RandomGenerator::getContentions() const {
+  return m_contentions;
+}
+
+}}
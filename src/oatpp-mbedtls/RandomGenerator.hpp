@@ -0,0 +1,97 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_RandomGenerator_hpp
+#define oatpp_mbedtls_RandomGenerator_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace oatpp { namespace mbedtls {
+
+/**
+ * Random generator made of several CTR_DRBG shards, each seeded from the shared entropy and having its own lock.<br>
+ * Thread draws from the shard picked by its thread id and moves to the next shard if that one is busy,
+ * so with at least as many shards as threads every thread effectively has its own generator.
+ * Shared entropy is only touched when a shard reseeds.
+ */
+class RandomGenerator {
+private:
+
+  struct Shard {
+    std::mutex lock;
+    mbedtls_ctr_drbg_context drbg;
+  };
+
+private:
+  Shard* acquireShard();
+private:
+  std::vector<Shard*> m_shards;
+  std::atomic<v_int64> m_contentions;
+public:
+
+  /**
+   * Constructor.
+   * @param entropy - entropy to seed shards from. Must outlive the generator.
+   * @param shardsCount - number of shards.
+   * @param reseedInterval - number of draws after which a shard reseeds. `0` - Mbed TLS default.
+   */
+  RandomGenerator(mbedtls_entropy_context* entropy, v_int32 shardsCount, int reseedInterval);
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~RandomGenerator();
+
+  /**
+   * Fill buffer with random bytes. Thread-safe.
+   * @param output - output buffer.
+   * @param length - number of bytes to generate.
+   * @return - `0` on success, Mbed TLS error code otherwise.
+   */
+  int generate(unsigned char* output, size_t length);
+
+  /**
+   * Get number of shards.
+   * @return - number of shards.
+   */
+  v_int32 getShardsCount() const;
+
+  /**
+   * Get number of draws which found their shard busy and had to take another one or wait.
+   * @return - number of contended draws.
+   */
+  v_int64 getContentions() const;
+
+};
+
+}}
+
+#endif // oatpp_mbedtls_RandomGenerator_hpp
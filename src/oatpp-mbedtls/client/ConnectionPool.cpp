@@ -0,0 +1,296 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ConnectionPool.hpp"
+
+#include "oatpp-mbedtls/Connection.hpp"
+
+namespace oatpp { namespace mbedtls { namespace client {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionPool::Pool
+
+ConnectionPool::Pool::Pool(v_int64 maxIdleConnections, v_int64 maxIdleTimeSeconds, v_int64 maxLifetimeSeconds)
+  : m_stopped(false)
+  , m_maxIdleConnections(maxIdleConnections)
+  , m_maxIdleTimeMicroseconds(maxIdleTimeSeconds * 1000 * 1000)
+  , m_maxLifetimeMicroseconds(maxLifetimeSeconds * 1000 * 1000)
+  , reused(0)
+  , created(0)
+  , expired(0)
+  , dead(0)
+{}
+
+bool ConnectionPool::Pool::take(IdleEntry& entry, data::stream::IOMode ioMode) {
+
+  while(true) {
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if(m_idle.empty()) {
+        return false;
+      }
+      /* most recently used first - least recently used connections expire */
+      entry = m_idle.back();
+      m_idle.pop_back();
+    }
+
+    auto tick = oatpp::base::Environment::getMicroTickCount();
+
+    if(tick - entry.idleSinceTick > m_maxIdleTimeMicroseconds || tick - entry.createdTick > m_maxLifetimeMicroseconds) {
+      entry.connection.invalidator->invalidate(entry.connection.object);
+      ++ expired;
+      continue;
+    }
+
+    if(!ConnectionPool::isAlive(entry.connection)) {
+      entry.connection.invalidator->invalidate(entry.connection.object);
+      ++ dead;
+      continue;
+    }
+
+    entry.connection.object->setInputStreamIOMode(ioMode);
+    entry.connection.object->setOutputStreamIOMode(ioMode);
+
+    ++ reused;
+    return true;
+
+  }
+
+}
+
+void ConnectionPool::Pool::release(const provider::ResourceHandle<data::stream::IOStream>& connection, v_int64 createdTick) {
+
+  auto tick = oatpp::base::Environment::getMicroTickCount();
+
+  if(tick - createdTick <= m_maxLifetimeMicroseconds) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(!m_stopped && (v_int64) m_idle.size() < m_maxIdleConnections) {
+      m_idle.push_back({connection, createdTick, tick});
+      return;
+    }
+  }
+
+  connection.invalidator->invalidate(connection.object);
+
+}
+
+void ConnectionPool::Pool::stop() {
+
+  std::list<IdleEntry> idle;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stopped = true;
+    idle.swap(m_idle);
+  }
+
+  for(auto& entry : idle) {
+    entry.connection.invalidator->invalidate(entry.connection.object);
+  }
+
+}
+
+v_int64 ConnectionPool::Pool::getIdleCount() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return (v_int64) m_idle.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionPool::PooledConnection
+
+ConnectionPool::PooledConnection::PooledConnection(const provider::ResourceHandle<data::stream::IOStream>& connection,
+                                                   v_int64 createdTick,
+                                                   const std::shared_ptr<Pool>& pool)
+  : m_connection(connection)
+  , m_createdTick(createdTick)
+  , m_pool(pool)
+  , m_invalidated(false)
+{}
+
+ConnectionPool::PooledConnection::~PooledConnection() {
+  if(!m_invalidated) {
+    m_pool->release(m_connection, m_createdTick);
+  }
+}
+
+void ConnectionPool::PooledConnection::invalidate() {
+  if(!m_invalidated.exchange(true)) {
+    m_connection.invalidator->invalidate(m_connection.object);
+  }
+}
+
+v_io_size ConnectionPool::PooledConnection::write(const void *data, v_buff_size count, async::Action& action) {
+  return m_connection.object->write(data, count, action);
+}
+
+v_io_size ConnectionPool::PooledConnection::read(void *buff, v_buff_size count, async::Action& action) {
+  return m_connection.object->read(buff, count, action);
+}
+
+void ConnectionPool::PooledConnection::setOutputStreamIOMode(data::stream::IOMode ioMode) {
+  m_connection.object->setOutputStreamIOMode(ioMode);
+}
+
+data::stream::IOMode ConnectionPool::PooledConnection::getOutputStreamIOMode() {
+  return m_connection.object->getOutputStreamIOMode();
+}
+
+data::stream::Context& ConnectionPool::PooledConnection::getOutputStreamContext() {
+  return m_connection.object->getOutputStreamContext();
+}
+
+void ConnectionPool::PooledConnection::setInputStreamIOMode(data::stream::IOMode ioMode) {
+  m_connection.object->setInputStreamIOMode(ioMode);
+}
+
+data::stream::IOMode ConnectionPool::PooledConnection::getInputStreamIOMode() {
+  return m_connection.object->getInputStreamIOMode();
+}
+
+data::stream::Context& ConnectionPool::PooledConnection::getInputStreamContext() {
+  return m_connection.object->getInputStreamContext();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionPool::PooledConnectionInvalidator
+
+void ConnectionPool::PooledConnectionInvalidator::invalidate(const std::shared_ptr<data::stream::IOStream>& connection) {
+  auto c = std::static_pointer_cast<PooledConnection>(connection);
+  c->invalidate();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionPool
+
+ConnectionPool::ConnectionPool(const std::shared_ptr<ConnectionProvider>& connectionProvider,
+                               v_int64 maxIdleConnections,
+                               v_int64 maxIdleTimeSeconds,
+                               v_int64 maxLifetimeSeconds)
+  : m_connectionProvider(connectionProvider)
+  , m_pool(std::make_shared<Pool>(maxIdleConnections, maxIdleTimeSeconds, maxLifetimeSeconds))
+  , m_invalidator(std::make_shared<PooledConnectionInvalidator>())
+{
+  setProperty(PROPERTY_HOST, connectionProvider->getProperty(PROPERTY_HOST).toString());
+  setProperty(PROPERTY_PORT, connectionProvider->getProperty(PROPERTY_PORT).toString());
+}
+
+std::shared_ptr<ConnectionPool> ConnectionPool::createShared(const std::shared_ptr<ConnectionProvider>& connectionProvider,
+                                                             v_int64 maxIdleConnections,
+                                                             v_int64 maxIdleTimeSeconds,
+                                                             v_int64 maxLifetimeSeconds)
+{
+  return std::make_shared<ConnectionPool>(connectionProvider, maxIdleConnections, maxIdleTimeSeconds, maxLifetimeSeconds);
+}
+
+bool ConnectionPool::isAlive(const provider::ResourceHandle<data::stream::IOStream>& connection) {
+
+  return std::static_pointer_cast<Connection>(connection.object)->probe();
+
+}
+
+provider::ResourceHandle<data::stream::IOStream> ConnectionPool::wrap(const provider::ResourceHandle<data::stream::IOStream>& connection,
+                                                                      v_int64 createdTick,
+                                                                      const std::shared_ptr<Pool>& pool,
+                                                                      const std::shared_ptr<PooledConnectionInvalidator>& invalidator)
+{
+  return provider::ResourceHandle<data::stream::IOStream>(
+    std::make_shared<PooledConnection>(connection, createdTick, pool),
+    invalidator
+  );
+}
+
+void ConnectionPool::stop() {
+  m_pool->stop();
+  m_connectionProvider->stop();
+}
+
+provider::ResourceHandle<data::stream::IOStream> ConnectionPool::get() {
+
+  IdleEntry entry;
+  if(m_pool->take(entry, data::stream::IOMode::BLOCKING)) {
+    return wrap(entry.connection, entry.createdTick, m_pool, m_invalidator);
+  }
+
+  auto connection = m_connectionProvider->get();
+  if(!connection) {
+    return nullptr;
+  }
+
+  ++ m_pool->created;
+  return wrap(connection, oatpp::base::Environment::getMicroTickCount(), m_pool, m_invalidator);
+
+}
+
+oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> ConnectionPool::getAsync() {
+
+  class GetCoroutine : public oatpp::async::CoroutineWithResult<GetCoroutine, const provider::ResourceHandle<data::stream::IOStream>&> {
+  private:
+    std::shared_ptr<ConnectionProvider> m_connectionProvider;
+    std::shared_ptr<Pool> m_pool;
+    std::shared_ptr<PooledConnectionInvalidator> m_invalidator;
+  public:
+
+    GetCoroutine(const std::shared_ptr<ConnectionProvider>& connectionProvider,
+                 const std::shared_ptr<Pool>& pool,
+                 const std::shared_ptr<PooledConnectionInvalidator>& invalidator)
+      : m_connectionProvider(connectionProvider)
+      , m_pool(pool)
+      , m_invalidator(invalidator)
+    {}
+
+    Action act() override {
+      /* liveness check is non-blocking - safe to run on the executor thread */
+      IdleEntry entry;
+      if(m_pool->take(entry, data::stream::IOMode::ASYNCHRONOUS)) {
+        return _return(wrap(entry.connection, entry.createdTick, m_pool, m_invalidator));
+      }
+      return m_connectionProvider->getAsync().callbackTo(&GetCoroutine::onConnected);
+    }
+
+    Action onConnected(const provider::ResourceHandle<data::stream::IOStream>& connection) {
+      if(!connection) {
+        return _return(nullptr);
+      }
+      ++ m_pool->created;
+      return _return(wrap(connection, oatpp::base::Environment::getMicroTickCount(), m_pool, m_invalidator));
+    }
+
+  };
+
+  return GetCoroutine::startForResult(m_connectionProvider, m_pool, m_invalidator);
+
+}
+
+ConnectionPool::Statistics ConnectionPool::getStatistics() {
+  Statistics stats;
+  stats.reused = m_pool->reused;
+  stats.created = m_pool->created;
+  stats.expired = m_pool->expired;
+  stats.dead = m_pool->dead;
+  stats.idle = m_pool->getIdleCount();
+  return stats;
+}
+
+}}}
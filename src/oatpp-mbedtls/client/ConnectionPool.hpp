@@ -0,0 +1,207 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_client_ConnectionPool_hpp
+#define oatpp_mbedtls_client_ConnectionPool_hpp
+
+#include "./ConnectionProvider.hpp"
+
+#include <list>
+#include <mutex>
+#include <atomic>
+
+namespace oatpp { namespace mbedtls { namespace client {
+
+/**
+ * Pool of keep-alive TLS client connections.<br>
+ * Wraps &id:oatpp::mbedtls::client::ConnectionProvider;. Connection returns to the pool when its handle is released
+ * without being invalidated. Before an idle connection is reused it is checked to be alive -
+ * a connection with pending data, received close_notify or closed transport is dropped.
+ * Connections idle for longer than `maxIdleTime` or older than `maxLifetime` are dropped too.<br>
+ * Extends &id:oatpp::network::ClientConnectionProvider;.
+ */
+class ConnectionPool : public oatpp::network::ClientConnectionProvider {
+public:
+
+  /**
+   * Pool statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of connections taken from the pool.
+     */
+    v_int64 reused;
+
+    /**
+     * Number of new connections established.
+     */
+    v_int64 created;
+
+    /**
+     * Number of idle connections dropped due to `maxIdleTime` or `maxLifetime`.
+     */
+    v_int64 expired;
+
+    /**
+     * Number of idle connections dropped because liveness check failed.
+     */
+    v_int64 dead;
+
+    /**
+     * Current number of idle connections.
+     */
+    v_int64 idle;
+
+  };
+
+private:
+
+  struct IdleEntry {
+    provider::ResourceHandle<data::stream::IOStream> connection;
+    v_int64 createdTick;
+    v_int64 idleSinceTick;
+  };
+
+  class Pool {
+  private:
+    std::mutex m_lock;
+    std::list<IdleEntry> m_idle;
+    bool m_stopped;
+  private:
+    v_int64 m_maxIdleConnections;
+    v_int64 m_maxIdleTimeMicroseconds;
+    v_int64 m_maxLifetimeMicroseconds;
+  public:
+    std::atomic<v_int64> reused;
+    std::atomic<v_int64> created;
+    std::atomic<v_int64> expired;
+    std::atomic<v_int64> dead;
+  public:
+
+    Pool(v_int64 maxIdleConnections, v_int64 maxIdleTimeSeconds, v_int64 maxLifetimeSeconds);
+
+    bool take(IdleEntry& entry, data::stream::IOMode ioMode);
+    void release(const provider::ResourceHandle<data::stream::IOStream>& connection, v_int64 createdTick);
+    void stop();
+    v_int64 getIdleCount();
+
+  };
+
+  class PooledConnection : public oatpp::base::Countable, public data::stream::IOStream {
+  private:
+    provider::ResourceHandle<data::stream::IOStream> m_connection;
+    v_int64 m_createdTick;
+    std::shared_ptr<Pool> m_pool;
+    std::atomic<bool> m_invalidated;
+  public:
+
+    PooledConnection(const provider::ResourceHandle<data::stream::IOStream>& connection, v_int64 createdTick, const std::shared_ptr<Pool>& pool);
+    ~PooledConnection();
+
+    void invalidate();
+
+    v_io_size write(const void *data, v_buff_size count, async::Action& action) override;
+    v_io_size read(void *buff, v_buff_size count, async::Action& action) override;
+
+    void setOutputStreamIOMode(data::stream::IOMode ioMode) override;
+    data::stream::IOMode getOutputStreamIOMode() override;
+    data::stream::Context& getOutputStreamContext() override;
+
+    void setInputStreamIOMode(data::stream::IOMode ioMode) override;
+    data::stream::IOMode getInputStreamIOMode() override;
+    data::stream::Context& getInputStreamContext() override;
+
+  };
+
+  class PooledConnectionInvalidator : public provider::Invalidator<data::stream::IOStream> {
+  public:
+    void invalidate(const std::shared_ptr<data::stream::IOStream>& connection) override;
+  };
+
+private:
+  static bool isAlive(const provider::ResourceHandle<data::stream::IOStream>& connection);
+  static provider::ResourceHandle<data::stream::IOStream> wrap(const provider::ResourceHandle<data::stream::IOStream>& connection,
+                                                               v_int64 createdTick,
+                                                               const std::shared_ptr<Pool>& pool,
+                                                               const std::shared_ptr<PooledConnectionInvalidator>& invalidator);
+private:
+  std::shared_ptr<ConnectionProvider> m_connectionProvider;
+  std::shared_ptr<Pool> m_pool;
+  std::shared_ptr<PooledConnectionInvalidator> m_invalidator;
+public:
+
+  /**
+   * Constructor.
+   * @param connectionProvider - &id:oatpp::mbedtls::client::ConnectionProvider;.
+   * @param maxIdleConnections - max number of idle connections kept in the pool.
+   * @param maxIdleTimeSeconds - max time connection may stay idle in the pool.
+   * @param maxLifetimeSeconds - max connection age. Older connections are not reused.
+   */
+  ConnectionPool(const std::shared_ptr<ConnectionProvider>& connectionProvider,
+                 v_int64 maxIdleConnections,
+                 v_int64 maxIdleTimeSeconds,
+                 v_int64 maxLifetimeSeconds);
+
+  /**
+   * Create shared ConnectionPool.
+   * @param connectionProvider - &id:oatpp::mbedtls::client::ConnectionProvider;.
+   * @param maxIdleConnections - max number of idle connections kept in the pool. Default `16`.
+   * @param maxIdleTimeSeconds - max time connection may stay idle in the pool. Default `30`.
+   * @param maxLifetimeSeconds - max connection age. Default `600`.
+   * @return - `std::shared_ptr` to ConnectionPool.
+   */
+  static std::shared_ptr<ConnectionPool> createShared(const std::shared_ptr<ConnectionProvider>& connectionProvider,
+                                                      v_int64 maxIdleConnections = 16,
+                                                      v_int64 maxIdleTimeSeconds = 30,
+                                                      v_int64 maxLifetimeSeconds = 600);
+
+  /**
+   * Drop idle connections and stop pooling. Connections released after this call are closed.
+   */
+  void stop() override;
+
+  /**
+   * Get pooled connection or establish a new one.
+   * @return - `std::shared_ptr` to &id:oatpp::data::stream::IOStream;.
+   */
+  provider::ResourceHandle<data::stream::IOStream> get() override;
+
+  /**
+   * Get pooled connection or establish a new one in asynchronous manner.
+   * @return - &id:oatpp::async::CoroutineStarterForResult;.
+   */
+  oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> getAsync() override;
+
+  /**
+   * Get pool statistics.
+   * @return - &l:ConnectionPool::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_client_ConnectionPool_hpp
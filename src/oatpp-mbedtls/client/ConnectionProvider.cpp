@@ -31,6 +31,12 @@
 
 namespace oatpp { namespace mbedtls { namespace client {
 
+ConnectionProvider::ConnectionInvalidator::ConnectionInvalidator(const std::shared_ptr<SessionCache>& sessionCache,
+                                                                 const std::string& sessionKey)
+  : m_sessionCache(sessionCache)
+  , m_sessionKey(sessionKey)
+{}
+
 void ConnectionProvider::ConnectionInvalidator::invalidate(const std::shared_ptr<data::stream::IOStream> &connection){
 
   auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection);
@@ -45,6 +51,25 @@ void ConnectionProvider::ConnectionInvalidator::invalidate(const std::shared_ptr
    * waiting for TLS events.
    ********************************************/
 
+  /* Save session for resumption before the transport goes away */
+  if(m_sessionCache && c->getHandshakeResult() == 0) {
+    auto session = new mbedtls_ssl_session();
+    mbedtls_ssl_session_init(session);
+    if(c->getSession(session) == 0) {
+      m_sessionCache->save(m_sessionKey, session);
+    } else {
+      mbedtls_ssl_session_free(session);
+      delete session;
+    }
+  }
+
+  /* Gathered writes are not written here - that would run Mbed TLS. The owner flushes before releasing the connection */
+  auto dropped = c->getGatheredSize();
+  if(dropped > 0) {
+    OATPP_LOGE("[oatpp::mbedtls::client::ConnectionProvider::ConnectionInvalidator::invalidate()]",
+               "Error. %d bytes of gathered data are dropped. Call Connection::flush() before releasing the connection.", (v_int32) dropped);
+  }
+
   /* Invalidate underlying transport */
   auto s = c->getTransportStream();
   s.invalidator->invalidate(s.object);
@@ -53,7 +78,7 @@ void ConnectionProvider::ConnectionInvalidator::invalidate(const std::shared_ptr
 
 ConnectionProvider::ConnectionProvider(const std::shared_ptr<Config>& config,
                                        const std::shared_ptr<oatpp::network::ClientConnectionProvider>& streamProvider)
-  : m_connectionInvalidator(std::make_shared<ConnectionInvalidator>())
+  : m_connectionInvalidator(std::make_shared<ConnectionInvalidator>(nullptr, ""))
   , m_config(config)
   , m_streamProvider(streamProvider)
 {
@@ -61,6 +86,8 @@ ConnectionProvider::ConnectionProvider(const std::shared_ptr<Config>& config,
   setProperty(PROPERTY_HOST, streamProvider->getProperty(PROPERTY_HOST).toString());
   setProperty(PROPERTY_PORT, streamProvider->getProperty(PROPERTY_PORT).toString());
 
+  m_sessionKey = getProperty(PROPERTY_HOST).std_str() + ":" + getProperty(PROPERTY_PORT).std_str();
+
 }
 
 std::shared_ptr<ConnectionProvider> ConnectionProvider::createShared(const std::shared_ptr<Config>& config,
@@ -78,33 +105,51 @@ std::shared_ptr<ConnectionProvider> ConnectionProvider::createShared(const std::
   );
 }
 
+void ConnectionProvider::setSessionCache(const std::shared_ptr<SessionCache>& sessionCache) {
+  m_sessionCache = sessionCache;
+  m_connectionInvalidator = std::make_shared<ConnectionInvalidator>(m_sessionCache, m_sessionKey);
+}
+
+std::shared_ptr<SessionCache> ConnectionProvider::getSessionCache() {
+  return m_sessionCache;
+}
+
 provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::get(){
+  return getWithEarlyData(nullptr);
+}
+
+provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::getWithEarlyData(const oatpp::String& data) {
 
   v_int32 flags;
   auto stream = m_streamProvider->get();
 
-  auto * tlsHandle = new mbedtls_ssl_context();
-  mbedtls_ssl_init(tlsHandle);
-
-  auto res = mbedtls_ssl_setup(tlsHandle, m_config->getTLSConfig());
-  if(res != 0) {
-    mbedtls_ssl_free(tlsHandle);
-    delete tlsHandle;
-    OATPP_LOGD("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]", "Error. Call to mbedtls_ssl_setup() failed. Return value=%d", res);
+  auto * tlsHandle = m_config->createTLSContext();
+  if(tlsHandle == nullptr) {
     throw std::runtime_error("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]: Error. Call to mbedtls_ssl_setup() failed.");
   }
 
-  res = mbedtls_ssl_set_hostname(tlsHandle, (const char*) getProperty(PROPERTY_HOST).getData());
+  auto res = mbedtls_ssl_set_hostname(tlsHandle, (const char*) getProperty(PROPERTY_HOST).getData());
   if(res != 0) {
-    mbedtls_ssl_free(tlsHandle);
-    delete tlsHandle;
+    m_config->destroyTLSContext(tlsHandle);
     OATPP_LOGD("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]", "Error. Call to mbedtls_ssl_set_hostname() failed. Return value=%d", res);
     throw std::runtime_error("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]: Error. Call to mbedtls_ssl_set_hostname() failed.");
   }
 
-  auto connection = std::make_shared<Connection>(tlsHandle, stream, false);
+  SessionCache::Session offeredSession;
+  if(m_sessionCache) {
+    offeredSession = m_sessionCache->apply(m_sessionKey, tlsHandle);
+  }
+
+  auto connection = std::make_shared<Connection>(tlsHandle, stream, false, m_config);
+  if(data) {
+    connection->setEarlyData(data);
+  }
   connection->initContexts();
 
+  if(m_sessionCache) {
+    m_sessionCache->onHandshakeDone(m_sessionKey, offeredSession, connection->getHandshakeResult(), tlsHandle);
+  }
+
   if(m_config->shouldThrowOnVerificationFailed()) {
     if ((flags = mbedtls_ssl_get_verify_result(tlsHandle)) != 0) {
       char vrfy_buf[512];
@@ -112,7 +157,7 @@ provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::get(){
       OATPP_LOGE("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]",
                  "Server certificate verification failed: %s",
                  vrfy_buf);
-      mbedtls_ssl_free(tlsHandle);
+      /* tlsHandle is owned by the connection */
       throw std::runtime_error("[oatpp::mbedtls::client::ConnectionProvider::getConnection()]: Error. Server certificate verification failed.");
     }
   }
@@ -122,33 +167,45 @@ provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::get(){
 }
 
 oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> ConnectionProvider::getAsync() {
+  return getWithEarlyDataAsync(nullptr);
+}
+
+oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&>
+ConnectionProvider::getWithEarlyDataAsync(const oatpp::String& data) {
 
   class ConnectCoroutine : public oatpp::async::CoroutineWithResult<ConnectCoroutine, const provider::ResourceHandle<data::stream::IOStream>&> {
   private:
     std::shared_ptr<ConnectionInvalidator> m_connectionInvalidator;
     std::shared_ptr<Config> m_config;
     std::shared_ptr<oatpp::network::ClientConnectionProvider> m_streamProvider;
+    std::shared_ptr<SessionCache> m_sessionCache;
+    std::string m_sessionKey;
+    oatpp::String m_earlyData;
   private:
     mbedtls_ssl_context* m_tlsHandle;
+    SessionCache::Session m_offeredSession;
     provider::ResourceHandle<data::stream::IOStream> m_stream;
     std::shared_ptr<Connection> m_connection;
   public:
 
     ConnectCoroutine(const std::shared_ptr<ConnectionInvalidator>& connectionInvalidator,
                      const std::shared_ptr<Config>& config,
-                     const std::shared_ptr<network::ClientConnectionProvider>& streamProvider)
+                     const std::shared_ptr<network::ClientConnectionProvider>& streamProvider,
+                     const std::shared_ptr<SessionCache>& sessionCache,
+                     const std::string& sessionKey,
+                     const oatpp::String& earlyData)
       : m_connectionInvalidator(connectionInvalidator)
       , m_config(config)
       , m_streamProvider(streamProvider)
-      , m_tlsHandle(new mbedtls_ssl_context())
-    {
-      mbedtls_ssl_init(m_tlsHandle);
-    }
+      , m_sessionCache(sessionCache)
+      , m_sessionKey(sessionKey)
+      , m_earlyData(earlyData)
+      , m_tlsHandle(nullptr)
+    {}
 
     ~ConnectCoroutine() {
       if(m_tlsHandle != nullptr) {
-        mbedtls_ssl_free(m_tlsHandle);
-        delete m_tlsHandle;
+        m_config->destroyTLSContext(m_tlsHandle);
       }
     }
 
@@ -165,21 +222,28 @@ oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::str
 
     Action secureConnection() {
 
-      auto res = mbedtls_ssl_setup(m_tlsHandle, m_config->getTLSConfig());
-      if(res != 0) {
-        OATPP_LOGD("[oatpp::mbedtls::client::ConnectionProvider::getConnectionAsync()]", "Error. Call to mbedtls_ssl_setup() failed. Return value=%d", res);
+      m_tlsHandle = m_config->createTLSContext();
+      if(m_tlsHandle == nullptr) {
         return error<Error>("[oatpp::mbedtls::client::ConnectionProvider::getConnectionAsync()]: Error. Call to mbedtls_ssl_setup() failed.");
       }
 
-      res = mbedtls_ssl_set_hostname(m_tlsHandle, (const char*) m_streamProvider->getProperty(PROPERTY_HOST).getData());
+      auto res = mbedtls_ssl_set_hostname(m_tlsHandle, (const char*) m_streamProvider->getProperty(PROPERTY_HOST).getData());
       if(res != 0) {
         OATPP_LOGD("[oatpp::mbedtls::client::ConnectionProvider::getConnectionAsync()]", "Error. Call to mbedtls_ssl_set_hostname() failed. Return value=%d", res);
         return error<Error>("[oatpp::mbedtls::client::ConnectionProvider::getConnectionAsync()]: Error. Call to mbedtls_ssl_set_hostname() failed.");
       }
 
-      m_connection = std::make_shared<Connection>(m_tlsHandle, m_stream, false);
+      if(m_sessionCache) {
+        m_offeredSession = m_sessionCache->apply(m_sessionKey, m_tlsHandle);
+      }
+
+      m_connection = std::make_shared<Connection>(m_tlsHandle, m_stream, false, m_config);
       m_tlsHandle = nullptr;
 
+      if(m_earlyData) {
+        m_connection->setEarlyData(m_earlyData);
+      }
+
       m_connection->setOutputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
       m_connection->setInputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
 
@@ -188,6 +252,11 @@ oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::str
     }
 
     Action verifyServerCertificate() {
+
+      if(m_sessionCache) {
+        m_sessionCache->onHandshakeDone(m_sessionKey, m_offeredSession, m_connection->getHandshakeResult(), m_connection->getTlsHandle());
+      }
+
       v_int32 flags;
       if( ( flags = mbedtls_ssl_get_verify_result( m_connection->getTlsHandle() ) ) != 0 )
       {
@@ -203,10 +272,17 @@ oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::str
       return _return(provider::ResourceHandle<data::stream::IOStream>(m_connection, m_connectionInvalidator));
     }
 
+    Action handleError(Error* error) override {
+      /* Handshake failed - the session offered for it is dropped the same way it is in the blocking path */
+      if(m_sessionCache && m_connection && m_connection->getHandshakeResult() != 0) {
+        m_sessionCache->onHandshakeDone(m_sessionKey, m_offeredSession, m_connection->getHandshakeResult(), m_connection->getTlsHandle());
+      }
+      return error;
+    }
 
   };
 
-  return ConnectCoroutine::startForResult(m_connectionInvalidator, m_config, m_streamProvider);
+  return ConnectCoroutine::startForResult(m_connectionInvalidator, m_config, m_streamProvider, m_sessionCache, m_sessionKey, data);
 
 }
 
@@ -25,6 +25,8 @@
 #ifndef oatpp_mbedtls_client_ConnectionProvider_hpp
 #define oatpp_mbedtls_client_ConnectionProvider_hpp
 
+#include "./SessionCache.hpp"
+
 #include "oatpp-mbedtls/Config.hpp"
 
 #include "oatpp/network/Address.hpp"
@@ -40,14 +42,23 @@ class ConnectionProvider : public oatpp::network::ClientConnectionProvider {
 private:
 
   class ConnectionInvalidator : public provider::Invalidator<data::stream::IOStream> {
+  private:
+    std::shared_ptr<SessionCache> m_sessionCache;
+    std::string m_sessionKey;
   public:
+
+    ConnectionInvalidator(const std::shared_ptr<SessionCache>& sessionCache, const std::string& sessionKey);
+
     void invalidate(const std::shared_ptr<data::stream::IOStream>& connection) override;
+
   };
 
 private:
   std::shared_ptr<ConnectionInvalidator> m_connectionInvalidator;
   std::shared_ptr<Config> m_config;
   std::shared_ptr<oatpp::network::ClientConnectionProvider> m_streamProvider;
+  std::shared_ptr<SessionCache> m_sessionCache;
+  std::string m_sessionKey;
 public:
   /**
    * Constructor.
@@ -77,6 +88,20 @@ public:
   static std::shared_ptr<ConnectionProvider> createShared(const std::shared_ptr<Config>& config,
                                                           const network::Address& address);
 
+  /**
+   * Enable client-side session resumption. Sessions are saved on connection invalidation and
+   * reused on the next connect to the same `host:port`. Cache may be shared by several providers.<br>
+   * *Must be set before connections are requested from this provider.*
+   * @param sessionCache - &id:oatpp::mbedtls::client::SessionCache;. `nullptr` to disable resumption.
+   */
+  void setSessionCache(const std::shared_ptr<SessionCache>& sessionCache);
+
+  /**
+   * Get client session cache.
+   * @return - &id:oatpp::mbedtls::client::SessionCache; or `nullptr` if not set.
+   */
+  std::shared_ptr<SessionCache> getSessionCache();
+
   /**
    * Implements &id:oatpp::network::ConnectionProvider::close;. Here does nothing.
    */
@@ -96,6 +121,24 @@ public:
    */
   oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> getAsync() override;
 
+  /**
+   * Get connection and deliver `data` as its first bytes.
+   * On a resumed TLS 1.3 session the data is sent with the ClientHello as early data (0-RTT),
+   * otherwise it's written right after the handshake. See &id:oatpp::mbedtls::Connection::setEarlyData;.<br>
+   * Early data is sent only if enabled by &id:oatpp::mbedtls::Config::setEarlyData; and a session cache is set.
+   * @param data - first bytes of the connection. Should be an idempotent request - early data can be replayed.
+   * @return - `std::shared_ptr` to &id:oatpp::data::stream::IOStream;.
+   */
+  provider::ResourceHandle<data::stream::IOStream> getWithEarlyData(const oatpp::String& data);
+
+  /**
+   * Get connection in asynchronous manner and deliver `data` as its first bytes.
+   * See &l:ConnectionProvider::getWithEarlyData ();.
+   * @param data - first bytes of the connection.
+   * @return - &id:oatpp::async::CoroutineStarterForResult;.
+   */
+  oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> getWithEarlyDataAsync(const oatpp::String& data);
+
 };
 
 }}}
@@ -0,0 +1,194 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+/* Resumption is detected from the negotiated session - fields are private in Mbed TLS 3.x */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include "SessionCache.hpp"
+
+#include "mbedtls/platform.h"
+
+#include <cstring>
+
+namespace oatpp { namespace mbedtls { namespace client {
+
+SessionCache::SessionCache(v_int64 maxEntries, v_int64 timeoutSeconds)
+  : m_maxEntries(maxEntries < 1 ? 1 : maxEntries)
+  , m_timeoutMicroseconds(timeoutSeconds * 1000 * 1000)
+  , m_offered(0)
+  , m_resumed(0)
+  , m_stores(0)
+  , m_evictions(0)
+{}
+
+std::shared_ptr<SessionCache> SessionCache::createShared(v_int64 maxEntries, v_int64 timeoutSeconds) {
+  return std::make_shared<SessionCache>(maxEntries, timeoutSeconds);
+}
+
+void SessionCache::freeSession(mbedtls_ssl_session* session) {
+  mbedtls_ssl_session_free(session);
+  delete session;
+}
+
+SessionCache::Session SessionCache::apply(const std::string& key, mbedtls_ssl_context* tlsHandle) {
+
+  Session session;
+
+  {
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) {
+      return nullptr;
+    }
+
+    if(oatpp::base::Environment::getMicroTickCount() - it->second.timestamp > m_timeoutMicroseconds) {
+      m_lru.erase(it->second.lruPosition);
+      m_entries.erase(it);
+      return nullptr;
+    }
+
+    session = it->second.session;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lruPosition);
+
+  }
+
+  /* mbedtls_ssl_set_session() deep-copies the session - do it outside of the lock */
+  auto res = mbedtls_ssl_set_session(tlsHandle, session.get());
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::client::SessionCache::apply()]", "Error. Call to mbedtls_ssl_set_session() failed. Return value=%d", res);
+    return nullptr;
+  }
+
+  ++ m_offered;
+  return session;
+
+}
+
+void SessionCache::onHandshakeDone(const std::string& key, const Session& offered, int handshakeResult, mbedtls_ssl_context* tlsHandle) {
+
+  if(!offered) {
+    return;
+  }
+
+  if(handshakeResult != 0) {
+    remove(key);
+    return;
+  }
+
+  if(tlsHandle->session == nullptr) {
+    return;
+  }
+
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+  if(mbedtls_ssl_get_version_number(tlsHandle) == MBEDTLS_SSL_VERSION_TLS1_3) {
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+    /* Cached sessions are stored without peer certificate (see save()) - the server didn't send one only if it accepted the ticket */
+    if(tlsHandle->session->peer_cert == nullptr) {
+      ++ m_resumed;
+    }
+#endif
+    return;
+  }
+#endif
+
+  /* Master secret is carried over only when the server resumed the offered session */
+  if(std::memcmp(tlsHandle->session->master, offered->master, sizeof(offered->master)) == 0) {
+    ++ m_resumed;
+  }
+
+}
+
+void SessionCache::save(const std::string& key, mbedtls_ssl_session* session) {
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+  /* Peer certificate isn't needed to resume the session. Without it cached sessions are smaller and resumption is detectable in TLS 1.3 */
+  if(session->peer_cert != nullptr) {
+    mbedtls_x509_crt_free(session->peer_cert);
+    mbedtls_free(session->peer_cert);
+    session->peer_cert = nullptr;
+  }
+#endif
+
+  Entry entry;
+  entry.session = Session(session, &SessionCache::freeSession);
+  entry.timestamp = oatpp::base::Environment::getMicroTickCount();
+
+  Session replaced; // released after the lock
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = m_entries.find(key);
+  if(it != m_entries.end()) {
+    replaced = it->second.session;
+    m_lru.erase(it->second.lruPosition);
+    m_entries.erase(it);
+  }
+
+  while((v_int64) m_entries.size() >= m_maxEntries) {
+    m_entries.erase(m_lru.back());
+    m_lru.pop_back();
+    ++ m_evictions;
+  }
+
+  m_lru.push_front(key);
+  entry.lruPosition = m_lru.begin();
+  m_entries.insert({key, entry});
+
+  ++ m_stores;
+
+}
+
+void SessionCache::remove(const std::string& key) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto it = m_entries.find(key);
+  if(it != m_entries.end()) {
+    m_lru.erase(it->second.lruPosition);
+    m_entries.erase(it);
+  }
+}
+
+void SessionCache::clear() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_entries.clear();
+  m_lru.clear();
+}
+
+SessionCache::Statistics SessionCache::getStatistics() {
+
+  Statistics stats;
+  stats.offered = m_offered;
+  stats.resumed = m_resumed;
+  stats.stores = m_stores;
+  stats.evictions = m_evictions;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  stats.size = (v_int64) m_entries.size();
+
+  return stats;
+
+}
+
+}}}
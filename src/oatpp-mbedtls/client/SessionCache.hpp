@@ -0,0 +1,174 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_client_SessionCache_hpp
+#define oatpp_mbedtls_client_SessionCache_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+
+#include <unordered_map>
+#include <list>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+namespace oatpp { namespace mbedtls { namespace client {
+
+/**
+ * Client-side cache of negotiated TLS sessions keyed by `host:port`.<br>
+ * Session is saved when connection is invalidated and is offered to the server on the next connect to the same host and port,
+ * so the server may do an abbreviated handshake (by session ID or by session ticket).<br>
+ * Number of entries is bounded - least recently used entries are evicted.
+ * Use with &id:oatpp::mbedtls::client::ConnectionProvider::setSessionCache;.
+ */
+class SessionCache {
+public:
+
+  /**
+   * Cache statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of handshakes where a cached session was offered to the server.
+     */
+    v_int64 offered;
+
+    /**
+     * Number of handshakes where the offered session was resumed by the server.
+     */
+    v_int64 resumed;
+
+    /**
+     * Number of sessions saved.
+     */
+    v_int64 stores;
+
+    /**
+     * Number of entries evicted due to cache size limit.
+     */
+    v_int64 evictions;
+
+    /**
+     * Current number of entries.
+     */
+    v_int64 size;
+
+  };
+
+public:
+
+  /**
+   * Cached session. Immutable once stored - may be applied to several handshakes at the same time.
+   */
+  typedef std::shared_ptr<const mbedtls_ssl_session> Session;
+
+private:
+
+  struct Entry {
+    Session session;
+    v_int64 timestamp;
+    std::list<std::string>::iterator lruPosition;
+  };
+
+private:
+  static void freeSession(mbedtls_ssl_session* session);
+private:
+  v_int64 m_maxEntries;
+  v_int64 m_timeoutMicroseconds;
+  std::mutex m_lock;
+  std::unordered_map<std::string, Entry> m_entries;
+  std::list<std::string> m_lru;
+private:
+  std::atomic<v_int64> m_offered;
+  std::atomic<v_int64> m_resumed;
+  std::atomic<v_int64> m_stores;
+  std::atomic<v_int64> m_evictions;
+public:
+
+  /**
+   * Constructor.
+   * @param maxEntries - max number of cached sessions.
+   * @param timeoutSeconds - sessions older than this are not offered.
+   */
+  SessionCache(v_int64 maxEntries, v_int64 timeoutSeconds);
+
+  /**
+   * Create shared SessionCache.
+   * @param maxEntries - max number of cached sessions. Default `1024`.
+   * @param timeoutSeconds - sessions older than this are not offered. Default `3600`.
+   * @return - `std::shared_ptr` to SessionCache.
+   */
+  static std::shared_ptr<SessionCache> createShared(v_int64 maxEntries = 1024, v_int64 timeoutSeconds = 3600);
+
+  /**
+   * Offer cached session for `key` in the upcoming handshake. Call after `mbedtls_ssl_setup` and before handshake.
+   * @param key - `host:port`.
+   * @param tlsHandle - `mbedtls_ssl_context*`.
+   * @return - offered session or `nullptr` if nothing was offered.
+   */
+  Session apply(const std::string& key, mbedtls_ssl_context* tlsHandle);
+
+  /**
+   * Account handshake outcome. Call after handshake has finished.
+   * If the handshake failed the cached session for `key` is dropped.
+   * @param key - `host:port`.
+   * @param offered - session returned by &l:SessionCache::apply ();.
+   * @param handshakeResult - result of the handshake. `0` on success.
+   * @param tlsHandle - `mbedtls_ssl_context*`.
+   */
+  void onHandshakeDone(const std::string& key, const Session& offered, int handshakeResult, mbedtls_ssl_context* tlsHandle);
+
+  /**
+   * Save session for `key`.
+   * @param key - `host:port`.
+   * @param session - session obtained with `mbedtls_ssl_get_session`. Ownership is taken by the cache.
+   */
+  void save(const std::string& key, mbedtls_ssl_session* session);
+
+  /**
+   * Remove cached session for `key`.
+   * @param key - `host:port`.
+   */
+  void remove(const std::string& key);
+
+  /**
+   * Remove all cached sessions.
+   */
+  void clear();
+
+  /**
+   * Get cache statistics.
+   * @return - &l:SessionCache::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_client_SessionCache_hpp
@@ -0,0 +1,596 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+
+#include "CertificateStore.hpp"
+
+#include "oatpp-mbedtls/Connection.hpp"
+
+#include "mbedtls/oid.h"
+#include "mbedtls/ssl_ciphersuites.h"
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+namespace {
+
+class Reader {
+private:
+  const v_uint8* m_data;
+  size_t m_size;
+  size_t m_position;
+  bool m_valid;
+public:
+
+  Reader(const v_uint8* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+    , m_position(0)
+    , m_valid(true)
+  {}
+
+  bool skip(size_t count) {
+    if(m_size - m_position < count) {
+      m_position = m_size;
+      m_valid = false;
+      return false;
+    }
+    m_position += count;
+    return true;
+  }
+
+  v_uint32 readInt(v_int32 bytes) {
+    if(!skip((size_t) bytes)) {
+      return 0;
+    }
+    v_uint32 result = 0;
+    for(v_int32 i = bytes; i > 0; i --) {
+      result = (result << 8) | m_data[m_position - i];
+    }
+    return result;
+  }
+
+  Reader readVector(v_int32 lengthBytes) {
+    size_t length = readInt(lengthBytes);
+    size_t start = m_position;
+    if(!m_valid || !skip(length)) {
+      Reader result(nullptr, 0);
+      result.m_valid = false;
+      return result;
+    }
+    return Reader(m_data + start, length);
+  }
+
+  void readList(std::vector<v_uint16>& list) {
+    auto vector = readVector(2);
+    while(vector.hasMore()) {
+      list.push_back((v_uint16) vector.readInt(2));
+    }
+    m_valid = m_valid && vector.isValid();
+  }
+
+  bool hasMore() const {
+    return m_position < m_size;
+  }
+
+  bool isValid() const {
+    return m_valid;
+  }
+
+};
+
+/*
+ * TLS group and TLS 1.3 signature scheme of the ECDSA certificate curve.
+ */
+bool getCurveCodes(const mbedtls_pk_context* key, v_uint16& group, v_uint16& signatureScheme) {
+#if defined(MBEDTLS_PK_HAVE_ECC_KEYS)
+  switch(mbedtls_pk_get_ec_group_id(key)) {
+    case MBEDTLS_ECP_DP_SECP256R1: group = 23; signatureScheme = MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256; return true;
+    case MBEDTLS_ECP_DP_SECP384R1: group = 24; signatureScheme = MBEDTLS_TLS1_3_SIG_ECDSA_SECP384R1_SHA384; return true;
+    case MBEDTLS_ECP_DP_SECP521R1: group = 25; signatureScheme = MBEDTLS_TLS1_3_SIG_ECDSA_SECP521R1_SHA512; return true;
+    default: return false;
+  }
+#else
+  (void) key; (void) group; (void) signatureScheme;
+  return false;
+#endif
+}
+
+bool contains(const std::vector<v_uint16>& list, v_uint16 value) {
+  return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+bool acceptsECDSA(const CertificateStore::ClientHello& hello, mbedtls_ssl_protocol_version version, const mbedtls_pk_context* key) {
+
+  v_uint16 group;
+  v_uint16 signatureScheme;
+  if(!getCurveCodes(key, group, signatureScheme)) {
+    return false;
+  }
+
+  /* TLS 1.3 signature scheme binds the curve */
+  if(version == MBEDTLS_SSL_VERSION_TLS1_3) {
+    return contains(hello.signatureAlgorithms, signatureScheme);
+  }
+
+  /* TLS 1.2 - ECDSA with SHA-256 or stronger, the curve of the certificate, and an ECDHE_ECDSA cipher suite */
+  bool signature = false;
+  for(auto algorithm : hello.signatureAlgorithms) {
+    v_uint16 hash = algorithm >> 8;
+    if((algorithm & 0xFF) == MBEDTLS_SSL_SIG_ECDSA && hash >= MBEDTLS_SSL_HASH_SHA256 && hash <= MBEDTLS_SSL_HASH_SHA512) {
+      signature = true;
+      break;
+    }
+  }
+
+  if(!signature || (!hello.groups.empty() && !contains(hello.groups, group))) {
+    return false;
+  }
+
+  for(auto id : hello.cipherSuites) {
+    auto info = mbedtls_ssl_ciphersuite_from_id(id);
+    if(info != nullptr && std::strstr(mbedtls_ssl_ciphersuite_get_name(info), "-ECDSA-") != nullptr) {
+      return true;
+    }
+  }
+
+  return false;
+
+}
+
+}
+
+CertificateStore::Certificate::Certificate(PrivateKey::RandomFunction random, void* randomContext)
+  : key(random, randomContext)
+  , ecdsa(false)
+{
+  mbedtls_x509_crt_init(&chain);
+}
+
+CertificateStore::Certificate::~Certificate() {
+  mbedtls_x509_crt_free(&chain);
+}
+
+CertificateStore::CertificateStore()
+  : m_defaultBinding(new Binding())
+  , m_keyAlternatives(false)
+  , m_exactMatches(0)
+  , m_wildcardMatches(0)
+  , m_defaultFallbacks(0)
+  , m_ecdsaHandshakes(0)
+  , m_rsaHandshakes(0)
+{
+
+  m_defaultBinding->handshakes = 0;
+
+  mbedtls_entropy_init(&m_entropy);
+  mbedtls_ctr_drbg_init(&m_ctr_drbg);
+
+  auto res = mbedtls_ctr_drbg_seed(&m_ctr_drbg, mbedtls_entropy_func, &m_entropy, nullptr, 0);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::server::CertificateStore::CertificateStore()]", "Error. Call to mbedtls_ctr_drbg_seed() failed. Return value=%d", res);
+    throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::CertificateStore()]: Error. Call to mbedtls_ctr_drbg_seed() failed.");
+  }
+
+}
+
+CertificateStore::~CertificateStore() {
+  m_exactNames.clear();
+  m_wildcardNames.clear();
+  m_defaultBinding.reset();
+  m_certificates.clear();
+  mbedtls_ctr_drbg_free(&m_ctr_drbg);
+  mbedtls_entropy_free(&m_entropy);
+}
+
+std::shared_ptr<CertificateStore> CertificateStore::createShared() {
+  return std::make_shared<CertificateStore>();
+}
+
+int CertificateStore::random(void* ctx, unsigned char* output, size_t length) {
+  auto store = static_cast<CertificateStore*>(ctx);
+  std::lock_guard<std::mutex> lock(store->m_randomLock);
+  return mbedtls_ctr_drbg_random(&store->m_ctr_drbg, output, length);
+}
+
+bool CertificateStore::parseClientHello(const std::string& records, ClientHello& hello) {
+
+  /* Handshake message may be fragmented over several records */
+  std::string message;
+  size_t position = 0;
+
+  while(position + 5 <= records.size()) {
+
+    auto header = (const v_uint8*) records.data() + position;
+    size_t length = ((size_t) header[3] << 8) | header[4];
+    if(position + 5 + length > records.size()) {
+      break;
+    }
+
+    if(header[0] == MBEDTLS_SSL_MSG_HANDSHAKE) {
+      message.append(records.data() + position + 5, length);
+    }
+    position += 5 + length;
+
+  }
+
+  Reader reader((const v_uint8*) message.data(), message.size());
+  if(reader.readInt(1) != MBEDTLS_SSL_HS_CLIENT_HELLO) {
+    return false;
+  }
+
+  Reader body = reader.readVector(3);
+  body.skip(2 + 32);   // legacy_version, random
+  body.readVector(1);  // legacy_session_id
+
+  auto suites = body.readVector(2);
+  while(suites.hasMore()) {
+    hello.cipherSuites.push_back((v_uint16) suites.readInt(2));
+  }
+
+  body.readVector(1);  // legacy_compression_methods
+
+  auto extensions = body.readVector(2);
+  while(extensions.hasMore()) {
+    auto type = extensions.readInt(2);
+    auto data = extensions.readVector(2);
+    if(type == MBEDTLS_TLS_EXT_SIG_ALG) {
+      data.readList(hello.signatureAlgorithms);
+    } else if(type == MBEDTLS_TLS_EXT_SUPPORTED_GROUPS) {
+      data.readList(hello.groups);
+    }
+    if(!data.isValid()) {
+      return false;
+    }
+  }
+
+  return body.isValid() && suites.isValid() && extensions.isValid();
+
+}
+
+int CertificateStore::certificateCallback(mbedtls_ssl_context* ssl) {
+
+  /* mbedtls_ssl_conf_get_user_data_p() takes non-const config, the store pointer is only read */
+  auto config = const_cast<mbedtls_ssl_config*>(mbedtls_ssl_context_get_config(ssl));
+  auto store = static_cast<CertificateStore*>(mbedtls_ssl_conf_get_user_data_p(config));
+
+  /* ClientHello after a HelloRetryRequest - serve the certificate selected for the first one */
+  auto connection = static_cast<Connection*>(mbedtls_ssl_get_user_data_p(ssl));
+  if(connection != nullptr && connection->getSelectedCertificate() != nullptr) {
+    auto certificate = connection->getSelectedCertificate();
+    auto key = store->findPrivateKey(certificate);
+    if(key != nullptr) {
+      return mbedtls_ssl_set_hs_own_cert(ssl, certificate, key->getHandshakeKey());
+    }
+  }
+
+  Binding* binding = nullptr;
+
+  size_t nameLength = 0;
+  auto name = mbedtls_ssl_get_hs_sni(ssl, &nameLength);
+  if(name != nullptr && nameLength > 0) {
+    binding = store->find(normalizeName((const char*) name, nameLength));
+    if(binding == nullptr) {
+      ++ store->m_defaultFallbacks;
+    } else {
+      ++ binding->handshakes;
+    }
+  }
+
+  if(binding == nullptr) {
+    binding = store->m_defaultBinding.get();
+  }
+
+  return store->select(ssl, binding);
+
+}
+
+std::string CertificateStore::normalizeName(const char* name, size_t length) {
+
+  /* DNS names are case-insensitive, trailing dot denotes the same name */
+  if(length > 0 && name[length - 1] == '.') {
+    length --;
+  }
+
+  std::string result(name, length);
+  for(auto& c : result) {
+    c = (char) std::tolower((unsigned char) c);
+  }
+  return result;
+
+}
+
+std::vector<std::string> CertificateStore::getCertificateNames(const mbedtls_x509_crt* crt) {
+
+  std::vector<std::string> result;
+
+  for(auto san = &crt->subject_alt_names; san != nullptr && san->buf.p != nullptr; san = san->next) {
+    if(san->buf.tag == (MBEDTLS_ASN1_CONTEXT_SPECIFIC | MBEDTLS_X509_SAN_DNS_NAME)) {
+      result.push_back(std::string((const char*) san->buf.p, san->buf.len));
+    }
+  }
+
+  if(!result.empty()) {
+    return result;
+  }
+
+  for(auto dn = &crt->subject; dn != nullptr; dn = dn->next) {
+    if(dn->oid.p != nullptr && MBEDTLS_OID_CMP(MBEDTLS_OID_AT_CN, &dn->oid) == 0) {
+      result.push_back(std::string((const char*) dn->val.p, dn->val.len));
+    }
+  }
+
+  return result;
+
+}
+
+void CertificateStore::bind(const std::string& name, const std::shared_ptr<Certificate>& certificate) {
+
+  auto normalized = normalizeName(name.data(), name.size());
+
+  Index* index = &m_exactNames;
+  if(normalized.size() > 2 && normalized[0] == '*' && normalized[1] == '.') {
+    index = &m_wildcardNames;
+    normalized = normalized.substr(2);
+  }
+
+  auto& binding = (*index)[normalized];
+  if(!binding) {
+    binding.reset(new Binding());
+    binding->handshakes = 0;
+  }
+  attach(binding.get(), certificate);
+
+}
+
+void CertificateStore::attach(Binding* binding, const std::shared_ptr<Certificate>& certificate) {
+
+  auto& certificates = binding->certificates;
+
+  for(auto& c : certificates) {
+    if(c->ecdsa == certificate->ecdsa) {
+      c = certificate;
+      return;
+    }
+  }
+
+  if(certificate->ecdsa) {
+    certificates.insert(certificates.begin(), certificate);
+  } else {
+    certificates.push_back(certificate);
+  }
+
+  if(certificates.size() > 1) {
+    m_keyAlternatives = true;
+  }
+
+}
+
+CertificateStore::Binding* CertificateStore::find(const std::string& name) {
+
+  auto it = m_exactNames.find(name);
+  if(it != m_exactNames.end()) {
+    ++ m_exactMatches;
+    return it->second.get();
+  }
+
+  /* Wildcard covers exactly one leftmost label */
+  auto dot = name.find('.');
+  if(dot != std::string::npos && dot > 0 && dot + 1 < name.size()) {
+    it = m_wildcardNames.find(name.substr(dot + 1));
+    if(it != m_wildcardNames.end()) {
+      ++ m_wildcardMatches;
+      return it->second.get();
+    }
+  }
+
+  return nullptr;
+
+}
+
+int CertificateStore::select(mbedtls_ssl_context* ssl, Binding* binding) {
+
+  auto& certificates = binding->certificates;
+  auto connection = static_cast<Connection*>(mbedtls_ssl_get_user_data_p(ssl));
+  auto version = mbedtls_ssl_get_version_number(ssl);
+  std::shared_ptr<Certificate> selected;
+
+  if(certificates.size() == 1) {
+    selected = certificates.front();
+  } else {
+    ClientHello hello;
+    if(connection != nullptr && parseClientHello(connection->getClientHello(), hello)) {
+      auto& ecdsa = certificates.front();
+      selected = acceptsECDSA(hello, version, ecdsa->key.getKey()) ? ecdsa : certificates.back();
+    } else if(version == MBEDTLS_SSL_VERSION_TLS1_3) {
+      /* ClientHello wasn't captured - RSA-PSS signatures are mandatory to implement in TLS 1.3 (RFC 8446, 9.1) */
+      selected = certificates.back();
+    }
+  }
+
+  if(!selected) {
+    /* ClientHello wasn't captured - offer all, Mbed TLS takes the first one matching the client */
+    if(connection != nullptr) {
+      connection->onCertificateSelected(nullptr);
+    }
+    for(auto& c : certificates) {
+      auto res = mbedtls_ssl_set_hs_own_cert(ssl, &c->chain, c->key.getHandshakeKey());
+      if(res != 0) {
+        return res;
+      }
+    }
+    return 0;
+  }
+
+  if(connection != nullptr) {
+    connection->onCertificateSelected(&selected->chain);
+  }
+
+  return mbedtls_ssl_set_hs_own_cert(ssl, &selected->chain, selected->key.getHandshakeKey());
+
+}
+
+void CertificateStore::addCertificate(const char* certFile, const char* keyFile, const char* keyPassword) {
+  addCertificate(certFile, keyFile, keyPassword, {});
+}
+
+void CertificateStore::addCertificate(const char* certFile, const char* keyFile, const char* keyPassword, const std::vector<std::string>& names) {
+
+  auto certificate = std::make_shared<Certificate>(&CertificateStore::random, this);
+
+  auto res = mbedtls_x509_crt_parse_file(&certificate->chain, certFile);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::server::CertificateStore::addCertificate()]", "Error. Can't parse certFile path='%s', return value=%d", certFile, res);
+    throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::addCertificate()]: Error. Can't parse certFile");
+  }
+
+  res = certificate->key.parseFile(keyFile, keyPassword);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::server::CertificateStore::addCertificate()]", "Error. Can't parse keyFile path='%s', return value=%d", keyFile, res);
+    throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::addCertificate()]: Error. Can't parse keyFile");
+  }
+
+  auto keyType = mbedtls_pk_get_type(certificate->key.getKey());
+  certificate->ecdsa = (keyType == MBEDTLS_PK_ECKEY || keyType == MBEDTLS_PK_ECDSA);
+
+  auto certificateNames = names.empty() ? getCertificateNames(&certificate->chain) : names;
+  if(certificateNames.empty()) {
+    throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::addCertificate()]: Error. Certificate has no names.");
+  }
+
+  for(auto& name : certificateNames) {
+    bind(name, certificate);
+  }
+
+  /* The first certificate of each key type is the default one */
+  bool hasDefault = false;
+  for(auto& c : m_defaultBinding->certificates) {
+    hasDefault = hasDefault || c->ecdsa == certificate->ecdsa;
+  }
+  if(!hasDefault) {
+    attach(m_defaultBinding.get(), certificate);
+  }
+
+  m_keys[&certificate->chain] = &certificate->key;
+  m_certificates.push_back(certificate);
+
+}
+
+bool CertificateStore::hasCertificates() const {
+  return !m_certificates.empty();
+}
+
+bool CertificateStore::hasKeyAlternatives() const {
+  return m_keyAlternatives;
+}
+
+PrivateKey* CertificateStore::findPrivateKey(const mbedtls_x509_crt* certificate) {
+  auto it = m_keys.find(certificate);
+  if(it != m_keys.end()) {
+    return it->second;
+  }
+  return nullptr;
+}
+
+void CertificateStore::configure(mbedtls_ssl_config* config) {
+
+  if(m_certificates.empty()) {
+    throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::configure()]: Error. Store is empty.");
+  }
+
+  for(auto& defaultCertificate : m_defaultBinding->certificates) {
+    auto res = mbedtls_ssl_conf_own_cert(config, &defaultCertificate->chain, defaultCertificate->key.getHandshakeKey());
+    if(res != 0) {
+      OATPP_LOGD("[oatpp::mbedtls::server::CertificateStore::configure()]", "Error. Call to mbedtls_ssl_conf_own_cert() failed. Return value=%d", res);
+      throw std::runtime_error("[oatpp::mbedtls::server::CertificateStore::configure()]: Error. Call to mbedtls_ssl_conf_own_cert() failed.");
+    }
+  }
+
+  /* Without SNI callback Mbed TLS keeps the requested name for the certificate callback */
+  mbedtls_ssl_conf_sni(config, nullptr, nullptr);
+  mbedtls_ssl_conf_set_user_data_p(config, this);
+  mbedtls_ssl_conf_cert_cb(config, &CertificateStore::certificateCallback);
+
+}
+
+void CertificateStore::onHandshakeDone(mbedtls_ssl_context* ssl, const mbedtls_x509_crt* certificate) {
+
+  if(certificate != nullptr) {
+    if(mbedtls_pk_can_do(&certificate->pk, MBEDTLS_PK_ECDSA)) {
+      ++ m_ecdsaHandshakes;
+    } else {
+      ++ m_rsaHandshakes;
+    }
+    return;
+  }
+
+  /* Several certificates were offered - TLS 1.2 cipher suite names the key type of the one Mbed TLS has picked */
+  if(mbedtls_ssl_get_version_number(ssl) != MBEDTLS_SSL_VERSION_TLS1_2) {
+    return;
+  }
+
+  auto cipherSuite = mbedtls_ssl_get_ciphersuite(ssl);
+  if(cipherSuite == nullptr) {
+    return;
+  }
+
+  if(std::strstr(cipherSuite, "-ECDSA-") != nullptr) {
+    ++ m_ecdsaHandshakes;
+  } else if(std::strstr(cipherSuite, "-RSA-") != nullptr) {
+    ++ m_rsaHandshakes;
+  }
+
+}
+
+CertificateStore::Statistics CertificateStore::getStatistics() {
+  Statistics stats;
+  stats.exactMatches = m_exactMatches;
+  stats.wildcardMatches = m_wildcardMatches;
+  stats.defaultFallbacks = m_defaultFallbacks;
+  stats.ecdsaHandshakes = m_ecdsaHandshakes;
+  stats.rsaHandshakes = m_rsaHandshakes;
+  return stats;
+}
+
+std::vector<CertificateStore::NameStatistics> CertificateStore::getNameStatistics() {
+
+  std::vector<NameStatistics> result;
+  result.reserve(m_exactNames.size() + m_wildcardNames.size());
+
+  for(auto& pair : m_exactNames) {
+    result.push_back({pair.first, pair.second->handshakes});
+  }
+
+  for(auto& pair : m_wildcardNames) {
+    result.push_back({"*." + pair.first, pair.second->handshakes});
+  }
+
+  return result;
+
+}
+
+}}}
@@ -0,0 +1,279 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+
+#ifndef oatpp_mbedtls_server_CertificateStore_hpp
+#define oatpp_mbedtls_server_CertificateStore_hpp
+
+#include "oatpp-mbedtls/PrivateKey.hpp"
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+/**
+ * Server certificates selected by the name the client requested in the ClientHello (SNI).<br>
+ * Names are looked up in hash indexes - exact names first, then wildcard names (`*.example.com` matches one label),
+ * so lookup cost doesn't depend on the number of certificates.
+ * Clients requesting no name or an unknown name get the default certificate - the first one added.<br>
+ * A name may have an ECDSA and an RSA certificate. ECDSA is served whenever the client's signature algorithms
+ * (and, for TLS 1.2, cipher suites and curves) allow it - ECDSA signatures are much cheaper than RSA ones.
+ * RSA is served to other clients. The choice is made from the ClientHello captured by &id:oatpp::mbedtls::Connection;.
+ * If it wasn't captured, TLS 1.2 clients are offered both certificates, and TLS 1.3 clients get RSA -
+ * RSA-PSS signatures are mandatory to implement in TLS 1.3.<br>
+ * *Store is not synchronized for modification - add certificates before it's passed to
+ * &id:oatpp::mbedtls::Config::setCertificateStore;. Lookups and statistics are thread-safe.*
+ */
+class CertificateStore {
+public:
+
+  /**
+   * Certificate selection statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Handshakes matched by exact name.
+     */
+    v_int64 exactMatches;
+
+    /**
+     * Handshakes matched by wildcard name.
+     */
+    v_int64 wildcardMatches;
+
+    /**
+     * Handshakes which requested an unknown name and got the default certificate.
+     */
+    v_int64 defaultFallbacks;
+
+    /**
+     * Handshakes served with ECDSA certificate. Counted once the handshake is done.
+     */
+    v_int64 ecdsaHandshakes;
+
+    /**
+     * Handshakes served with RSA certificate. Counted once the handshake is done.
+     */
+    v_int64 rsaHandshakes;
+
+  };
+
+  /**
+   * Number of handshakes per certificate name.
+   */
+  struct NameStatistics {
+
+    /**
+     * Name as registered in the store. Ex.: `example.com`, `*.example.com`.
+     */
+    std::string name;
+
+    /**
+     * Number of handshakes which selected certificate by this name.
+     */
+    v_int64 handshakes;
+
+  };
+
+  /**
+   * Fields of the ClientHello which decide between ECDSA and RSA certificates.
+   * Mbed TLS doesn't expose them to the certificate callback.
+   */
+  struct ClientHello {
+
+    /**
+     * Cipher suites offered by the client.
+     */
+    std::vector<v_uint16> cipherSuites;
+
+    /**
+     * Content of the `signature_algorithms` extension.
+     */
+    std::vector<v_uint16> signatureAlgorithms;
+
+    /**
+     * Content of the `supported_groups` extension.
+     */
+    std::vector<v_uint16> groups;
+
+  };
+
+private:
+
+  struct Certificate {
+
+    mbedtls_x509_crt chain;
+    PrivateKey key;
+    bool ecdsa;
+
+    Certificate(PrivateKey::RandomFunction random, void* randomContext);
+    ~Certificate();
+
+  };
+
+  struct Binding {
+    std::vector<std::shared_ptr<Certificate>> certificates; // one per key type, ECDSA first
+    std::atomic<v_int64> handshakes;
+  };
+
+  typedef std::unordered_map<std::string, std::unique_ptr<Binding>> Index;
+
+private:
+  static int random(void* ctx, unsigned char* output, size_t length);
+  static int certificateCallback(mbedtls_ssl_context* ssl);
+  static std::string normalizeName(const char* name, size_t length);
+  static std::vector<std::string> getCertificateNames(const mbedtls_x509_crt* crt);
+private:
+  void bind(const std::string& name, const std::shared_ptr<Certificate>& certificate);
+  void attach(Binding* binding, const std::shared_ptr<Certificate>& certificate);
+  Binding* find(const std::string& name);
+  int select(mbedtls_ssl_context* ssl, Binding* binding);
+private:
+  mbedtls_entropy_context m_entropy;
+  mbedtls_ctr_drbg_context m_ctr_drbg;
+  std::mutex m_randomLock;
+private:
+  std::vector<std::shared_ptr<Certificate>> m_certificates;
+  std::unordered_map<const mbedtls_x509_crt*, PrivateKey*> m_keys;
+  Index m_exactNames;
+  Index m_wildcardNames; // "*.example.com" is stored as "example.com"
+  std::unique_ptr<Binding> m_defaultBinding;
+  bool m_keyAlternatives;
+private:
+  std::atomic<v_int64> m_exactMatches;
+  std::atomic<v_int64> m_wildcardMatches;
+  std::atomic<v_int64> m_defaultFallbacks;
+  std::atomic<v_int64> m_ecdsaHandshakes;
+  std::atomic<v_int64> m_rsaHandshakes;
+public:
+
+  /**
+   * Constructor.
+   */
+  CertificateStore();
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~CertificateStore();
+
+  /**
+   * Create shared CertificateStore.
+   * @return - `std::shared_ptr` to CertificateStore.
+   */
+  static std::shared_ptr<CertificateStore> createShared();
+
+  /**
+   * Add certificate. Certificate is served for DNS names of its subjectAltName extension,
+   * or for its subject CN if there are no DNS names.
+   * Certificate with a different key type (ECDSA or RSA) for the same name is kept as an alternative,
+   * certificate with the same key type replaces the previous one.
+   * @param certFile - path to the certificate chain file.
+   * @param keyFile - path to the private key file.
+   * @param keyPassword - optional private key password.
+   */
+  void addCertificate(const char* certFile, const char* keyFile, const char* keyPassword = nullptr);
+
+  /**
+   * Add certificate served for the given names.
+   * @param certFile - path to the certificate chain file.
+   * @param keyFile - path to the private key file.
+   * @param keyPassword - private key password. `nullptr` if key is not encrypted.
+   * @param names - names to serve the certificate for. Ex.: `example.com`, `*.example.com`.
+   */
+  void addCertificate(const char* certFile, const char* keyFile, const char* keyPassword, const std::vector<std::string>& names);
+
+  /**
+   * Parse ClientHello from raw TLS records - as captured by &id:oatpp::mbedtls::Connection;.
+   * Handshake message may be fragmented over several records.
+   * @param records - raw TLS records.
+   * @param hello - &l:CertificateStore::ClientHello; to fill.
+   * @return - `true` if the ClientHello is complete and well-formed.
+   */
+  static bool parseClientHello(const std::string& records, ClientHello& hello);
+
+  /**
+   * Check if store has at least one certificate.
+   * @return - `true` if store is not empty.
+   */
+  bool hasCertificates() const;
+
+  /**
+   * Check if some name has both ECDSA and RSA certificates.
+   * @return - `true` if certificate is selected by key type for some names.
+   */
+  bool hasKeyAlternatives() const;
+
+  /**
+   * Find private key of the certificate selected for handshake.
+   * @param certificate - `mbedtls_x509_crt*` from this store.
+   * @return - &id:oatpp::mbedtls::PrivateKey; or `nullptr` if certificate is not from this store.
+   */
+  PrivateKey* findPrivateKey(const mbedtls_x509_crt* certificate);
+
+  /**
+   * Set default certificates and register certificate selection callback in `mbedtls_ssl_config`.
+   * @param config - `mbedtls_ssl_config*`.
+   */
+  void configure(mbedtls_ssl_config* config);
+
+  /**
+   * Count key type of the certificate a finished handshake was served with.
+   * Called by &id:oatpp::mbedtls::Connection; after the handshake.
+   * @param ssl - `mbedtls_ssl_context*`.
+   * @param certificate - certificate selected for the handshake. `nullptr` if several certificates were offered to Mbed TLS -
+   * then the key type is told by the negotiated cipher suite.
+   */
+  void onHandshakeDone(mbedtls_ssl_context* ssl, const mbedtls_x509_crt* certificate);
+
+  /**
+   * Get certificate selection statistics.
+   * @return - &l:CertificateStore::Statistics;.
+   */
+  Statistics getStatistics();
+
+  /**
+   * Get number of handshakes per certificate name.
+   * @return - `std::vector` of &l:CertificateStore::NameStatistics;.
+   */
+  std::vector<NameStatistics> getNameStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_server_CertificateStore_hpp
@@ -0,0 +1,257 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+
+#include "CertificateWatcher.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+CertificateWatcher::CertificateWatcher(const std::shared_ptr<ConnectionProvider>& provider,
+                                       const std::vector<std::string>& files,
+                                       const ConfigFactory& factory,
+                                       v_int64 pollIntervalMilliseconds)
+  : m_provider(provider)
+  , m_files(files)
+  , m_factory(factory)
+  , m_pollIntervalMilliseconds(pollIntervalMilliseconds < 1 ? 1 : pollIntervalMilliseconds)
+  , m_reloads(0)
+  , m_failures(0)
+  , m_notifyHandle(-1)
+  , m_stopped(false)
+{
+
+  m_wakeHandles[0] = -1;
+  m_wakeHandles[1] = -1;
+
+  /* Current config is built from the current files */
+  m_signature = readSignature();
+
+#if defined(__linux__)
+
+  m_notifyHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(m_notifyHandle < 0) {
+    OATPP_LOGW("[oatpp::mbedtls::server::CertificateWatcher::CertificateWatcher()]", "Warning. Call to inotify_init1() failed. Files are polled only.");
+  } else {
+    /* Watch directories - files are often replaced by rename or by symlink swap rather than rewritten */
+    for(auto& file : m_files) {
+      auto slash = file.find_last_of('/');
+      std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : file.substr(0, slash));
+      if(inotify_add_watch(m_notifyHandle, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+        OATPP_LOGW("[oatpp::mbedtls::server::CertificateWatcher::CertificateWatcher()]", "Warning. Can't watch directory '%s'.", directory.c_str());
+      }
+    }
+  }
+
+  if(pipe(m_wakeHandles) != 0) {
+    m_wakeHandles[0] = -1;
+    m_wakeHandles[1] = -1;
+  }
+
+#endif
+
+  m_thread = std::thread(&CertificateWatcher::run, this);
+
+}
+
+CertificateWatcher::~CertificateWatcher() {
+  stop();
+#if defined(__linux__)
+  if(m_notifyHandle >= 0) {
+    close(m_notifyHandle);
+  }
+  if(m_wakeHandles[0] >= 0) {
+    close(m_wakeHandles[0]);
+    close(m_wakeHandles[1]);
+  }
+#endif
+}
+
+std::shared_ptr<CertificateWatcher> CertificateWatcher::createShared(const std::shared_ptr<ConnectionProvider>& provider,
+                                                                     const std::vector<std::string>& files,
+                                                                     const ConfigFactory& factory,
+                                                                     v_int64 pollIntervalMilliseconds)
+{
+  return std::make_shared<CertificateWatcher>(provider, files, factory, pollIntervalMilliseconds);
+}
+
+std::string CertificateWatcher::readSignature() {
+
+  std::string result;
+
+  for(auto& file : m_files) {
+
+    struct stat info;
+    if(stat(file.c_str(), &info) != 0) {
+      result += file + ":missing;";
+      continue;
+    }
+
+    v_int64 modified = (v_int64) info.st_mtime * 1000000000;
+#if defined(__linux__)
+    modified += (v_int64) info.st_mtim.tv_nsec;
+#endif
+
+    result += file + ":" + std::to_string(modified) + ":" + std::to_string((v_int64) info.st_size) + ":" + std::to_string((v_int64) info.st_ino) + ";";
+
+  }
+
+  return result;
+
+}
+
+bool CertificateWatcher::waitForChange(v_int64 timeoutMilliseconds) {
+
+#if defined(__linux__)
+
+  if(m_notifyHandle >= 0 && m_wakeHandles[0] >= 0) {
+
+    struct pollfd handles[2];
+    handles[0].fd = m_notifyHandle;
+    handles[0].events = POLLIN;
+    handles[1].fd = m_wakeHandles[0];
+    handles[1].events = POLLIN;
+
+    auto res = poll(handles, 2, (int) timeoutMilliseconds);
+    if(res <= 0 || (handles[1].revents & POLLIN) != 0) {
+      return false;
+    }
+
+    /* Drain events and wait until writers are done with the files */
+    char buffer[4096];
+    do {
+      while(read(m_notifyHandle, buffer, sizeof(buffer)) > 0) {}
+      res = poll(handles, 2, (int) DEBOUNCE_MILLISECONDS);
+    } while(res > 0 && (handles[1].revents & POLLIN) == 0);
+
+    return true;
+
+  }
+
+#endif
+
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this] { return m_stopped; });
+  return false;
+
+}
+
+void CertificateWatcher::run() {
+
+  while(true) {
+
+    waitForChange(m_pollIntervalMilliseconds);
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if(m_stopped) {
+        break;
+      }
+    }
+
+    check();
+
+  }
+
+}
+
+bool CertificateWatcher::check() {
+
+  std::lock_guard<std::mutex> lock(m_checkLock);
+
+  auto signature = readSignature();
+  if(signature == m_signature || signature == m_failedSignature) {
+    return false;
+  }
+
+  try {
+
+    auto config = m_factory();
+    if(!config) {
+      throw std::runtime_error("Config factory returned null.");
+    }
+
+    m_provider->setConfig(config);
+    m_signature = signature;
+    m_failedSignature.clear();
+    ++ m_reloads;
+
+    OATPP_LOGI("[oatpp::mbedtls::server::CertificateWatcher::check()]", "Config reloaded.");
+    return true;
+
+  } catch (std::exception& e) {
+    /* Same files would fail the same way - wait for the next change */
+    m_failedSignature = signature;
+    ++ m_failures;
+    OATPP_LOGE("[oatpp::mbedtls::server::CertificateWatcher::check()]", "Error. Can't reload config: %s", e.what());
+  }
+
+  return false;
+
+}
+
+void CertificateWatcher::stop() {
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(m_stopped) {
+      return;
+    }
+    m_stopped = true;
+  }
+
+  m_condition.notify_all();
+
+#if defined(__linux__)
+  if(m_wakeHandles[1] >= 0) {
+    char b = 0;
+    if(write(m_wakeHandles[1], &b, 1) < 0) {
+      OATPP_LOGW("[oatpp::mbedtls::server::CertificateWatcher::stop()]", "Warning. Can't wake watcher thread.");
+    }
+  }
+#endif
+
+  if(m_thread.joinable()) {
+    m_thread.join();
+  }
+
+}
+
+CertificateWatcher::Statistics CertificateWatcher::getStatistics() {
+  Statistics stats;
+  stats.reloads = m_reloads;
+  stats.failures = m_failures;
+  return stats;
+}
+
+}}}
@@ -0,0 +1,153 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+
+#ifndef oatpp_mbedtls_server_CertificateWatcher_hpp
+#define oatpp_mbedtls_server_CertificateWatcher_hpp
+
+#include "oatpp-mbedtls/server/ConnectionProvider.hpp"
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+/**
+ * Reload server config when certificate or key files change.<br>
+ * Watcher thread waits for file system events in the directories of the files (inotify, Linux)
+ * and also polls the files - for other platforms and for file systems without notifications.
+ * Once the files change (modification time, size or inode - symlink swaps are followed), the config factory is called and
+ * its config is set with &id:oatpp::mbedtls::server::ConnectionProvider::setConfig;.
+ * If the factory throws (ex.: certificate is already replaced but key is not yet), the old config is kept
+ * and reload is retried once the files change again.
+ */
+class CertificateWatcher {
+public:
+
+  /**
+   * Builds a new config from the watched files.
+   */
+  typedef std::function<std::shared_ptr<Config>()> ConfigFactory;
+
+  /**
+   * Watcher statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of successful reloads.
+     */
+    v_int64 reloads;
+
+    /**
+     * Number of failed reload attempts.
+     */
+    v_int64 failures;
+
+  };
+
+private:
+  static constexpr v_int64 DEBOUNCE_MILLISECONDS = 200;
+private:
+  std::string readSignature();
+  bool waitForChange(v_int64 timeoutMilliseconds);
+  void run();
+private:
+  std::shared_ptr<ConnectionProvider> m_provider;
+  std::vector<std::string> m_files;
+  ConfigFactory m_factory;
+  v_int64 m_pollIntervalMilliseconds;
+private:
+  std::mutex m_checkLock;
+  std::string m_signature;
+  std::string m_failedSignature;
+  std::atomic<v_int64> m_reloads;
+  std::atomic<v_int64> m_failures;
+private:
+  int m_notifyHandle;
+  int m_wakeHandles[2];
+  std::mutex m_lock;
+  std::condition_variable m_condition;
+  bool m_stopped;
+  std::thread m_thread;
+public:
+
+  /**
+   * Constructor. Starts watcher thread.
+   * @param provider - &id:oatpp::mbedtls::server::ConnectionProvider; to set new configs to.
+   * @param files - files to watch. Ex.: certificate and key files.
+   * @param factory - builds new config from the files.
+   * @param pollIntervalMilliseconds - how often files are checked without file system events.
+   */
+  CertificateWatcher(const std::shared_ptr<ConnectionProvider>& provider,
+                     const std::vector<std::string>& files,
+                     const ConfigFactory& factory,
+                     v_int64 pollIntervalMilliseconds);
+
+  /**
+   * Non-virtual destructor. Stops watcher thread.
+   */
+  ~CertificateWatcher();
+
+  /**
+   * Create shared CertificateWatcher.
+   * @param provider - &id:oatpp::mbedtls::server::ConnectionProvider; to set new configs to.
+   * @param files - files to watch. Ex.: certificate and key files.
+   * @param factory - builds new config from the files.
+   * @param pollIntervalMilliseconds - how often files are checked without file system events. Default `5000`.
+   * @return - `std::shared_ptr` to CertificateWatcher.
+   */
+  static std::shared_ptr<CertificateWatcher> createShared(const std::shared_ptr<ConnectionProvider>& provider,
+                                                          const std::vector<std::string>& files,
+                                                          const ConfigFactory& factory,
+                                                          v_int64 pollIntervalMilliseconds = 5000);
+
+  /**
+   * Reload config now if files have changed since the last reload.
+   * Files which the factory has already failed to load are not tried again until they change.
+   * @return - `true` if config was reloaded.
+   */
+  bool check();
+
+  /**
+   * Stop watcher thread.
+   */
+  void stop();
+
+  /**
+   * Get watcher statistics.
+   * @return - &l:CertificateWatcher::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_server_CertificateWatcher_hpp
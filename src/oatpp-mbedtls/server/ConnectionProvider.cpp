@@ -29,6 +29,8 @@
 
 #include "mbedtls/error.h"
 
+#include <thread>
+
 namespace oatpp { namespace mbedtls { namespace server {
 
 void ConnectionProvider::ConnectionInvalidator::invalidate(const std::shared_ptr<data::stream::IOStream> &connection){
@@ -45,17 +47,63 @@ void ConnectionProvider::ConnectionInvalidator::invalidate(const std::shared_ptr
    * waiting for TLS events.
    ********************************************/
 
+  /* Gathered writes are not written here - that would run Mbed TLS. The owner flushes before releasing the connection */
+  auto dropped = c->getGatheredSize();
+  if(dropped > 0) {
+    OATPP_LOGE("[oatpp::mbedtls::server::ConnectionProvider::ConnectionInvalidator::invalidate()]",
+               "Error. %d bytes of gathered data are dropped. Call Connection::flush() before releasing the connection.", (v_int32) dropped);
+  }
+
   /* Invalidate underlying transport */
   auto s = c->getTransportStream();
   s.invalidator->invalidate(s.object);
 
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionProvider::ConfigSlot
+
+ConnectionProvider::ConfigSlot::ConfigSlot(const std::shared_ptr<Config>& config)
+  : m_current(new Holder{config})
+  , m_readers(0)
+{}
+
+ConnectionProvider::ConfigSlot::~ConfigSlot() {
+  delete m_current.load();
+}
+
+std::shared_ptr<Config> ConnectionProvider::ConfigSlot::get() {
+  ++ m_readers;
+  std::shared_ptr<Config> result = m_current.load()->config;
+  -- m_readers;
+  return result;
+}
+
+void ConnectionProvider::ConfigSlot::set(const std::shared_ptr<Config>& config) {
+
+  std::lock_guard<std::mutex> lock(m_writeLock);
+
+  auto replaced = m_current.exchange(new Holder{config});
+
+  /* Readers which could load the replaced holder are counted - wait them out. Read sections are a refcount increment long */
+  while(m_readers.load() != 0) {
+    std::this_thread::yield();
+  }
+
+  delete replaced;
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionProvider
+
 ConnectionProvider::ConnectionProvider(const std::shared_ptr<Config>& config,
                                        const std::shared_ptr<oatpp::network::ServerConnectionProvider>& streamProvider)
   : m_connectionInvalidator(std::make_shared<ConnectionInvalidator>())
-  , m_config(config)
+  , m_config(std::make_shared<ConfigSlot>(config))
   , m_streamProvider(streamProvider)
+  , m_eagerHandshake(false)
+  , m_stopped(false)
 {
 
   setProperty(PROPERTY_HOST, streamProvider->getProperty(PROPERTY_HOST).toString());
@@ -84,32 +132,192 @@ ConnectionProvider::~ConnectionProvider() {
 }
 
 void ConnectionProvider::stop() {
+
+  m_stopped = true;
   m_streamProvider->stop();
+
+  std::lock_guard<std::mutex> lock(m_acceptorLock);
+  if(m_handshakeWorkers) {
+    m_handshakeWorkers->stop();
+  }
+  if(m_acceptor.joinable()) {
+    m_acceptor.join();
+  }
+
+}
+
+void ConnectionProvider::setConfig(const std::shared_ptr<Config>& config) {
+  if(!config) {
+    throw std::runtime_error("[oatpp::mbedtls::server::ConnectionProvider::setConfig()]: Error. Config is null.");
+  }
+  if(m_eagerHandshake && config->getHandshakeTimeout() <= 0) {
+    throw std::runtime_error("[oatpp::mbedtls::server::ConnectionProvider::setConfig()]: Error. "
+                             "Eager handshake is enabled - config must have a handshake timeout.");
+  }
+  m_config->set(config);
+}
+
+std::shared_ptr<Config> ConnectionProvider::getConfig() {
+  return m_config->get();
+}
+
+void ConnectionProvider::enableHandshakeWorkers(v_int32 threadsCount, v_int32 maxQueueSize) {
+  std::lock_guard<std::mutex> lock(m_acceptorLock);
+  if(m_acceptor.joinable()) {
+    throw std::runtime_error("[oatpp::mbedtls::server::ConnectionProvider::enableHandshakeWorkers()]: Error. Provider is already accepting connections.");
+  }
+  m_handshakeWorkers = std::make_shared<HandshakeWorkerPool>(threadsCount, maxQueueSize);
+}
+
+std::shared_ptr<HandshakeWorkerPool> ConnectionProvider::getHandshakeWorkers() {
+  std::lock_guard<std::mutex> lock(m_acceptorLock);
+  return m_handshakeWorkers;
+}
+
+void ConnectionProvider::runAcceptor() {
+  while(!m_stopped) {
+    auto connection = accept();
+    if(connection && !m_handshakeWorkers->submit(connection)) {
+      connection.invalidator->invalidate(connection.object);
+      break;
+    }
+  }
 }
 
 provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::get() {
 
+  std::shared_ptr<HandshakeWorkerPool> handshakeWorkers;
+
+  {
+    std::lock_guard<std::mutex> lock(m_acceptorLock);
+    handshakeWorkers = m_handshakeWorkers;
+    if(handshakeWorkers && !m_acceptor.joinable() && !m_stopped) {
+      m_acceptor = std::thread(&ConnectionProvider::runAcceptor, this);
+    }
+  }
+
+  if(handshakeWorkers) {
+    return handshakeWorkers->take();
+  }
+
+  return accept();
+
+}
+
+provider::ResourceHandle<data::stream::IOStream> ConnectionProvider::accept() {
+
   auto stream = m_streamProvider->get();
 
   if (!stream) {
     return nullptr;
   }
 
-  auto *tlsHandle = new mbedtls_ssl_context();
-  mbedtls_ssl_init(tlsHandle);
+  auto config = m_config->get();
 
-  auto res = mbedtls_ssl_setup(tlsHandle, m_config->getTLSConfig());
-  if (res != 0) {
-    mbedtls_ssl_free(tlsHandle);
-    delete tlsHandle;
+  auto *tlsHandle = config->createTLSContext();
+  if (tlsHandle == nullptr) {
     return nullptr;
   }
 
   return provider::ResourceHandle<data::stream::IOStream>(
-    std::make_shared<Connection>(tlsHandle, stream, false),
+    std::make_shared<Connection>(tlsHandle, stream, false, config),
     m_connectionInvalidator
     );
 
 }
 
+oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> ConnectionProvider::getAsync() {
+
+  class AcceptCoroutine : public oatpp::async::CoroutineWithResult<AcceptCoroutine, const provider::ResourceHandle<data::stream::IOStream>&> {
+  private:
+    std::shared_ptr<ConnectionInvalidator> m_connectionInvalidator;
+    std::shared_ptr<ConfigSlot> m_configSlot;
+    std::shared_ptr<oatpp::network::ServerConnectionProvider> m_streamProvider;
+    bool m_eagerHandshake;
+  private:
+    std::shared_ptr<Config> m_config;
+    std::shared_ptr<Connection> m_connection;
+  public:
+
+    AcceptCoroutine(const std::shared_ptr<ConnectionInvalidator>& connectionInvalidator,
+                    const std::shared_ptr<ConfigSlot>& configSlot,
+                    const std::shared_ptr<network::ServerConnectionProvider>& streamProvider,
+                    bool eagerHandshake)
+      : m_connectionInvalidator(connectionInvalidator)
+      , m_configSlot(configSlot)
+      , m_streamProvider(streamProvider)
+      , m_eagerHandshake(eagerHandshake)
+    {}
+
+    Action act() override {
+      /* accept transport stream */
+      return m_streamProvider->getAsync().callbackTo(&AcceptCoroutine::onAccepted);
+    }
+
+    Action onAccepted(const provider::ResourceHandle<data::stream::IOStream>& stream) {
+
+      if(!stream) {
+        return _return(nullptr);
+      }
+
+      /* Config is taken when connection is accepted - accept may wait longer than a reload */
+      m_config = m_configSlot->get();
+
+      auto* tlsHandle = m_config->createTLSContext();
+      if(tlsHandle == nullptr) {
+        stream.invalidator->invalidate(stream.object);
+        return error<Error>("[oatpp::mbedtls::server::ConnectionProvider::getAsync()]: Error. Call to mbedtls_ssl_setup() failed.");
+      }
+
+      m_connection = std::make_shared<Connection>(tlsHandle, stream, false, m_config);
+
+      m_connection->setOutputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
+      m_connection->setInputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
+
+      if(m_eagerHandshake) {
+        return m_connection->initContextsAsync().next(yieldTo(&AcceptCoroutine::onSuccess));
+      }
+
+      return yieldTo(&AcceptCoroutine::onSuccess);
+
+    }
+
+    Action onSuccess() {
+      return _return(provider::ResourceHandle<data::stream::IOStream>(m_connection, m_connectionInvalidator));
+    }
+
+    Action handleError(Error* error) override {
+
+      if(!m_connection) {
+        return error;
+      }
+
+      /* Eager handshake failed - it's this client's problem only. Drop the connection and accept the next one */
+      OATPP_LOGD("[oatpp::mbedtls::server::ConnectionProvider::getAsync()]",
+                 "Handshake failed (%d). Connection dropped.", m_connection->getHandshakeResult());
+
+      auto transport = m_connection->getTransportStream();
+      transport.invalidator->invalidate(transport.object);
+      m_connection.reset();
+      m_config.reset();
+
+      return yieldTo(&AcceptCoroutine::act);
+
+    }
+
+  };
+
+  return AcceptCoroutine::startForResult(m_connectionInvalidator, m_config, m_streamProvider, m_eagerHandshake);
+
+}
+
+void ConnectionProvider::setEagerHandshake(bool eagerHandshake) {
+  /* Accepts wait for the eager handshake - without a timeout one silent client stops accepting */
+  if(eagerHandshake && m_config->get()->getHandshakeTimeout() <= 0) {
+    throw std::runtime_error("[oatpp::mbedtls::server::ConnectionProvider::setEagerHandshake()]: Error. "
+                             "Eager handshake requires a handshake timeout - see Config::setHandshakeTimeout().");
+  }
+  m_eagerHandshake = eagerHandshake;
+}
+
 }}}
@@ -25,6 +25,7 @@
 #ifndef oatpp_mbedtls_server_ConnectionProvider_hpp
 #define oatpp_mbedtls_server_ConnectionProvider_hpp
 
+#include "oatpp-mbedtls/server/HandshakeWorkerPool.hpp"
 #include "oatpp-mbedtls/Connection.hpp"
 #include "oatpp-mbedtls/Config.hpp"
 
@@ -45,10 +46,43 @@ private:
     void invalidate(const std::shared_ptr<data::stream::IOStream>& connection) override;
   };
 
+  /**
+   * RCU slot of the current config. Readers don't lock - they announce themselves in the readers counter,
+   * so the writer frees a replaced holder only after all readers which could see it are gone.
+   * Connections keep their config alive via `std::shared_ptr`.
+   */
+  class ConfigSlot {
+  private:
+    struct Holder {
+      std::shared_ptr<Config> config;
+    };
+  private:
+    std::atomic<Holder*> m_current;
+    std::atomic<v_int64> m_readers;
+    std::mutex m_writeLock;
+  public:
+
+    ConfigSlot(const std::shared_ptr<Config>& config);
+    ~ConfigSlot();
+
+    std::shared_ptr<Config> get();
+    void set(const std::shared_ptr<Config>& config);
+
+  };
+
 private:
   std::shared_ptr<ConnectionInvalidator> m_connectionInvalidator;
-  std::shared_ptr<Config> m_config;
+  std::shared_ptr<ConfigSlot> m_config;
   std::shared_ptr<oatpp::network::ServerConnectionProvider> m_streamProvider;
+  bool m_eagerHandshake;
+private:
+  std::shared_ptr<HandshakeWorkerPool> m_handshakeWorkers;
+  std::mutex m_acceptorLock;
+  std::thread m_acceptor;
+  std::atomic<bool> m_stopped;
+private:
+  provider::ResourceHandle<data::stream::IOStream> accept();
+  void runAcceptor();
 public:
   /**
    * Constructor.
@@ -85,34 +119,70 @@ public:
    */
   ~ConnectionProvider();
 
+  /**
+   * Replace config. New handshakes use the new config immediately, existing connections keep their config until closed.
+   * Doesn't block &l:ConnectionProvider::get (); - safe to call while serving traffic.
+   * See &id:oatpp::mbedtls::server::CertificateWatcher; to reload config on certificate change.
+   * @param config - &id:oatpp::mbedtls::Config;.
+   */
+  void setConfig(const std::shared_ptr<Config>& config);
+
+  /**
+   * Get config used for new connections.
+   * @return - &id:oatpp::mbedtls::Config;.
+   */
+  std::shared_ptr<Config> getConfig();
+
   /**
    * Close all handles.
    */
   void stop() override;
 
   /**
-   * Get incoming connection.
+   * Get incoming connection.<br>
+   * If handshake workers are enabled (see &l:ConnectionProvider::enableHandshakeWorkers ();),
+   * returns connections with TLS handshake already done. Otherwise handshake is done on the first `initContexts()` call.
    * @return &id:oatpp::data::stream::IOStream;.
    */
   provider::ResourceHandle<data::stream::IOStream> get() override;
 
   /**
-   * No need to implement this.<br>
-   * For Asynchronous IO in oatpp it is considered to be a good practice
-   * to accept connections in a seperate thread with the blocking accept()
-   * and then process connections in Asynchronous manner with non-blocking read/write.
-   * <br>
-   * *It may be implemented later*
+   * Do handshakes on a dedicated pool of threads owned by this provider.<br>
+   * A provider's thread accepts connections and queues them to the pool,
+   * &l:ConnectionProvider::get (); hands out only connections with the established TLS session.
+   * This way slow clients can't hold connection handler threads during the handshake.<br>
+   * *Must be called before the first call to &l:ConnectionProvider::get ();.*
+   * @param threadsCount - number of handshake threads.
+   * @param maxQueueSize - max number of accepted connections waiting for handshake or waiting to be taken by `get()`.
+   */
+  void enableHandshakeWorkers(v_int32 threadsCount, v_int32 maxQueueSize);
+
+  /**
+   * Get handshake workers pool. Use it to get statistics - queue depth, handshake latency.
+   * @return - &id:oatpp::mbedtls::server::HandshakeWorkerPool; or `nullptr` if handshake workers are not enabled.
+   */
+  std::shared_ptr<HandshakeWorkerPool> getHandshakeWorkers();
+
+  /**
+   * Get incoming connection in asynchronous manner.<br>
+   * Accepts connection with the underlying stream provider's `getAsync()` and sets up TLS on it.
+   * If eager handshake is enabled (see &l:ConnectionProvider::setEagerHandshake ();) the handshake is done here
+   * and the next connection is accepted after it's finished, otherwise it's done on the first `initContextsAsync()` call of the connection.
+   * Connections which fail the eager handshake are closed and the next connection is accepted.<br>
+   * *Underlying stream provider must implement `getAsync()`.*
+   * @return - &id:oatpp::async::CoroutineStarterForResult;.
+   */
+  oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> getAsync() override;
+
+  /**
+   * Set if &l:ConnectionProvider::getAsync (); should complete TLS handshake before returning connection.<br>
+   * The handshake runs in the `getAsync()` coroutine - the next connection is not accepted until it's finished,
+   * so accepts are serialized by handshakes. Config must have a handshake timeout (see &id:oatpp::mbedtls::Config::setHandshakeTimeout;)
+   * to bound the time a silent client holds accepting - `std::runtime_error` is thrown otherwise.
+   * Once enabled, configs without a handshake timeout are refused by &l:ConnectionProvider::setConfig ();.
+   * @param eagerHandshake - `true` to handshake in `getAsync()`. Default `false`.
    */
-  oatpp::async::CoroutineStarterForResult<const provider::ResourceHandle<data::stream::IOStream>&> getAsync() override {
-    /*
-     *  No need to implement this.
-     *  For Asynchronous IO in oatpp it is considered to be a good practice
-     *  to accept connections in a seperate thread with the blocking accept()
-     *  and then process connections in Asynchronous manner with non-blocking read/write
-     */
-    throw std::runtime_error("oatpp::mbedtls::server::ConnectionProvider::getConnectionAsync not implemented.");
-  }
+  void setEagerHandshake(bool eagerHandshake);
 
 };
 
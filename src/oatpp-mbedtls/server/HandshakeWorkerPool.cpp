@@ -0,0 +1,222 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "HandshakeWorkerPool.hpp"
+
+#include <algorithm>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+HandshakeWorkerPool::HandshakeWorkerPool(v_int32 threadsCount, v_int32 maxQueueSize)
+  : m_maxQueueSize(maxQueueSize)
+  , m_peakHandshaking(0)
+  , m_running(true)
+  , m_handshakesSucceeded(0)
+  , m_handshakesFailed(0)
+  , m_handshakeTicksTotal(0)
+  , m_handshakeTicksMax(0)
+  , m_queueTicksTotal(0)
+{
+  if(threadsCount < 1) {
+    throw std::runtime_error("[oatpp::mbedtls::server::HandshakeWorkerPool::HandshakeWorkerPool()]: Error. Invalid threadsCount.");
+  }
+  if(m_maxQueueSize < 1) {
+    throw std::runtime_error("[oatpp::mbedtls::server::HandshakeWorkerPool::HandshakeWorkerPool()]: Error. Invalid maxQueueSize.");
+  }
+  for(v_int32 i = 0; i < threadsCount; i ++) {
+    m_workers.push_back(std::thread(&HandshakeWorkerPool::run, this));
+  }
+}
+
+HandshakeWorkerPool::~HandshakeWorkerPool() {
+  stop();
+  for(auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void HandshakeWorkerPool::run() {
+
+  while(true) {
+
+    Task task;
+    std::list<provider::ResourceHandle<data::stream::IOStream>>::iterator handshaking;
+
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while(m_running && m_tasks.empty()) {
+        m_taskCondition.wait(lock);
+      }
+      if(!m_running) {
+        return;
+      }
+      task = m_tasks.front();
+      m_tasks.pop_front();
+      handshaking = m_handshaking.insert(m_handshaking.end(), task.connection);
+      m_peakHandshaking = std::max(m_peakHandshaking, (v_int64) m_handshaking.size());
+    }
+
+    m_spaceCondition.notify_one();
+
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+    m_queueTicksTotal += startTick - task.queuedTick;
+
+    task.connection.object->initContexts();
+
+    auto ticks = oatpp::base::Environment::getMicroTickCount() - startTick;
+    auto connection = std::static_pointer_cast<Connection>(task.connection.object);
+
+    bool succeeded = (connection->getHandshakeResult() == 0);
+
+    if(succeeded) {
+      ++ m_handshakesSucceeded;
+      m_handshakeTicksTotal += ticks;
+      v_int64 max = m_handshakeTicksMax.load();
+      while(ticks > max && !m_handshakeTicksMax.compare_exchange_weak(max, ticks)) {}
+    } else {
+      ++ m_handshakesFailed;
+    }
+
+    bool ready = false;
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_handshaking.erase(handshaking);
+      if(succeeded && m_running) {
+        m_ready.push_back(task.connection);
+        ready = true;
+      }
+    }
+
+    if(!ready) {
+      task.connection.invalidator->invalidate(task.connection.object);
+      continue;
+    }
+
+    m_readyCondition.notify_one();
+
+  }
+
+}
+
+bool HandshakeWorkerPool::submit(const provider::ResourceHandle<data::stream::IOStream>& connection) {
+
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while(m_running && (v_int32)(m_tasks.size() + m_ready.size()) >= m_maxQueueSize) {
+      m_spaceCondition.wait(lock);
+    }
+    if(!m_running) {
+      return false;
+    }
+    m_tasks.push_back({connection, oatpp::base::Environment::getMicroTickCount()});
+  }
+
+  m_taskCondition.notify_one();
+  return true;
+
+}
+
+provider::ResourceHandle<data::stream::IOStream> HandshakeWorkerPool::take() {
+
+  provider::ResourceHandle<data::stream::IOStream> result;
+
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while(m_running && m_ready.empty()) {
+      m_readyCondition.wait(lock);
+    }
+    if(!m_running) {
+      return nullptr;
+    }
+    result = m_ready.front();
+    m_ready.pop_front();
+  }
+
+  m_spaceCondition.notify_one();
+  return result;
+
+}
+
+void HandshakeWorkerPool::stop() {
+
+  std::list<Task> tasks;
+  std::list<provider::ResourceHandle<data::stream::IOStream>> handshaking;
+  std::list<provider::ResourceHandle<data::stream::IOStream>> ready;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_running = false;
+    tasks.swap(m_tasks);
+    handshaking = m_handshaking; // workers remove their own entries
+    ready.swap(m_ready);
+  }
+
+  m_taskCondition.notify_all();
+  m_readyCondition.notify_all();
+  m_spaceCondition.notify_all();
+
+  for(auto& task : tasks) {
+    task.connection.invalidator->invalidate(task.connection.object);
+  }
+
+  /* Worker waiting for a silent client is woken up the same way the monitor wakes up expired connections */
+  for(auto& connection : handshaking) {
+    auto transport = std::static_pointer_cast<Connection>(connection.object)->getTransportStream();
+    transport.invalidator->invalidate(transport.object);
+  }
+
+  for(auto& connection : ready) {
+    connection.invalidator->invalidate(connection.object);
+  }
+
+}
+
+HandshakeWorkerPool::Statistics HandshakeWorkerPool::getStatistics() {
+
+  Statistics stats;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    stats.queueDepth = (v_int64) m_tasks.size();
+    stats.handshakingCount = (v_int64) m_handshaking.size();
+    stats.peakHandshakingCount = m_peakHandshaking;
+    stats.readyCount = (v_int64) m_ready.size();
+  }
+
+  stats.handshakesSucceeded = m_handshakesSucceeded;
+  stats.handshakesFailed = m_handshakesFailed;
+
+  auto handshakes = stats.handshakesSucceeded;
+  auto picked = stats.handshakesSucceeded + stats.handshakesFailed;
+
+  stats.averageHandshakeMicroseconds = handshakes > 0 ? m_handshakeTicksTotal / handshakes : 0;
+  stats.maxHandshakeMicroseconds = m_handshakeTicksMax;
+  stats.averageQueueMicroseconds = picked > 0 ? m_queueTicksTotal / picked : 0;
+
+  return stats;
+
+}
+
+}}}
@@ -0,0 +1,172 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_server_HandshakeWorkerPool_hpp
+#define oatpp_mbedtls_server_HandshakeWorkerPool_hpp
+
+#include "oatpp-mbedtls/Connection.hpp"
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+/**
+ * Bounded pool of threads doing TLS handshakes for the blocking server &id:oatpp::mbedtls::server::ConnectionProvider;.<br>
+ * Accepted connections are queued to the pool, workers do the handshake,
+ * and only connections with the successful handshake are handed out by &l:HandshakeWorkerPool::take ();.<br>
+ * Handshake is blocking - a worker waits for the client as long as the transport lets it.
+ * &l:HandshakeWorkerPool::stop (); closes transports of connections in handshake, so workers don't hold it up.
+ */
+class HandshakeWorkerPool {
+public:
+
+  /**
+   * Pool statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Connections waiting for a worker.
+     */
+    v_int64 queueDepth;
+
+    /**
+     * Connections in handshake.
+     */
+    v_int64 handshakingCount;
+
+    /**
+     * Max number of connections which were in handshake at the same time.
+     */
+    v_int64 peakHandshakingCount;
+
+    /**
+     * Established connections waiting to be taken.
+     */
+    v_int64 readyCount;
+
+    /**
+     * Number of successful handshakes.
+     */
+    v_int64 handshakesSucceeded;
+
+    /**
+     * Number of failed handshakes.
+     */
+    v_int64 handshakesFailed;
+
+    /**
+     * Average handshake latency in microseconds (time from the worker starting the handshake until it's done).
+     */
+    v_int64 averageHandshakeMicroseconds;
+
+    /**
+     * Max handshake latency in microseconds.
+     */
+    v_int64 maxHandshakeMicroseconds;
+
+    /**
+     * Average time connections spent in queue before a worker picked them, in microseconds.
+     */
+    v_int64 averageQueueMicroseconds;
+
+  };
+
+private:
+
+  struct Task {
+    provider::ResourceHandle<data::stream::IOStream> connection;
+    v_int64 queuedTick;
+  };
+
+private:
+  void run();
+private:
+  v_int32 m_maxQueueSize;
+  std::vector<std::thread> m_workers;
+private:
+  std::mutex m_lock;
+  std::condition_variable m_taskCondition;
+  std::condition_variable m_readyCondition;
+  std::condition_variable m_spaceCondition;
+  std::list<Task> m_tasks;
+  std::list<provider::ResourceHandle<data::stream::IOStream>> m_handshaking;
+  v_int64 m_peakHandshaking;
+  std::list<provider::ResourceHandle<data::stream::IOStream>> m_ready;
+  bool m_running;
+private:
+  std::atomic<v_int64> m_handshakesSucceeded;
+  std::atomic<v_int64> m_handshakesFailed;
+  std::atomic<v_int64> m_handshakeTicksTotal;
+  std::atomic<v_int64> m_handshakeTicksMax;
+  std::atomic<v_int64> m_queueTicksTotal;
+public:
+
+  /**
+   * Constructor.
+   * @param threadsCount - number of handshake worker threads.
+   * @param maxQueueSize - max number of connections waiting for handshake or waiting to be taken.
+   */
+  HandshakeWorkerPool(v_int32 threadsCount, v_int32 maxQueueSize);
+
+  /**
+   * Non-virtual destructor. Stops and joins workers.
+   */
+  ~HandshakeWorkerPool();
+
+  /**
+   * Queue connection for handshake. Blocks while the pool is full.
+   * @param connection - connection with not yet initialized TLS stream.
+   * @return - `false` if pool is stopped and connection was not queued.
+   */
+  bool submit(const provider::ResourceHandle<data::stream::IOStream>& connection);
+
+  /**
+   * Take connection with established TLS session. Blocks until there is one or the pool is stopped.
+   * @return - connection or `nullptr` if pool is stopped.
+   */
+  provider::ResourceHandle<data::stream::IOStream> take();
+
+  /**
+   * Stop the pool. Queued connections are invalidated.
+   * Transports of connections in handshake are closed - their handshakes fail and workers return.
+   */
+  void stop();
+
+  /**
+   * Get pool statistics.
+   * @return - &l:HandshakeWorkerPool::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_server_HandshakeWorkerPool_hpp
@@ -0,0 +1,224 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "SessionCache.hpp"
+
+#include "mbedtls/platform_util.h"
+
+#include <cstring>
+#include <functional>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+SessionCache::SessionCache(v_int64 maxEntries, v_int64 timeoutSeconds, v_int32 shardsCount)
+  : m_timeoutMicroseconds(timeoutSeconds * 1000 * 1000)
+  , m_hits(0)
+  , m_misses(0)
+  , m_stores(0)
+  , m_evictions(0)
+  , m_expirations(0)
+{
+
+  if(shardsCount < 1) {
+    shardsCount = 1;
+  }
+
+  m_maxEntriesPerShard = (maxEntries + shardsCount - 1) / shardsCount;
+  if(m_maxEntriesPerShard < 1) {
+    m_maxEntriesPerShard = 1;
+  }
+
+  for(v_int32 i = 0; i < shardsCount; i ++) {
+    m_shards.push_back(new Shard());
+  }
+
+}
+
+SessionCache::~SessionCache() {
+  for(auto shard : m_shards) {
+    clear(*shard);
+    delete shard;
+  }
+}
+
+std::shared_ptr<SessionCache> SessionCache::createShared(v_int64 maxEntries, v_int64 timeoutSeconds, v_int32 shardsCount) {
+  return std::make_shared<SessionCache>(maxEntries, timeoutSeconds, shardsCount);
+}
+
+int SessionCache::getCallback(void* data, const unsigned char* sessionId, size_t sessionIdLength, mbedtls_ssl_session* session) {
+  if(sessionIdLength == 0) {
+    auto cache = static_cast<SessionCache*>(data);
+    ++ cache->m_misses;
+    return 1;
+  }
+  return static_cast<SessionCache*>(data)->get(std::string((const char*) sessionId, sessionIdLength), session);
+}
+
+int SessionCache::setCallback(void* data, const unsigned char* sessionId, size_t sessionIdLength, const mbedtls_ssl_session* session) {
+  if(sessionIdLength == 0) {
+    return 1;
+  }
+  return static_cast<SessionCache*>(data)->set(std::string((const char*) sessionId, sessionIdLength), session);
+}
+
+void SessionCache::wipe(std::string& session) {
+  if(!session.empty()) {
+    mbedtls_platform_zeroize(&session[0], session.size());
+  }
+}
+
+void SessionCache::erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+  /* Serialized session holds the master secret */
+  wipe(it->second.session);
+  shard.lru.erase(it->second.lruPosition);
+  shard.entries.erase(it);
+}
+
+void SessionCache::clear(Shard& shard) {
+  for(auto& entry : shard.entries) {
+    wipe(entry.second.session);
+  }
+  shard.entries.clear();
+  shard.lru.clear();
+}
+
+SessionCache::Shard& SessionCache::getShard(const std::string& id) {
+  return *m_shards[std::hash<std::string>()(id) % m_shards.size()];
+}
+
+int SessionCache::get(const std::string& id, mbedtls_ssl_session* session) {
+
+  auto& shard = getShard(id);
+
+  std::string serialized;
+
+  {
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto it = shard.entries.find(id);
+    if(it == shard.entries.end()) {
+      ++ m_misses;
+      return 1;
+    }
+
+    auto& entry = it->second;
+
+    if(oatpp::base::Environment::getMicroTickCount() - entry.timestamp > m_timeoutMicroseconds) {
+      erase(shard, it);
+      ++ m_expirations;
+      ++ m_misses;
+      return 1;
+    }
+
+    serialized = entry.session;
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPosition);
+
+  }
+
+  /* Deserialization parses the peer certificate - do it outside of the lock */
+  auto res = mbedtls_ssl_session_load(session, (const unsigned char*) serialized.data(), serialized.size());
+  wipe(serialized);
+
+  if(res != 0) {
+    ++ m_misses;
+    return 1;
+  }
+
+  ++ m_hits;
+  return 0;
+
+}
+
+int SessionCache::set(const std::string& id, const mbedtls_ssl_session* session) {
+
+  size_t length = 0;
+  auto res = mbedtls_ssl_session_save(session, nullptr, 0, &length);
+  if(res != MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL && res != 0) {
+    return 1;
+  }
+
+  Entry entry;
+  entry.session.resize(length);
+  res = mbedtls_ssl_session_save(session, (unsigned char*) &entry.session[0], entry.session.size(), &length);
+  if(res != 0) {
+    wipe(entry.session);
+    return 1;
+  }
+  entry.timestamp = oatpp::base::Environment::getMicroTickCount();
+
+  auto& shard = getShard(id);
+
+  std::lock_guard<std::mutex> lock(shard.lock);
+
+  auto it = shard.entries.find(id);
+  if(it != shard.entries.end()) {
+    erase(shard, it);
+  }
+
+  while((v_int64) shard.entries.size() >= m_maxEntriesPerShard) {
+    erase(shard, shard.entries.find(shard.lru.back()));
+    ++ m_evictions;
+  }
+
+  shard.lru.push_front(id);
+  entry.lruPosition = shard.lru.begin();
+  shard.entries.insert({id, std::move(entry)});
+
+  ++ m_stores;
+  return 0;
+
+}
+
+void SessionCache::configure(mbedtls_ssl_config* config) {
+  mbedtls_ssl_conf_session_cache(config, this, &SessionCache::getCallback, &SessionCache::setCallback);
+}
+
+void SessionCache::clear() {
+  for(auto shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    clear(*shard);
+  }
+}
+
+SessionCache::Statistics SessionCache::getStatistics() {
+
+  Statistics stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.stores = m_stores;
+  stats.evictions = m_evictions;
+  stats.expirations = m_expirations;
+  stats.size = 0;
+
+  for(auto shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    stats.size += (v_int64) shard->entries.size();
+  }
+
+  return stats;
+
+}
+
+}}}
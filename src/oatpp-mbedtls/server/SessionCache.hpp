@@ -0,0 +1,168 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_server_SessionCache_hpp
+#define oatpp_mbedtls_server_SessionCache_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+/**
+ * Server-side TLS session-ID cache. Lets returning clients do the abbreviated handshake.<br>
+ * Cache is split into shards, each having its own lock, so lookups from concurrent handshakes don't serialize.
+ * Memory is bounded by max number of entries (least recently used entries are evicted first),
+ * entries older than timeout are treated as absent and removed.<br>
+ * Use with &id:oatpp::mbedtls::Config::setSessionCache;.
+ */
+class SessionCache {
+public:
+
+  /**
+   * Cache statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of sessions found in cache.
+     */
+    v_int64 hits;
+
+    /**
+     * Number of lookups which didn't find a valid session.
+     */
+    v_int64 misses;
+
+    /**
+     * Number of sessions stored.
+     */
+    v_int64 stores;
+
+    /**
+     * Number of sessions evicted to keep cache size bounded.
+     */
+    v_int64 evictions;
+
+    /**
+     * Number of sessions removed because of timeout.
+     */
+    v_int64 expirations;
+
+    /**
+     * Current number of cached sessions.
+     */
+    v_int64 size;
+
+  };
+
+private:
+
+  struct Entry {
+    std::string session; // serialized with mbedtls_ssl_session_save()
+    v_int64 timestamp;
+    std::list<std::string>::iterator lruPosition;
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru;
+  };
+
+private:
+  static int getCallback(void* data, const unsigned char* sessionId, size_t sessionIdLength, mbedtls_ssl_session* session);
+  static int setCallback(void* data, const unsigned char* sessionId, size_t sessionIdLength, const mbedtls_ssl_session* session);
+private:
+  static void wipe(std::string& session);
+  static void erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+  static void clear(Shard& shard);
+  Shard& getShard(const std::string& id);
+  int get(const std::string& id, mbedtls_ssl_session* session);
+  int set(const std::string& id, const mbedtls_ssl_session* session);
+private:
+  std::vector<Shard*> m_shards;
+  v_int64 m_maxEntriesPerShard;
+  v_int64 m_timeoutMicroseconds;
+private:
+  std::atomic<v_int64> m_hits;
+  std::atomic<v_int64> m_misses;
+  std::atomic<v_int64> m_stores;
+  std::atomic<v_int64> m_evictions;
+  std::atomic<v_int64> m_expirations;
+public:
+
+  /**
+   * Constructor.
+   * @param maxEntries - max number of cached sessions.
+   * @param timeoutSeconds - session lifetime in seconds.
+   * @param shardsCount - number of independently locked shards.
+   */
+  SessionCache(v_int64 maxEntries, v_int64 timeoutSeconds, v_int32 shardsCount);
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~SessionCache();
+
+  /**
+   * Create shared SessionCache.
+   * @param maxEntries - max number of cached sessions. Default `10000`.
+   * @param timeoutSeconds - session lifetime in seconds. Default `3600`.
+   * @param shardsCount - number of independently locked shards. Default `16`.
+   * @return - `std::shared_ptr` to SessionCache.
+   */
+  static std::shared_ptr<SessionCache> createShared(v_int64 maxEntries = 10000, v_int64 timeoutSeconds = 3600, v_int32 shardsCount = 16);
+
+  /**
+   * Register this cache in `mbedtls_ssl_config`.
+   * @param config - `mbedtls_ssl_config*`.
+   */
+  void configure(mbedtls_ssl_config* config);
+
+  /**
+   * Remove all cached sessions.
+   */
+  void clear();
+
+  /**
+   * Get cache statistics.
+   * @return - &l:SessionCache::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_server_SessionCache_hpp
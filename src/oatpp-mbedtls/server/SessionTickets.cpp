@@ -0,0 +1,425 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+/* Early data permission of a resumed session is a private ticket flag in Mbed TLS 3.x */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include "SessionTickets.hpp"
+
+#include "mbedtls/gcm.h"
+#include "mbedtls/platform_util.h"
+
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <ctime>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+SessionTickets::Key::~Key() {
+  mbedtls_platform_zeroize(secret, KEY_SIZE);
+}
+
+SessionTickets::KeySet::~KeySet() {
+  /* Key file content is the raw key material */
+  if(!fileContent.empty()) {
+    mbedtls_platform_zeroize(&fileContent[0], fileContent.size());
+  }
+}
+
+SessionTickets::SessionTickets(v_int64 lifetimeSeconds, v_int64 updateIntervalSeconds, const std::string& keyFile)
+  : m_lifetimeSeconds(lifetimeSeconds)
+  , m_updateIntervalMicroseconds(updateIntervalSeconds * 1000 * 1000)
+  , m_keyFile(keyFile)
+  , m_nextUpdateTick(0)
+  , m_earlyDataWindow(0)
+  , m_issued(0)
+  , m_accepted(0)
+  , m_rejected(0)
+  , m_expired(0)
+  , m_keyUpdates(0)
+  , m_earlyDataAdmitted(0)
+  , m_earlyDataDenied(0)
+{
+
+  mbedtls_entropy_init(&m_entropy);
+  mbedtls_ctr_drbg_init(&m_ctr_drbg);
+
+  auto res = mbedtls_ctr_drbg_seed(&m_ctr_drbg, mbedtls_entropy_func, &m_entropy, nullptr, 0);
+  if(res != 0) {
+    OATPP_LOGD("[oatpp::mbedtls::server::SessionTickets::SessionTickets()]", "Error. Call to mbedtls_ctr_drbg_seed() failed. Return value=%d", res);
+    throw std::runtime_error("[oatpp::mbedtls::server::SessionTickets::SessionTickets()]: Error. Call to mbedtls_ctr_drbg_seed() failed.");
+  }
+
+  auto now = oatpp::base::Environment::getMicroTickCount();
+  std::shared_ptr<const KeySet> keys;
+
+  if(m_keyFile.empty()) {
+    keys = rotateKeys(nullptr, now);
+  } else {
+    keys = loadKeys(nullptr, now);
+    if(!keys) {
+      throw std::runtime_error("[oatpp::mbedtls::server::SessionTickets::SessionTickets()]: Error. Can't load ticket keys from file.");
+    }
+  }
+
+  std::atomic_store(&m_keys, keys);
+  m_nextUpdateTick = now + m_updateIntervalMicroseconds;
+
+}
+
+SessionTickets::~SessionTickets() {
+  /* Key sets still referenced by running handshakes are wiped when they are released */
+  std::atomic_store(&m_keys, std::shared_ptr<const KeySet>());
+  mbedtls_ctr_drbg_free(&m_ctr_drbg);
+  mbedtls_entropy_free(&m_entropy);
+}
+
+std::shared_ptr<SessionTickets> SessionTickets::createShared(v_int64 lifetimeSeconds, v_int64 rotationIntervalSeconds) {
+  return std::make_shared<SessionTickets>(lifetimeSeconds, rotationIntervalSeconds, "");
+}
+
+std::shared_ptr<SessionTickets> SessionTickets::createSharedWithKeyFile(const char* keyFile, v_int64 lifetimeSeconds, v_int64 reloadIntervalSeconds) {
+  return std::make_shared<SessionTickets>(lifetimeSeconds, reloadIntervalSeconds, keyFile);
+}
+
+int SessionTickets::writeCallback(void* p_ticket, const mbedtls_ssl_session* session,
+                                  unsigned char* start, const unsigned char* end, size_t* tlen, uint32_t* lifetime)
+{
+  return static_cast<SessionTickets*>(p_ticket)->write(session, start, end, tlen, lifetime);
+}
+
+int SessionTickets::parseCallback(void* p_ticket, mbedtls_ssl_session* session, unsigned char* buf, size_t len) {
+  return static_cast<SessionTickets*>(p_ticket)->parse(session, buf, len);
+}
+
+int SessionTickets::random(unsigned char* output, size_t length) {
+  std::lock_guard<std::mutex> lock(m_randomLock);
+  return mbedtls_ctr_drbg_random(&m_ctr_drbg, output, length);
+}
+
+std::shared_ptr<const SessionTickets::KeySet> SessionTickets::rotateKeys(const std::shared_ptr<const KeySet>& keys, v_int64 now) {
+
+  auto result = std::make_shared<KeySet>();
+
+  Key key;
+  if(random(key.name, KEY_NAME_SIZE) != 0 || random(key.secret, KEY_SIZE) != 0) {
+    OATPP_LOGE("[oatpp::mbedtls::server::SessionTickets::rotateKeys()]", "Error. Can't generate ticket key.");
+    return nullptr;
+  }
+  key.createdTick = now;
+  result->keys.push_back(key);
+
+  if(keys) {
+    /* Key stops issuing tickets when the next key is created. Keep it while those tickets are still valid. */
+    const v_int64 lifetimeMicroseconds = m_lifetimeSeconds * 1000 * 1000;
+    v_int64 retiredTick = now;
+    for(auto& oldKey : keys->keys) {
+      if(retiredTick + lifetimeMicroseconds < now) {
+        break;
+      }
+      result->keys.push_back(oldKey);
+      retiredTick = oldKey.createdTick;
+    }
+  }
+
+  return result;
+
+}
+
+std::shared_ptr<const SessionTickets::KeySet> SessionTickets::loadKeys(const std::shared_ptr<const KeySet>& keys, v_int64 now) {
+
+  std::ifstream file(m_keyFile, std::ios::in | std::ios::binary);
+  if(!file.is_open()) {
+    OATPP_LOGE("[oatpp::mbedtls::server::SessionTickets::loadKeys()]", "Error. Can't open key file '%s'.", m_keyFile.c_str());
+    return nullptr;
+  }
+
+  auto result = std::make_shared<KeySet>();
+  result->fileContent.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  const std::string& content = result->fileContent;
+
+  if(keys && keys->fileContent == content) {
+    return keys;
+  }
+
+  const v_buff_size recordSize = KEY_NAME_SIZE + KEY_SIZE;
+  if(content.empty() || content.size() % recordSize != 0) {
+    OATPP_LOGE("[oatpp::mbedtls::server::SessionTickets::loadKeys()]",
+               "Error. Invalid key file '%s'. File size must be a non-zero multiple of %d bytes.", m_keyFile.c_str(), (int) recordSize);
+    return nullptr;
+  }
+
+  for(v_buff_size pos = 0; pos < (v_buff_size) content.size(); pos += recordSize) {
+    Key key;
+    std::memcpy(key.name, content.data() + pos, KEY_NAME_SIZE);
+    std::memcpy(key.secret, content.data() + pos + KEY_NAME_SIZE, KEY_SIZE);
+    key.createdTick = now;
+    result->keys.push_back(key);
+  }
+
+  return result;
+
+}
+
+std::shared_ptr<const SessionTickets::KeySet> SessionTickets::getKeys() {
+
+  auto keys = std::atomic_load(&m_keys);
+  auto now = oatpp::base::Environment::getMicroTickCount();
+
+  if(now < m_nextUpdateTick) {
+    return keys;
+  }
+
+  /* Only one thread updates keys. Others proceed with the current key set. */
+  std::unique_lock<std::mutex> lock(m_updateLock, std::try_to_lock);
+  if(!lock.owns_lock() || now < m_nextUpdateTick) {
+    return keys;
+  }
+
+  std::shared_ptr<const KeySet> newKeys;
+  if(m_keyFile.empty()) {
+    newKeys = rotateKeys(keys, now);
+  } else {
+    newKeys = loadKeys(keys, now);
+  }
+
+  if(newKeys && newKeys != keys) {
+    std::atomic_store(&m_keys, newKeys);
+    keys = newKeys;
+    ++ m_keyUpdates;
+  }
+
+  m_nextUpdateTick = now + m_updateIntervalMicroseconds;
+  return keys;
+
+}
+
+int SessionTickets::write(const mbedtls_ssl_session* session, unsigned char* start, const unsigned char* end, size_t* tlen, uint32_t* lifetime) {
+
+  auto keys = getKeys();
+  const Key& key = keys->keys.front();
+
+  /*
+   * Ticket state: 8-byte issue time followed by the session serialized with mbedtls_ssl_session_save().
+   * Ticket layout: key name | IV | encrypted state | tag.
+   */
+
+  size_t sessionSize = 0;
+  int res = mbedtls_ssl_session_save(session, nullptr, 0, &sessionSize);
+  if(res != MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL && res != 0) {
+    return res;
+  }
+
+  const size_t stateSize = ISSUE_TIME_SIZE + sessionSize;
+  const size_t ticketSize = KEY_NAME_SIZE + IV_SIZE + stateSize + TAG_SIZE;
+
+  if(end < start || (size_t)(end - start) < ticketSize) {
+    return MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL;
+  }
+
+  std::vector<unsigned char> state(stateSize);
+
+  const uint64_t issueTime = (uint64_t) std::time(nullptr);
+  for(v_int32 i = 0; i < ISSUE_TIME_SIZE; i ++) {
+    state[i] = (unsigned char)(issueTime >> (8 * (ISSUE_TIME_SIZE - 1 - i)));
+  }
+
+  res = mbedtls_ssl_session_save(session, state.data() + ISSUE_TIME_SIZE, sessionSize, &sessionSize);
+  if(res != 0) {
+    mbedtls_platform_zeroize(state.data(), state.size());
+    return res;
+  }
+
+  unsigned char* name = start;
+  unsigned char* iv = name + KEY_NAME_SIZE;
+  unsigned char* encrypted = iv + IV_SIZE;
+  unsigned char* tag = encrypted + stateSize;
+
+  std::memcpy(name, key.name, KEY_NAME_SIZE);
+
+  res = random(iv, IV_SIZE);
+  if(res != 0) {
+    mbedtls_platform_zeroize(state.data(), state.size());
+    return res;
+  }
+
+  mbedtls_gcm_context gcm;
+  mbedtls_gcm_init(&gcm);
+
+  res = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key.secret, KEY_SIZE * 8);
+  if(res == 0) {
+    res = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, stateSize, iv, IV_SIZE, name, KEY_NAME_SIZE,
+                                    state.data(), encrypted, TAG_SIZE, tag);
+  }
+
+  mbedtls_gcm_free(&gcm);
+  mbedtls_platform_zeroize(state.data(), state.size());
+
+  if(res != 0) {
+    return res;
+  }
+
+  *tlen = ticketSize;
+  *lifetime = (uint32_t) m_lifetimeSeconds;
+
+  ++ m_issued;
+  return 0;
+
+}
+
+int SessionTickets::parse(mbedtls_ssl_session* session, unsigned char* buf, size_t len) {
+
+  if(len < KEY_NAME_SIZE + IV_SIZE + ISSUE_TIME_SIZE + TAG_SIZE) {
+    ++ m_rejected;
+    return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  }
+
+  auto keys = getKeys();
+
+  unsigned char* name = buf;
+  unsigned char* iv = name + KEY_NAME_SIZE;
+  unsigned char* encrypted = iv + IV_SIZE;
+  const size_t stateSize = len - KEY_NAME_SIZE - IV_SIZE - TAG_SIZE;
+  unsigned char* tag = encrypted + stateSize;
+
+  const Key* key = nullptr;
+  for(auto& candidate : keys->keys) {
+    if(std::memcmp(candidate.name, name, KEY_NAME_SIZE) == 0) {
+      key = &candidate;
+      break;
+    }
+  }
+
+  if(key == nullptr) {
+    ++ m_rejected;
+    return MBEDTLS_ERR_SSL_INVALID_MAC;
+  }
+
+  std::vector<unsigned char> state(stateSize);
+
+  mbedtls_gcm_context gcm;
+  mbedtls_gcm_init(&gcm);
+
+  int res = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key->secret, KEY_SIZE * 8);
+  if(res == 0) {
+    res = mbedtls_gcm_auth_decrypt(&gcm, stateSize, iv, IV_SIZE, name, KEY_NAME_SIZE, tag, TAG_SIZE, encrypted, state.data());
+  }
+
+  mbedtls_gcm_free(&gcm);
+
+  if(res != 0) {
+    mbedtls_platform_zeroize(state.data(), state.size());
+    ++ m_rejected;
+    return MBEDTLS_ERR_SSL_INVALID_MAC;
+  }
+
+  uint64_t issueTime = 0;
+  for(v_int32 i = 0; i < ISSUE_TIME_SIZE; i ++) {
+    issueTime = (issueTime << 8) | state[i];
+  }
+
+  if((v_int64) std::time(nullptr) - (v_int64) issueTime > m_lifetimeSeconds) {
+    mbedtls_platform_zeroize(state.data(), state.size());
+    ++ m_expired;
+    return MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED;
+  }
+
+  res = mbedtls_ssl_session_load(session, state.data() + ISSUE_TIME_SIZE, stateSize - ISSUE_TIME_SIZE);
+  if(res != 0) {
+    mbedtls_platform_zeroize(state.data(), state.size());
+    ++ m_rejected;
+    return res;
+  }
+
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+  if((session->ticket_flags & MBEDTLS_SSL_TLS1_3_TICKET_ALLOW_EARLY_DATA) != 0 && !admitEarlyData(tag, (v_int64) issueTime)) {
+    session->ticket_flags &= ~MBEDTLS_SSL_TLS1_3_TICKET_ALLOW_EARLY_DATA;
+  }
+#endif
+
+  mbedtls_platform_zeroize(state.data(), state.size());
+
+  ++ m_accepted;
+  return 0;
+
+}
+
+bool SessionTickets::admitEarlyData(const unsigned char* tag, v_int64 issueTime) {
+
+  const v_int64 window = m_earlyDataWindow;
+  const v_int64 now = (v_int64) std::time(nullptr);
+
+  if(window <= 0 || now - issueTime > window) {
+    ++ m_earlyDataDenied;
+    return false;
+  }
+
+  /* GCM tag is unique per ticket */
+  std::string id((const char*) tag, TAG_SIZE);
+
+  std::lock_guard<std::mutex> lock(m_earlyDataLock);
+
+  while(!m_earlyDataExpirations.empty() && m_earlyDataExpirations.top().first < now) {
+    m_earlyDataTickets.erase(m_earlyDataExpirations.top().second);
+    m_earlyDataExpirations.pop();
+  }
+
+  if(!m_earlyDataTickets.insert(id).second) {
+    ++ m_earlyDataDenied;
+    return false;
+  }
+
+  m_earlyDataExpirations.push({issueTime + window, id});
+  ++ m_earlyDataAdmitted;
+  return true;
+
+}
+
+void SessionTickets::setEarlyDataWindow(v_int64 seconds) {
+  m_earlyDataWindow = seconds;
+}
+
+void SessionTickets::configure(mbedtls_ssl_config* config) {
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_SRV_C)
+  mbedtls_ssl_conf_session_tickets_cb(config, &SessionTickets::writeCallback, &SessionTickets::parseCallback, this);
+#else
+  (void) config;
+  throw std::runtime_error("[oatpp::mbedtls::server::SessionTickets::configure()]: Error. Mbed TLS is built without MBEDTLS_SSL_SESSION_TICKETS.");
+#endif
+}
+
+SessionTickets::Statistics SessionTickets::getStatistics() {
+  Statistics stats;
+  stats.issued = m_issued;
+  stats.accepted = m_accepted;
+  stats.rejected = m_rejected;
+  stats.expired = m_expired;
+  stats.keyUpdates = m_keyUpdates;
+  stats.earlyDataAdmitted = m_earlyDataAdmitted;
+  stats.earlyDataDenied = m_earlyDataDenied;
+  return stats;
+}
+
+}}}
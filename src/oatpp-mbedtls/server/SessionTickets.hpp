@@ -0,0 +1,223 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_mbedtls_server_SessionTickets_hpp
+#define oatpp_mbedtls_server_SessionTickets_hpp
+
+#include "oatpp/core/base/Environment.hpp"
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <unordered_set>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+namespace oatpp { namespace mbedtls { namespace server {
+
+/**
+ * Stateless session tickets (RFC 5077). Session state is encrypted with AES-256-GCM ticket key and handed to the client,
+ * so server keeps no per-session memory.<br>
+ * Ticket keys are managed by this class:
+ * <ul>
+ *   <li>Without key file - keys are random and are rotated every `rotationInterval`.
+ *   Previous keys are kept while tickets issued with them are valid.</li>
+ *   <li>With key file - keys are loaded from the file, and the file is re-read every `reloadInterval`.
+ *   Processes and nodes sharing the same key file can resume each other's sessions.
+ *   File is a sequence of 48-byte records - 16 bytes key name followed by 32 bytes AES key
+ *   (ex.: `openssl rand 48 > ticket.key`). The first record is used to issue tickets, the rest are only accepted.
+ *   To rotate - prepend a new record and drop the oldest one.</li>
+ * </ul>
+ * Use with &id:oatpp::mbedtls::Config::setSessionTickets;.
+ */
+class SessionTickets {
+public:
+
+  /**
+   * Tickets statistics.
+   */
+  struct Statistics {
+
+    /**
+     * Number of tickets issued.
+     */
+    v_int64 issued;
+
+    /**
+     * Number of tickets successfully parsed (sessions resumed).
+     */
+    v_int64 accepted;
+
+    /**
+     * Number of tickets rejected (unknown key or not authentic).
+     */
+    v_int64 rejected;
+
+    /**
+     * Number of tickets expired.
+     */
+    v_int64 expired;
+
+    /**
+     * Number of key set updates (rotations or key file reloads).
+     */
+    v_int64 keyUpdates;
+
+    /**
+     * Number of tickets admitted for TLS 1.3 early data.
+     */
+    v_int64 earlyDataAdmitted;
+
+    /**
+     * Number of tickets denied early data (replayed or older than the anti-replay window).
+     * Sessions are still resumed, but early data is rejected.
+     */
+    v_int64 earlyDataDenied;
+
+  };
+
+private:
+
+  static constexpr v_buff_size KEY_NAME_SIZE = 16;
+  static constexpr v_buff_size KEY_SIZE = 32;
+  static constexpr v_buff_size IV_SIZE = 12;
+  static constexpr v_buff_size TAG_SIZE = 16;
+  static constexpr v_buff_size ISSUE_TIME_SIZE = 8;
+
+  struct Key {
+    unsigned char name[KEY_NAME_SIZE];
+    unsigned char secret[KEY_SIZE];
+    v_int64 createdTick;
+    ~Key();
+  };
+
+  struct KeySet {
+    std::vector<Key> keys;
+    std::string fileContent;
+    ~KeySet();
+  };
+
+private:
+  static int writeCallback(void* p_ticket, const mbedtls_ssl_session* session, unsigned char* start, const unsigned char* end, size_t* tlen, uint32_t* lifetime);
+  static int parseCallback(void* p_ticket, mbedtls_ssl_session* session, unsigned char* buf, size_t len);
+private:
+  int random(unsigned char* output, size_t length);
+  std::shared_ptr<const KeySet> getKeys();
+  std::shared_ptr<const KeySet> rotateKeys(const std::shared_ptr<const KeySet>& keys, v_int64 now);
+  std::shared_ptr<const KeySet> loadKeys(const std::shared_ptr<const KeySet>& keys, v_int64 now);
+  int write(const mbedtls_ssl_session* session, unsigned char* start, const unsigned char* end, size_t* tlen, uint32_t* lifetime);
+  int parse(mbedtls_ssl_session* session, unsigned char* buf, size_t len);
+  bool admitEarlyData(const unsigned char* tag, v_int64 issueTime);
+private:
+  v_int64 m_lifetimeSeconds;
+  v_int64 m_updateIntervalMicroseconds;
+  std::string m_keyFile;
+private:
+  mbedtls_entropy_context m_entropy;
+  mbedtls_ctr_drbg_context m_ctr_drbg;
+  std::mutex m_randomLock;
+private:
+  std::shared_ptr<const KeySet> m_keys;
+  std::mutex m_updateLock;
+  std::atomic<v_int64> m_nextUpdateTick;
+private:
+  std::atomic<v_int64> m_earlyDataWindow;
+  std::unordered_set<std::string> m_earlyDataTickets;
+  /* Min-heap by expiration time - tickets aren't admitted in the order they were issued */
+  std::priority_queue<std::pair<v_int64, std::string>,
+                      std::vector<std::pair<v_int64, std::string>>,
+                      std::greater<std::pair<v_int64, std::string>>> m_earlyDataExpirations;
+  std::mutex m_earlyDataLock;
+private:
+  std::atomic<v_int64> m_issued;
+  std::atomic<v_int64> m_accepted;
+  std::atomic<v_int64> m_rejected;
+  std::atomic<v_int64> m_expired;
+  std::atomic<v_int64> m_keyUpdates;
+  std::atomic<v_int64> m_earlyDataAdmitted;
+  std::atomic<v_int64> m_earlyDataDenied;
+public:
+
+  /**
+   * Constructor.
+   * @param lifetimeSeconds - ticket lifetime in seconds.
+   * @param updateIntervalSeconds - key rotation interval if `keyFile` is empty, key file reload interval otherwise.
+   * @param keyFile - path to the key file. Empty string to use random rotating keys.
+   */
+  SessionTickets(v_int64 lifetimeSeconds, v_int64 updateIntervalSeconds, const std::string& keyFile);
+
+  /**
+   * Non-virtual destructor.
+   */
+  ~SessionTickets();
+
+  /**
+   * Create shared SessionTickets with random keys rotated by the library.
+   * @param lifetimeSeconds - ticket lifetime in seconds. Default `43200` (12 hours).
+   * @param rotationIntervalSeconds - key rotation interval in seconds. Default `43200` (12 hours).
+   * @return - `std::shared_ptr` to SessionTickets.
+   */
+  static std::shared_ptr<SessionTickets> createShared(v_int64 lifetimeSeconds = 43200, v_int64 rotationIntervalSeconds = 43200);
+
+  /**
+   * Create shared SessionTickets with keys loaded from file.
+   * @param keyFile - path to the key file.
+   * @param lifetimeSeconds - ticket lifetime in seconds. Default `43200` (12 hours).
+   * @param reloadIntervalSeconds - key file reload interval in seconds. Default `60`.
+   * @return - `std::shared_ptr` to SessionTickets.
+   */
+  static std::shared_ptr<SessionTickets> createSharedWithKeyFile(const char* keyFile, v_int64 lifetimeSeconds = 43200, v_int64 reloadIntervalSeconds = 60);
+
+  /**
+   * Set TLS 1.3 early data anti-replay window. Ticket is admitted for early data once,
+   * and only within the window after it was issued. Used tickets are remembered until the window passes.<br>
+   * *Replays are detected per SessionTickets instance - nodes sharing a key file don't share used tickets.*
+   * Called by &id:oatpp::mbedtls::Config::setEarlyData;.
+   * @param seconds - window in seconds. `0` - don't admit early data.
+   */
+  void setEarlyDataWindow(v_int64 seconds);
+
+  /**
+   * Register session tickets callbacks in `mbedtls_ssl_config`.
+   * @param config - `mbedtls_ssl_config*`.
+   */
+  void configure(mbedtls_ssl_config* config);
+
+  /**
+   * Get tickets statistics.
+   * @return - &l:SessionTickets::Statistics;.
+   */
+  Statistics getStatistics();
+
+};
+
+}}}
+
+#endif // oatpp_mbedtls_server_SessionTickets_hpp
@@ -0,0 +1,117 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "AllocatorTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp-mbedtls/Allocator.hpp"
+
+#include "mbedtls/platform.h"
+
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+void runConnection(ConnectionFixture& fixture) {
+
+  const std::string message = "hello";
+
+  fixture.run(
+    [&message](const ConnectionHandle& connection) {
+      ConnectionFixture::readMessage(connection, message);
+    },
+    [&message](const ConnectionHandle& connection) {
+      OATPP_ASSERT(connection.object->writeExactSizeDataSimple(message.data(), message.size()) == (v_io_size) message.size());
+    }
+  );
+
+}
+
+}
+
+void AllocatorTest::onRun() {
+
+  if(!oatpp::mbedtls::Allocator::isInstalled()) {
+    OATPP_LOGD(TAG, "Allocator is not installed. Skipped.");
+    return;
+  }
+
+  {
+
+    ConnectionFixture fixture(
+      "allocator",
+      oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH),
+      oatpp::mbedtls::Config::createDefaultClientConfigShared()
+    );
+
+    /* Warm up caches of this thread and the shared pool */
+    runConnection(fixture);
+
+    auto before = oatpp::mbedtls::Allocator::getStatistics();
+
+    const v_int32 connectionsCount = 10;
+    for(v_int32 i = 0; i < connectionsCount; i ++) {
+      runConnection(fixture);
+    }
+
+    auto after = oatpp::mbedtls::Allocator::getStatistics();
+
+    v_int64 allocations = after.allocations - before.allocations;
+    v_int64 reused = (after.cacheHits - before.cacheHits) + (after.poolHits - before.poolHits);
+    v_int64 system = after.systemAllocations - before.systemAllocations;
+
+    OATPP_LOGD(TAG, "allocations=%ld, reused=%ld, system=%ld, bytesInUse=%ld, bytesPooled=%ld",
+               (long) allocations, (long) reused, (long) system, (long) after.bytesInUse, (long) after.bytesPooled);
+
+    OATPP_ASSERT(allocations > 0);
+    OATPP_ASSERT(after.frees > before.frees);
+
+    /* Once warmed up, connections mostly run on recycled blocks */
+    OATPP_ASSERT(reused > system);
+
+  }
+
+  /* Blocks above 16 KB take their size plus the 16-byte block header - they aren't rounded up */
+  const size_t recordBufferSize = 16 * 1024 + 333;
+  auto inUse = oatpp::mbedtls::Allocator::getStatistics().bytesInUse;
+  auto block = mbedtls_calloc(1, recordBufferSize);
+  OATPP_ASSERT(block != nullptr);
+  OATPP_ASSERT(oatpp::mbedtls::Allocator::getStatistics().bytesInUse - inUse == (v_int64) recordBufferSize + 16);
+  mbedtls_free(block);
+
+  /* Exact classes are taken by record buffers at install() - other large blocks go to the system heap every time */
+  for(v_int32 i = 0; i < 2; i ++) {
+    auto systemAllocations = oatpp::mbedtls::Allocator::getStatistics().systemAllocations;
+    auto largeBlock = mbedtls_calloc(1, 20 * 1024);
+    OATPP_ASSERT(largeBlock != nullptr);
+    OATPP_ASSERT(oatpp::mbedtls::Allocator::getStatistics().systemAllocations - systemAllocations == 1);
+    mbedtls_free(largeBlock);
+  }
+
+}
+
+}}}
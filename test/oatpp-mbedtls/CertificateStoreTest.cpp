@@ -0,0 +1,238 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "CertificateStoreTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp-mbedtls/Preset.hpp"
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+typedef oatpp::mbedtls::server::CertificateStore CertificateStore;
+
+std::string withLength(const std::string& data, v_int32 lengthBytes) {
+  std::string result;
+  for(v_int32 i = lengthBytes - 1; i >= 0; i --) {
+    result.push_back((char) ((data.size() >> (8 * i)) & 0xFF));
+  }
+  return result + data;
+}
+
+std::string record(const std::string& fragment) {
+  return std::string("\x16\x03\x01", 3) + withLength(fragment, 2);
+}
+
+std::string clientHello(const std::string& cipherSuites, const std::string& extensions) {
+  std::string body = std::string("\x03\x03", 2)   // legacy_version
+    + std::string(32, 'r')                       // random
+    + withLength("", 1)                          // legacy_session_id
+    + withLength(cipherSuites, 2)
+    + withLength(std::string("\x00", 1), 1)      // legacy_compression_methods
+    + withLength(extensions, 2);
+  return std::string("\x01", 1) + withLength(body, 3);
+}
+
+/* TLS_AES_128_GCM_SHA256, TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 */
+const std::string CIPHER_SUITES("\x13\x01\xC0\x2B", 4);
+
+/* signature_algorithms: ecdsa_secp256r1_sha256, rsa_pss_rsae_sha256. supported_groups: secp256r1 */
+const std::string EXTENSIONS = std::string("\x00\x0D\x00\x06\x00\x04\x04\x03\x08\x04", 10)
+                             + std::string("\x00\x0A\x00\x04\x00\x02\x00\x17", 8);
+
+bool parse(const std::string& records) {
+  CertificateStore::ClientHello hello;
+  return CertificateStore::parseClientHello(records, hello);
+}
+
+v_int64 getNameHandshakes(const std::shared_ptr<CertificateStore>& store, const std::string& name) {
+  for(auto& stats : store->getNameStatistics()) {
+    if(stats.name == name) {
+      return stats.handshakes;
+    }
+  }
+  return 0;
+}
+
+void connect(const std::shared_ptr<oatpp::mbedtls::Config>& serverConfig,
+             const std::shared_ptr<oatpp::mbedtls::Config>& clientConfig,
+             const oatpp::String& host)
+{
+
+  /* Virtual interface name is the host the client requests in SNI */
+  ConnectionFixture fixture(host, serverConfig, clientConfig);
+
+  fixture.run([](const ConnectionHandle& connection) {
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_ASSERT(c->getHandshakeResult() == 0);
+  });
+
+}
+
+}
+
+void CertificateStoreTest::onRun() {
+
+  {
+
+    OATPP_LOGD(TAG, "ClientHello parser...");
+
+    auto message = clientHello(CIPHER_SUITES, EXTENSIONS);
+
+    CertificateStore::ClientHello hello;
+    OATPP_ASSERT(CertificateStore::parseClientHello(record(message), hello));
+    OATPP_ASSERT(hello.cipherSuites.size() == 2 && hello.cipherSuites[1] == 0xC02B);
+    OATPP_ASSERT(hello.signatureAlgorithms.size() == 2 && hello.signatureAlgorithms[0] == 0x0403);
+    OATPP_ASSERT(hello.groups.size() == 1 && hello.groups[0] == 0x0017);
+
+    /* Message fragmented over two records */
+    CertificateStore::ClientHello fragmented;
+    OATPP_ASSERT(CertificateStore::parseClientHello(record(message.substr(0, 20)) + record(message.substr(20)), fragmented));
+    OATPP_ASSERT(fragmented.signatureAlgorithms == hello.signatureAlgorithms);
+
+    /* Truncated record, and truncated message in a complete record */
+    auto records = record(message);
+    for(size_t size = 0; size < records.size(); size ++) {
+      OATPP_ASSERT(!parse(records.substr(0, size)));
+    }
+    for(size_t size = 0; size < message.size(); size ++) {
+      OATPP_ASSERT(!parse(record(message.substr(0, size))));
+    }
+
+    /* Not a ClientHello */
+    OATPP_ASSERT(!parse(record("\x02" + message.substr(1))));
+    OATPP_ASSERT(!parse(std::string("\x17\x03\x03", 3) + withLength(message, 2)));
+
+    /* Message length is larger than the message */
+    auto longer = message;
+    longer[3] = (char) (longer[3] + 1);
+    OATPP_ASSERT(!parse(record(longer)));
+
+    /* Odd-length cipher suites */
+    OATPP_ASSERT(!parse(record(clientHello(CIPHER_SUITES.substr(0, 3), EXTENSIONS))));
+
+    /* Extension longer than the extensions block */
+    OATPP_ASSERT(!parse(record(clientHello(CIPHER_SUITES, std::string("\x00\x0D\x00\x10\x00\x04\x04\x03\x08\x04", 10)))));
+
+    /* List longer than its extension */
+    OATPP_ASSERT(!parse(record(clientHello(CIPHER_SUITES, std::string("\x00\x0D\x00\x06\x00\x08\x04\x03\x08\x04", 10)))));
+
+    /* Odd-length list */
+    OATPP_ASSERT(!parse(record(clientHello(CIPHER_SUITES, std::string("\x00\x0A\x00\x05\x00\x03\x00\x17\x00", 9)))));
+
+  }
+
+  auto store = oatpp::mbedtls::server::CertificateStore::createShared();
+  store->addCertificate(CERT_CRT_PATH, CERT_PEM_PATH, nullptr, {"www.example.test"});
+  store->addCertificate(CERT_CRT_PATH, CERT_PEM_PATH, nullptr, {"*.customer.test"});
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(store);
+  auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+
+  connect(serverConfig, clientConfig, "www.example.test");
+  connect(serverConfig, clientConfig, "API.Customer.test");
+  connect(serverConfig, clientConfig, "a.b.customer.test"); // wildcard covers one label only
+  connect(serverConfig, clientConfig, "unknown.test");
+
+  auto stats = store->getStatistics();
+  OATPP_LOGD(TAG, "exact=%d, wildcard=%d, default=%d", (v_int32) stats.exactMatches, (v_int32) stats.wildcardMatches, (v_int32) stats.defaultFallbacks);
+
+  OATPP_ASSERT(stats.exactMatches == 1);
+  OATPP_ASSERT(stats.wildcardMatches == 1);
+  OATPP_ASSERT(stats.defaultFallbacks == 2);
+
+  for(auto& name : store->getNameStatistics()) {
+    OATPP_LOGD(TAG, "'%s' - %d handshakes", name.name.c_str(), (v_int32) name.handshakes);
+    OATPP_ASSERT(name.handshakes == 1);
+  }
+
+  OATPP_ASSERT(stats.ecdsaHandshakes == 0);
+  OATPP_ASSERT(stats.rsaHandshakes == 4);
+
+  {
+
+    /* ECDSA and RSA certificates for the same name */
+    auto dualStore = oatpp::mbedtls::server::CertificateStore::createShared();
+    dualStore->addCertificate(CERT_CRT_PATH, CERT_PEM_PATH, nullptr, {"dual.example.test"});
+    dualStore->addCertificate(ECDSA_CERT_CRT_PATH, ECDSA_CERT_PEM_PATH, nullptr, {"dual.example.test"});
+    OATPP_ASSERT(dualStore->hasKeyAlternatives());
+
+    auto dualServerConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(dualStore);
+
+    /* Legacy client - RSA signatures only */
+    static const uint16_t rsaSignatures[] = {
+      MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA256,
+      MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA256,
+      MBEDTLS_TLS1_3_SIG_NONE
+    };
+    auto rsaClientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+    mbedtls_ssl_conf_sig_algs(rsaClientConfig->getTLSConfig(), rsaSignatures);
+
+    connect(dualServerConfig, clientConfig, "dual.example.test");
+    connect(dualServerConfig, clientConfig, "no-such-name.test");
+    connect(dualServerConfig, rsaClientConfig, "dual.example.test");
+
+    /* ClientHello is captured from the bytes served to Mbed TLS, not from the transport reads */
+    auto readAheadServerConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(dualStore);
+    readAheadServerConfig->setReadAheadSize(16 * 1024);
+    connect(readAheadServerConfig, clientConfig, "dual.example.test");
+
+    auto dualStats = dualStore->getStatistics();
+    OATPP_LOGD(TAG, "ecdsa=%d, rsa=%d", (v_int32) dualStats.ecdsaHandshakes, (v_int32) dualStats.rsaHandshakes);
+
+    OATPP_ASSERT(dualStats.ecdsaHandshakes == 3);
+    OATPP_ASSERT(dualStats.rsaHandshakes == 1);
+
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+
+    /* Client's key share is for a group the server doesn't support - server sends HelloRetryRequest */
+    oatpp::mbedtls::Preset serverGroups;
+    serverGroups.addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1);
+    auto retryServerConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(dualStore);
+    retryServerConfig->setPreset(serverGroups);
+
+    oatpp::mbedtls::Preset clientGroups;
+    clientGroups.addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1).addGroup(MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1);
+    auto retryClientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+    retryClientConfig->setPreset(clientGroups);
+
+    auto nameHandshakes = getNameHandshakes(dualStore, "dual.example.test");
+    connect(retryServerConfig, retryClientConfig, "dual.example.test");
+
+    /* Second ClientHello gets the same certificate - the handshake is counted once */
+    auto retryStats = dualStore->getStatistics();
+    OATPP_LOGD(TAG, "after HelloRetryRequest: ecdsa=%d, rsa=%d", (v_int32) retryStats.ecdsaHandshakes, (v_int32) retryStats.rsaHandshakes);
+    OATPP_ASSERT(retryStats.ecdsaHandshakes == 4);
+    OATPP_ASSERT(retryStats.rsaHandshakes == 1);
+    OATPP_ASSERT(getNameHandshakes(dualStore, "dual.example.test") == nameHandshakes + 1);
+
+#endif
+
+  }
+
+}
+
+}}}
@@ -0,0 +1,149 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ConfigReloadTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp-mbedtls/server/CertificateWatcher.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+const char* const WATCHED_CRT_PATH = "config-reload-test.crt";
+const char* const WATCHED_PEM_PATH = "config-reload-test.pem";
+
+void copyFile(const char* from, const char* to, const char* suffix) {
+  std::ifstream in(from, std::ios::binary);
+  OATPP_ASSERT(in.good());
+  std::stringstream data;
+  data << in.rdbuf();
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << data.str() << suffix;
+}
+
+v_int64 getHandshakes(const std::shared_ptr<oatpp::mbedtls::Config>& config) {
+  auto stats = config->getProtocolStatistics();
+  return stats.tls12Handshakes + stats.tls13Handshakes;
+}
+
+}
+
+void ConfigReloadTest::onRun() {
+
+  auto configA = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  auto configB = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+
+  ConnectionFixture fixture("config-reload", configA, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+  auto serverProvider = fixture.getServerProvider();
+
+  {
+
+    ConnectionHandle server1, client1;
+    fixture.connect(server1, client1);
+
+    /* Swap config while the 1st connection is open */
+    serverProvider->setConfig(configB);
+    OATPP_ASSERT(serverProvider->getConfig() == configB);
+
+    ConnectionHandle server2, client2;
+    fixture.connect(server2, client2);
+
+    /* Old connection keeps its config and still works */
+    ConnectionFixture::exchange(server1, client1);
+    ConnectionFixture::exchange(server2, client2);
+
+    OATPP_ASSERT(getHandshakes(configA) == 1);
+    OATPP_ASSERT(getHandshakes(configB) == 1);
+
+    ConnectionFixture::invalidate(client1);
+    ConnectionFixture::invalidate(server1);
+    ConnectionFixture::invalidate(client2);
+    ConnectionFixture::invalidate(server2);
+
+  }
+
+  {
+
+    copyFile(CERT_CRT_PATH, WATCHED_CRT_PATH, "");
+    copyFile(CERT_PEM_PATH, WATCHED_PEM_PATH, "");
+
+    auto watcher = oatpp::mbedtls::server::CertificateWatcher::createShared(
+      serverProvider,
+      {WATCHED_CRT_PATH, WATCHED_PEM_PATH},
+      [] { return oatpp::mbedtls::Config::createDefaultServerConfigShared(WATCHED_CRT_PATH, WATCHED_PEM_PATH); }
+    );
+
+    OATPP_ASSERT(watcher->check() == false);
+
+    /* Rewrite certificate - size changes so the change is visible even with coarse modification times */
+    copyFile(CERT_CRT_PATH, WATCHED_CRT_PATH, "\n");
+
+    /* Watcher thread may have already picked up the change */
+    watcher->check();
+    OATPP_ASSERT(watcher->getStatistics().reloads == 1);
+    OATPP_ASSERT(watcher->getStatistics().failures == 0);
+
+    auto reloaded = serverProvider->getConfig();
+    OATPP_ASSERT(reloaded != configB);
+
+    ConnectionHandle server3, client3;
+    fixture.connect(server3, client3);
+    ConnectionFixture::exchange(server3, client3);
+
+    OATPP_ASSERT(getHandshakes(reloaded) == 1);
+
+    ConnectionFixture::invalidate(client3);
+    ConnectionFixture::invalidate(server3);
+
+    /* Broken key - old config is kept, and the same files are not loaded again on every poll */
+    copyFile(CERT_CRT_PATH, WATCHED_PEM_PATH, "");
+    OATPP_ASSERT(watcher->check() == false);
+    auto failures = watcher->getStatistics().failures;
+    OATPP_ASSERT(failures >= 1);
+    OATPP_ASSERT(watcher->check() == false);
+    OATPP_ASSERT(watcher->getStatistics().failures == failures);
+    OATPP_ASSERT(serverProvider->getConfig() == reloaded);
+
+    /* Fixed key is picked up */
+    copyFile(CERT_PEM_PATH, WATCHED_PEM_PATH, "\n");
+    watcher->check();
+    OATPP_ASSERT(watcher->getStatistics().reloads == 2);
+    OATPP_ASSERT(serverProvider->getConfig() != reloaded);
+
+    watcher->stop();
+
+  }
+
+  std::remove(WATCHED_CRT_PATH);
+  std::remove(WATCHED_PEM_PATH);
+
+}
+
+}}}
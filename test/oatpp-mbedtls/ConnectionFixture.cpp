@@ -0,0 +1,424 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp/network/virtual_/client/ConnectionProvider.hpp"
+#include "oatpp/network/virtual_/server/ConnectionProvider.hpp"
+
+#include <thread>
+#include <chrono>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+constexpr v_int32 STATE_RUNNING = 0;
+constexpr v_int32 STATE_FINISHED = 1;
+constexpr v_int32 STATE_FAILED = 2;
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionFixture::AsyncConnection
+
+class ConnectionFixture::AsyncConnection::GetCoroutine : public oatpp::async::Coroutine<GetCoroutine> {
+private:
+  AsyncConnection* m_result;
+  Starter m_starter;
+public:
+
+  GetCoroutine(AsyncConnection* result, const Starter& starter)
+    : m_result(result)
+    , m_starter(starter)
+  {}
+
+  Action act() override {
+    return m_starter().callbackTo(&GetCoroutine::onConnection);
+  }
+
+  Action onConnection(const ConnectionHandle& connection) {
+    m_result->m_connection = connection;
+    m_result->m_state = STATE_FINISHED;
+    return finish();
+  }
+
+  Action handleError(Error* error) override {
+    m_result->m_state = STATE_FAILED;
+    return error;
+  }
+
+};
+
+ConnectionFixture::AsyncConnection::AsyncConnection(oatpp::async::Executor& executor, const Starter& starter)
+  : m_state(STATE_RUNNING)
+{
+  executor.execute<GetCoroutine>(this, starter);
+}
+
+bool ConnectionFixture::AsyncConnection::isRunning() const {
+  return m_state == STATE_RUNNING;
+}
+
+bool ConnectionFixture::AsyncConnection::wait(v_int64 timeoutMilliseconds) {
+  auto startTick = oatpp::base::Environment::getMicroTickCount();
+  while(m_state == STATE_RUNNING && oatpp::base::Environment::getMicroTickCount() - startTick < timeoutMilliseconds * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  OATPP_ASSERT(m_state != STATE_RUNNING);
+  return m_state == STATE_FINISHED;
+}
+
+ConnectionHandle ConnectionFixture::AsyncConnection::getConnection() const {
+  return m_connection;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionFixture::Transport
+
+ConnectionFixture::Transport::Transport(const ConnectionHandle& stream)
+  : m_stream(stream)
+  , m_reads(0)
+  , m_writes(0)
+  , m_maxWriteSize(0)
+  , m_records(0)
+  , m_recordHeaderPosition(0)
+  , m_recordRemaining(0)
+  , m_readsHeld(false)
+  , m_readWaiting(false)
+{}
+
+void ConnectionFixture::Transport::invalidate() {
+  releaseReads();
+  m_stream.invalidator->invalidate(m_stream.object);
+}
+
+void ConnectionFixture::Transport::holdReads() {
+  std::lock_guard<std::mutex> lock(m_holdLock);
+  m_readsHeld = true;
+}
+
+void ConnectionFixture::Transport::releaseReads() {
+  {
+    std::lock_guard<std::mutex> lock(m_holdLock);
+    m_readsHeld = false;
+  }
+  m_holdCondition.notify_all();
+}
+
+bool ConnectionFixture::Transport::waitReadHeld(v_int64 timeoutMilliseconds) {
+  std::unique_lock<std::mutex> lock(m_holdLock);
+  return m_holdCondition.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this] { return m_readWaiting; });
+}
+
+void ConnectionFixture::Transport::countRecords(const v_uint8* data, v_buff_size size) {
+  std::lock_guard<std::mutex> lock(m_recordsLock);
+  v_buff_size position = 0;
+  while(position < size) {
+    if(m_recordRemaining > 0) {
+      v_buff_size chunk = size - position < m_recordRemaining ? size - position : (v_buff_size) m_recordRemaining;
+      m_recordRemaining -= chunk;
+      position += chunk;
+      continue;
+    }
+    /* Record header: type, version, 2-byte length */
+    m_recordHeader[m_recordHeaderPosition ++] = data[position ++];
+    if(m_recordHeaderPosition == sizeof(m_recordHeader)) {
+      m_recordRemaining = ((v_int64) m_recordHeader[3] << 8) | m_recordHeader[4];
+      m_recordHeaderPosition = 0;
+      ++ m_records;
+    }
+  }
+}
+
+v_int64 ConnectionFixture::Transport::getReadsCount() {
+  return m_reads;
+}
+
+v_int64 ConnectionFixture::Transport::getWritesCount() {
+  return m_writes;
+}
+
+v_int64 ConnectionFixture::Transport::getMaxWriteSize() {
+  return m_maxWriteSize;
+}
+
+v_int64 ConnectionFixture::Transport::getRecordsCount() {
+  std::lock_guard<std::mutex> lock(m_recordsLock);
+  return m_records;
+}
+
+v_io_size ConnectionFixture::Transport::write(const void *data, v_buff_size count, async::Action& action) {
+
+  auto bytes = static_cast<const v_uint8*>(data);
+
+  v_buff_size written = 0;
+  while(written < count) {
+    auto res = m_stream.object->write(bytes + written, count - written, action);
+    if(res <= 0) {
+      if(written == 0) {
+        return res;
+      }
+      break;
+    }
+    written += res;
+    if(!action.isNone()) {
+      break;
+    }
+  }
+
+  ++ m_writes;
+  v_int64 maxWriteSize = m_maxWriteSize;
+  while(written > maxWriteSize && !m_maxWriteSize.compare_exchange_weak(maxWriteSize, written)) {}
+
+  countRecords(bytes, written);
+
+  return written;
+
+}
+
+v_io_size ConnectionFixture::Transport::read(void *buff, v_buff_size count, async::Action& action) {
+
+  {
+    std::unique_lock<std::mutex> lock(m_holdLock);
+    if(m_readsHeld) {
+      m_readWaiting = true;
+      m_holdCondition.notify_all();
+      m_holdCondition.wait(lock, [this] { return !m_readsHeld; });
+      m_readWaiting = false;
+    }
+  }
+
+  auto res = m_stream.object->read(buff, count, action);
+  if(res > 0) {
+    ++ m_reads;
+  }
+
+  return res;
+
+}
+
+void ConnectionFixture::Transport::setOutputStreamIOMode(data::stream::IOMode ioMode) {
+  m_stream.object->setOutputStreamIOMode(ioMode);
+}
+
+data::stream::IOMode ConnectionFixture::Transport::getOutputStreamIOMode() {
+  return m_stream.object->getOutputStreamIOMode();
+}
+
+data::stream::Context& ConnectionFixture::Transport::getOutputStreamContext() {
+  return m_stream.object->getOutputStreamContext();
+}
+
+void ConnectionFixture::Transport::setInputStreamIOMode(data::stream::IOMode ioMode) {
+  m_stream.object->setInputStreamIOMode(ioMode);
+}
+
+data::stream::IOMode ConnectionFixture::Transport::getInputStreamIOMode() {
+  return m_stream.object->getInputStreamIOMode();
+}
+
+data::stream::Context& ConnectionFixture::Transport::getInputStreamContext() {
+  return m_stream.object->getInputStreamContext();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionFixture::TransportInvalidator
+
+class ConnectionFixture::TransportInvalidator : public provider::Invalidator<data::stream::IOStream> {
+public:
+  void invalidate(const std::shared_ptr<data::stream::IOStream>& connection) override {
+    std::static_pointer_cast<Transport>(connection)->invalidate();
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionFixture::TransportProvider
+
+/*
+ * Wraps streams of the underlying provider with ConnectionFixture::Transport.
+ */
+class ConnectionFixture::TransportProvider : public oatpp::network::ServerConnectionProvider {
+private:
+
+  static ConnectionHandle wrap(const ConnectionHandle& stream, const std::shared_ptr<TransportInvalidator>& invalidator) {
+    if(!stream) {
+      return nullptr;
+    }
+    return ConnectionHandle(std::make_shared<Transport>(stream), invalidator);
+  }
+
+private:
+  std::shared_ptr<oatpp::network::ServerConnectionProvider> m_streamProvider;
+  std::shared_ptr<TransportInvalidator> m_invalidator;
+public:
+
+  TransportProvider(const std::shared_ptr<oatpp::network::ServerConnectionProvider>& streamProvider)
+    : m_streamProvider(streamProvider)
+    , m_invalidator(std::make_shared<TransportInvalidator>())
+  {
+    setProperty(PROPERTY_HOST, streamProvider->getProperty(PROPERTY_HOST).toString());
+    setProperty(PROPERTY_PORT, streamProvider->getProperty(PROPERTY_PORT).toString());
+  }
+
+  ConnectionHandle get() override {
+    return wrap(m_streamProvider->get(), m_invalidator);
+  }
+
+  oatpp::async::CoroutineStarterForResult<const ConnectionHandle&> getAsync() override {
+
+    class WrapCoroutine : public oatpp::async::CoroutineWithResult<WrapCoroutine, const ConnectionHandle&> {
+    private:
+      std::shared_ptr<oatpp::network::ServerConnectionProvider> m_streamProvider;
+      std::shared_ptr<TransportInvalidator> m_invalidator;
+    public:
+
+      WrapCoroutine(const std::shared_ptr<oatpp::network::ServerConnectionProvider>& streamProvider,
+                    const std::shared_ptr<TransportInvalidator>& invalidator)
+        : m_streamProvider(streamProvider)
+        , m_invalidator(invalidator)
+      {}
+
+      Action act() override {
+        return m_streamProvider->getAsync().callbackTo(&WrapCoroutine::onStream);
+      }
+
+      Action onStream(const ConnectionHandle& stream) {
+        return _return(wrap(stream, m_invalidator));
+      }
+
+    };
+
+    return WrapCoroutine::startForResult(m_streamProvider, m_invalidator);
+
+  }
+
+  void stop() override {
+    m_streamProvider->stop();
+  }
+
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ConnectionFixture
+
+ConnectionFixture::ConnectionFixture(const oatpp::String& interfaceName,
+                                     const std::shared_ptr<oatpp::mbedtls::Config>& serverConfig,
+                                     const std::shared_ptr<oatpp::mbedtls::Config>& clientConfig,
+                                     bool wrapServerTransport)
+  : m_interface(oatpp::network::virtual_::Interface::obtainShared(interfaceName))
+  , m_clientProvider(oatpp::mbedtls::client::ConnectionProvider::createShared(
+      clientConfig,
+      oatpp::network::virtual_::client::ConnectionProvider::createShared(m_interface)
+    ))
+{
+
+  std::shared_ptr<oatpp::network::ServerConnectionProvider> streamProvider =
+    oatpp::network::virtual_::server::ConnectionProvider::createShared(m_interface);
+
+  if(wrapServerTransport) {
+    streamProvider = std::make_shared<TransportProvider>(streamProvider);
+  }
+
+  m_serverProvider = oatpp::mbedtls::server::ConnectionProvider::createShared(serverConfig, streamProvider);
+
+}
+
+ConnectionFixture::~ConnectionFixture() {
+  m_serverProvider->stop();
+}
+
+std::shared_ptr<oatpp::network::virtual_::Interface> ConnectionFixture::getInterface() const {
+  return m_interface;
+}
+
+std::shared_ptr<oatpp::mbedtls::server::ConnectionProvider> ConnectionFixture::getServerProvider() const {
+  return m_serverProvider;
+}
+
+std::shared_ptr<oatpp::mbedtls::client::ConnectionProvider> ConnectionFixture::getClientProvider() const {
+  return m_clientProvider;
+}
+
+void ConnectionFixture::connect(ConnectionHandle& serverConnection,
+                                ConnectionHandle& clientConnection,
+                                const Handler& serverHandler,
+                                const Handler& clientHandler)
+{
+
+  std::thread serverThread([this, &serverConnection, &serverHandler] {
+    serverConnection = m_serverProvider->get();
+    OATPP_ASSERT(serverConnection);
+    serverConnection.object->initContexts();
+    if(serverHandler) {
+      serverHandler(serverConnection);
+    }
+  });
+
+  clientConnection = m_clientProvider->get();
+  OATPP_ASSERT(clientConnection);
+  if(clientHandler) {
+    clientHandler(clientConnection);
+  }
+
+  serverThread.join();
+
+}
+
+void ConnectionFixture::run(const Handler& serverHandler, const Handler& clientHandler) {
+  ConnectionHandle serverConnection, clientConnection;
+  connect(serverConnection, clientConnection, serverHandler, clientHandler);
+  invalidate(clientConnection);
+  invalidate(serverConnection);
+}
+
+void ConnectionFixture::readMessage(const ConnectionHandle& connection, const std::string& message) {
+  std::string received(message.size(), '\0');
+  OATPP_ASSERT(connection.object->readExactSizeDataSimple(&received[0], received.size()) == (v_io_size) received.size());
+  OATPP_ASSERT(received == message);
+}
+
+void ConnectionFixture::exchange(const ConnectionHandle& serverConnection, const ConnectionHandle& clientConnection) {
+
+  v_char8 b = 'x';
+  OATPP_ASSERT(clientConnection.object->writeExactSizeDataSimple(&b, 1) == 1);
+
+  v_char8 received = 0;
+  OATPP_ASSERT(serverConnection.object->readExactSizeDataSimple(&received, 1) == 1);
+  OATPP_ASSERT(received == b);
+
+}
+
+std::shared_ptr<ConnectionFixture::Transport> ConnectionFixture::getTransport(const ConnectionHandle& connection) {
+  auto transport = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object)->getTransportStream();
+  return std::static_pointer_cast<Transport>(transport.object);
+}
+
+void ConnectionFixture::invalidate(const ConnectionHandle& connection) {
+  if(connection) {
+    connection.invalidator->invalidate(connection.object);
+  }
+}
+
+}}}
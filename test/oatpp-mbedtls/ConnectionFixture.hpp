@@ -0,0 +1,290 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_test_mbedtls_ConnectionFixture_hpp
+#define oatpp_test_mbedtls_ConnectionFixture_hpp
+
+#include "oatpp-mbedtls/client/ConnectionProvider.hpp"
+#include "oatpp-mbedtls/server/ConnectionProvider.hpp"
+
+#include "oatpp/network/virtual_/Interface.hpp"
+#include "oatpp/core/async/Executor.hpp"
+
+#include <functional>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+typedef provider::ResourceHandle<data::stream::IOStream> ConnectionHandle;
+
+/**
+ * TLS server and client providers connected through a virtual interface. <br>
+ * Server provider is stopped when the fixture is destroyed.
+ */
+class ConnectionFixture {
+public:
+
+  /**
+   * Handler of an established connection.
+   */
+  typedef std::function<void(const ConnectionHandle&)> Handler;
+
+  /**
+   * Connection obtained by a coroutine on an executor. Ex.: by provider's `getAsync()`.<br>
+   * Must outlive the coroutine - call &l:ConnectionFixture::AsyncConnection::wait (); before it's destroyed.
+   */
+  class AsyncConnection {
+  public:
+
+    /**
+     * Starts the coroutine which obtains the connection.
+     */
+    typedef std::function<oatpp::async::CoroutineStarterForResult<const ConnectionHandle&>()> Starter;
+
+  private:
+    class GetCoroutine;
+  private:
+    std::atomic<v_int32> m_state;
+    ConnectionHandle m_connection;
+  public:
+
+    /**
+     * Constructor. Starts the coroutine.
+     * @param executor - &id:oatpp::async::Executor;.
+     * @param starter - &l:ConnectionFixture::AsyncConnection::Starter;.
+     */
+    AsyncConnection(oatpp::async::Executor& executor, const Starter& starter);
+
+    /**
+     * Check if the coroutine is still running.
+     * @return - `true` if running.
+     */
+    bool isRunning() const;
+
+    /**
+     * Wait for the coroutine to finish.
+     * @param timeoutMilliseconds - max time to wait.
+     * @return - `true` if connection was obtained, `false` if the coroutine ended with an error.
+     */
+    bool wait(v_int64 timeoutMilliseconds = 10000);
+
+    /**
+     * Get the obtained connection.
+     * @return - &l:ConnectionHandle;.
+     */
+    ConnectionHandle getConnection() const;
+
+  };
+
+  /**
+   * Wrapper of the server transport stream. See `wrapServerTransport` parameter of the fixture constructor.<br>
+   * Reads may be held - a thread which reads from the held transport blocks until reads are released.
+   * Use it to stall a TLS connection inside Mbed TLS on a transport read. *Blocking I/O only.*<br>
+   * Reads and writes are counted, and TLS records in the written data. Each write passes all of its data to the transport,
+   * so writes are counted as the TLS connection issues them - not as the virtual pipe splits them.
+   */
+  class Transport : public oatpp::base::Countable, public data::stream::IOStream {
+  private:
+    void countRecords(const v_uint8* data, v_buff_size size);
+  private:
+    ConnectionHandle m_stream;
+  private:
+    std::atomic<v_int64> m_reads;
+    std::atomic<v_int64> m_writes;
+    std::atomic<v_int64> m_maxWriteSize;
+    std::mutex m_recordsLock;
+    v_int64 m_records;
+    v_uint8 m_recordHeader[5];
+    v_int32 m_recordHeaderPosition;
+    v_int64 m_recordRemaining;
+  private:
+    std::mutex m_holdLock;
+    std::condition_variable m_holdCondition;
+    bool m_readsHeld;
+    bool m_readWaiting;
+  public:
+
+    /**
+     * Constructor.
+     * @param stream - underlying transport stream.
+     */
+    Transport(const ConnectionHandle& stream);
+
+    /**
+     * Invalidate underlying transport stream. Releases held reads.
+     */
+    void invalidate();
+
+    /**
+     * Hold reads - next reads block until &l:ConnectionFixture::Transport::releaseReads (); is called.
+     */
+    void holdReads();
+
+    /**
+     * Release held reads.
+     */
+    void releaseReads();
+
+    /**
+     * Wait until a read is blocked by the hold.
+     * @param timeoutMilliseconds - max time to wait.
+     * @return - `true` if a read is blocked.
+     */
+    bool waitReadHeld(v_int64 timeoutMilliseconds = 10000);
+
+    /**
+     * Get number of reads.
+     * @return - number of reads which got data from the transport.
+     */
+    v_int64 getReadsCount();
+
+    /**
+     * Get number of writes.
+     * @return - number of writes which passed data to the transport.
+     */
+    v_int64 getWritesCount();
+
+    /**
+     * Get size of the largest write.
+     * @return - size in bytes.
+     */
+    v_int64 getMaxWriteSize();
+
+    /**
+     * Get number of TLS records written, handshake records included.
+     * @return - number of records.
+     */
+    v_int64 getRecordsCount();
+
+    v_io_size write(const void *data, v_buff_size count, async::Action& action) override;
+    v_io_size read(void *buff, v_buff_size count, async::Action& action) override;
+
+    void setOutputStreamIOMode(data::stream::IOMode ioMode) override;
+    data::stream::IOMode getOutputStreamIOMode() override;
+    data::stream::Context& getOutputStreamContext() override;
+
+    void setInputStreamIOMode(data::stream::IOMode ioMode) override;
+    data::stream::IOMode getInputStreamIOMode() override;
+    data::stream::Context& getInputStreamContext() override;
+
+  };
+
+private:
+  class TransportProvider;
+  class TransportInvalidator;
+private:
+  std::shared_ptr<oatpp::network::virtual_::Interface> m_interface;
+  std::shared_ptr<oatpp::mbedtls::server::ConnectionProvider> m_serverProvider;
+  std::shared_ptr<oatpp::mbedtls::client::ConnectionProvider> m_clientProvider;
+public:
+
+  /**
+   * Constructor.
+   * @param interfaceName - name of the virtual interface.
+   * @param serverConfig - server &id:oatpp::mbedtls::Config;.
+   * @param clientConfig - client &id:oatpp::mbedtls::Config;.
+   * @param wrapServerTransport - `true` to wrap transport streams of server connections with &l:ConnectionFixture::Transport;.
+   */
+  ConnectionFixture(const oatpp::String& interfaceName,
+                    const std::shared_ptr<oatpp::mbedtls::Config>& serverConfig,
+                    const std::shared_ptr<oatpp::mbedtls::Config>& clientConfig,
+                    bool wrapServerTransport = false);
+
+  /**
+   * Non virtual destructor. Stops server provider.
+   */
+  ~ConnectionFixture();
+
+  /**
+   * Get virtual interface.
+   * @return - `std::shared_ptr` to &id:oatpp::network::virtual_::Interface;.
+   */
+  std::shared_ptr<oatpp::network::virtual_::Interface> getInterface() const;
+
+  /**
+   * Get server provider.
+   * @return - `std::shared_ptr` to &id:oatpp::mbedtls::server::ConnectionProvider;.
+   */
+  std::shared_ptr<oatpp::mbedtls::server::ConnectionProvider> getServerProvider() const;
+
+  /**
+   * Get client provider.
+   * @return - `std::shared_ptr` to &id:oatpp::mbedtls::client::ConnectionProvider;.
+   */
+  std::shared_ptr<oatpp::mbedtls::client::ConnectionProvider> getClientProvider() const;
+
+  /**
+   * Accept connection and run the server handshake on a separate thread, while the client connects on this thread.
+   * @param serverConnection - accepted connection. Handshake is done.
+   * @param clientConnection - client connection. Handshake is done.
+   * @param serverHandler - called on the server thread after the handshake. May be `nullptr`.
+   * @param clientHandler - called on this thread after the client connects, before the server thread is joined. May be `nullptr`.
+   */
+  void connect(ConnectionHandle& serverConnection,
+               ConnectionHandle& clientConnection,
+               const Handler& serverHandler = nullptr,
+               const Handler& clientHandler = nullptr);
+
+  /**
+   * Connect, run handlers, and invalidate both connections.
+   * @param serverHandler - called on the server thread after the handshake. May be `nullptr`.
+   * @param clientHandler - called on this thread after the client connects. May be `nullptr`.
+   */
+  void run(const Handler& serverHandler = nullptr, const Handler& clientHandler = nullptr);
+
+  /**
+   * Read exactly `message.size()` bytes and assert they are equal to `message`.
+   * @param connection - connection to read from.
+   * @param message - expected message.
+   */
+  static void readMessage(const ConnectionHandle& connection, const std::string& message);
+
+  /**
+   * Write one byte from client to server and check it's received.
+   * @param serverConnection
+   * @param clientConnection
+   */
+  static void exchange(const ConnectionHandle& serverConnection, const ConnectionHandle& clientConnection);
+
+  /**
+   * Get transport wrapper of server connection. Fixture must be created with `wrapServerTransport = true`.
+   * @param connection - server connection.
+   * @return - &l:ConnectionFixture::Transport;.
+   */
+  static std::shared_ptr<Transport> getTransport(const ConnectionHandle& connection);
+
+  /**
+   * Invalidate connection if it's set.
+   * @param connection
+   */
+  static void invalidate(const ConnectionHandle& connection);
+
+};
+
+}}}
+
+#endif /* oatpp_test_mbedtls_ConnectionFixture_hpp */
@@ -0,0 +1,160 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ConnectionPoolTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp-mbedtls/client/ConnectionPool.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void ConnectionPoolTest::onRun() {
+
+  ConnectionFixture fixture(
+    "connection-pool",
+    oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH),
+    oatpp::mbedtls::Config::createDefaultClientConfigShared()
+  );
+
+  auto serverProvider = fixture.getServerProvider();
+  auto pool = oatpp::mbedtls::client::ConnectionPool::createShared(fixture.getClientProvider());
+
+  ConnectionHandle serverConnection;
+  std::thread serverThread([&serverProvider, &serverConnection] {
+    serverConnection = serverProvider->get();
+    OATPP_ASSERT(serverConnection);
+    serverConnection.object->initContexts();
+  });
+
+  {
+    auto connection = pool->get();
+    OATPP_ASSERT(connection);
+  } // released to the pool
+
+  serverThread.join();
+
+  {
+    auto connection = pool->get();
+    OATPP_ASSERT(connection);
+    auto stats = pool->getStatistics();
+    OATPP_ASSERT(stats.created == 1);
+    OATPP_ASSERT(stats.reused == 1);
+  } // released to the pool
+
+  /* Peer closes idle connection - it must not be reused */
+  ConnectionFixture::invalidate(serverConnection);
+  serverConnection = nullptr;
+
+  serverThread = std::thread([&serverProvider, &serverConnection] {
+    serverConnection = serverProvider->get();
+    OATPP_ASSERT(serverConnection);
+    serverConnection.object->initContexts();
+  });
+
+  {
+    auto connection = pool->get();
+    OATPP_ASSERT(connection);
+    auto stats = pool->getStatistics();
+    OATPP_ASSERT(stats.created == 2);
+    OATPP_ASSERT(stats.dead == 1);
+    connection.invalidator->invalidate(connection.object); // invalidated - not returned to the pool
+  }
+
+  serverThread.join();
+
+  auto stats = pool->getStatistics();
+  OATPP_LOGD(TAG, "created=%d, reused=%d, expired=%d, dead=%d, idle=%d",
+             (v_int32) stats.created, (v_int32) stats.reused, (v_int32) stats.expired, (v_int32) stats.dead, (v_int32) stats.idle);
+  OATPP_ASSERT(stats.idle == 0);
+
+  ConnectionFixture::invalidate(serverConnection);
+
+  pool->stop();
+
+  {
+
+    OATPP_LOGD(TAG, "Reuse with read timeout...");
+
+    auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+    clientConfig->setReadTimeout(100);
+
+    ConnectionFixture timeoutFixture(
+      "connection-pool-read-timeout",
+      oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH),
+      clientConfig
+    );
+
+    auto timeoutServerProvider = timeoutFixture.getServerProvider();
+    auto timeoutPool = oatpp::mbedtls::client::ConnectionPool::createShared(timeoutFixture.getClientProvider());
+
+    ConnectionHandle timeoutServerConnection;
+    std::thread timeoutServerThread([&timeoutServerProvider, &timeoutServerConnection] {
+      timeoutServerConnection = timeoutServerProvider->get();
+      OATPP_ASSERT(timeoutServerConnection);
+      timeoutServerConnection.object->initContexts();
+    });
+
+    {
+      auto connection = timeoutPool->get();
+      OATPP_ASSERT(connection);
+    } // released to the pool
+
+    timeoutServerThread.join();
+
+    {
+      auto connection = timeoutPool->get(); // probed
+      OATPP_ASSERT(connection);
+    } // released to the pool
+
+    /* Probe must not leave the read deadline armed - idle connection outlives the read timeout */
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    {
+      auto connection = timeoutPool->get();
+      OATPP_ASSERT(connection);
+      auto timeoutStats = timeoutPool->getStatistics();
+      OATPP_ASSERT(timeoutStats.created == 1);
+      OATPP_ASSERT(timeoutStats.reused == 2);
+      OATPP_ASSERT(timeoutStats.dead == 0);
+
+      v_char8 buffer[4];
+      OATPP_ASSERT(connection.object->writeExactSizeDataSimple("ping", 4) == 4);
+      OATPP_ASSERT(timeoutServerConnection.object->readExactSizeDataSimple(buffer, 4) == 4);
+      OATPP_ASSERT(std::memcmp(buffer, "ping", 4) == 0);
+    } // released to the pool
+
+    ConnectionFixture::invalidate(timeoutServerConnection);
+
+    timeoutPool->stop();
+
+  }
+
+}
+
+}}}
@@ -0,0 +1,66 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ContextPoolTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void ContextPoolTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setContextPool(4);
+
+  ConnectionFixture fixture("context-pool", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+
+  const v_int32 connectionsCount = 5;
+  const std::string message = "hello";
+
+  for(v_int32 i = 0; i < connectionsCount; i ++) {
+
+    fixture.run(
+      [&message](const ConnectionHandle& connection) {
+        ConnectionFixture::readMessage(connection, message);
+      },
+      [&message](const ConnectionHandle& connection) {
+        OATPP_ASSERT(connection.object->writeExactSizeDataSimple(message.data(), message.size()) == (v_io_size) message.size());
+      }
+    );
+
+  }
+
+  auto stats = serverConfig->getContextPool()->getStatistics();
+  OATPP_LOGD(TAG, "hits=%d, misses=%d, discards=%d", (v_int32) stats.hits, (v_int32) stats.misses, (v_int32) stats.discards);
+
+  /* Every server thread is new, so a context may be found in another shard - but only the first connection creates one */
+  OATPP_ASSERT(stats.misses + stats.hits == connectionsCount);
+  OATPP_ASSERT(stats.misses == 1);
+  OATPP_ASSERT(stats.discards == 0);
+
+}
+
+}}}
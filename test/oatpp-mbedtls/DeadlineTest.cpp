@@ -0,0 +1,267 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "DeadlineTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp-mbedtls/Connection.hpp"
+
+#include "oatpp/network/virtual_/client/ConnectionProvider.hpp"
+#include "oatpp/core/async/Executor.hpp"
+
+#include <thread>
+#include <atomic>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+/**
+ * Handshake and optionally read in coroutine mode, on a peer which never sends anything.
+ */
+class StalledCoroutine : public oatpp::async::Coroutine<StalledCoroutine> {
+public:
+  static constexpr v_int32 RUNNING = 0;
+  static constexpr v_int32 FINISHED = 1;
+  static constexpr v_int32 FAILED = 2;
+private:
+  ConnectionHandle m_connection;
+  bool m_read;
+  std::atomic<v_int32>* m_state;
+  v_char8 m_buffer[16];
+public:
+
+  StalledCoroutine(const ConnectionHandle& connection, bool read, std::atomic<v_int32>* state)
+    : m_connection(connection)
+    , m_read(read)
+    , m_state(state)
+  {}
+
+  Action act() override {
+    return m_connection.object->initContextsAsync().next(yieldTo(&StalledCoroutine::onHandshakeDone));
+  }
+
+  Action onHandshakeDone() {
+    if(!m_read) {
+      *m_state = FINISHED;
+      return finish();
+    }
+    return yieldTo(&StalledCoroutine::read);
+  }
+
+  Action read() {
+
+    async::Action action;
+    auto res = m_connection.object->read(m_buffer, sizeof(m_buffer), action);
+
+    if(!action.isNone()) {
+      return action;
+    }
+
+    if(res == oatpp::IOError::RETRY_READ || res == oatpp::IOError::RETRY_WRITE) {
+      return waitRepeat(std::chrono::milliseconds(10));
+    }
+
+    if(res > 0) {
+      *m_state = FINISHED;
+      return finish();
+    }
+
+    return error<Error>("[StalledCoroutine::read()]: Error. Read failed.");
+
+  }
+
+  Action handleError(Error* error) override {
+    *m_state = FAILED;
+    return error;
+  }
+
+};
+
+/* Run coroutine till it's done, return time it took */
+v_int64 runStalledCoroutine(const ConnectionHandle& connection, bool read, std::atomic<v_int32>& state) {
+
+  connection.object->setInputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
+  connection.object->setOutputStreamIOMode(oatpp::data::stream::IOMode::ASYNCHRONOUS);
+
+  oatpp::async::Executor executor(1, 1, 1);
+
+  auto startTick = oatpp::base::Environment::getMicroTickCount();
+  executor.execute<StalledCoroutine>(connection, read, &state);
+
+  while(state == StalledCoroutine::RUNNING && oatpp::base::Environment::getMicroTickCount() - startTick < 10 * 1000 * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  auto ticks = oatpp::base::Environment::getMicroTickCount() - startTick;
+
+  executor.waitTasksFinished();
+  executor.stop();
+  executor.join();
+
+  return ticks;
+
+}
+
+}
+
+void DeadlineTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setHandshakeTimeout(300);
+  serverConfig->setReadTimeout(300);
+
+  ConnectionFixture fixture("deadline", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+  auto serverProvider = fixture.getServerProvider();
+
+  {
+
+    OATPP_LOGD(TAG, "Stalled handshake...");
+
+    /* plain transport connection - client never starts the handshake */
+    auto transportProvider = oatpp::network::virtual_::client::ConnectionProvider::createShared(fixture.getInterface());
+    ConnectionHandle transport;
+    std::thread clientThread([&transportProvider, &transport] {
+      transport = transportProvider->get();
+    });
+
+    auto connection = serverProvider->get();
+    OATPP_ASSERT(connection);
+    clientThread.join();
+    OATPP_ASSERT(transport);
+
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+    connection.object->initContexts();
+    auto ticks = oatpp::base::Environment::getMicroTickCount() - startTick;
+
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_LOGD(TAG, "handshake result=%d, time=%dms", c->getHandshakeResult(), (v_int32)(ticks / 1000));
+    OATPP_ASSERT(c->getHandshakeResult() == MBEDTLS_ERR_SSL_TIMEOUT);
+    OATPP_ASSERT(c->isTimedOut());
+    OATPP_ASSERT(ticks < 5 * 1000 * 1000);
+
+    connection.invalidator->invalidate(connection.object);
+    transport.invalidator->invalidate(transport.object);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Stalled read...");
+
+    auto clientProvider = fixture.getClientProvider();
+
+    ConnectionHandle clientConnection;
+    std::thread clientThread([&clientProvider, &clientConnection] {
+      clientConnection = clientProvider->get();
+    });
+
+    auto connection = serverProvider->get();
+    OATPP_ASSERT(connection);
+    connection.object->initContexts();
+    clientThread.join();
+    OATPP_ASSERT(clientConnection);
+
+    /* client doesn't send anything */
+    v_char8 buffer[16];
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+    auto res = connection.object->readSimple(buffer, 16);
+    auto ticks = oatpp::base::Environment::getMicroTickCount() - startTick;
+
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_LOGD(TAG, "read result=%d, time=%dms", (v_int32) res, (v_int32)(ticks / 1000));
+    OATPP_ASSERT(res <= 0);
+    OATPP_ASSERT(c->isTimedOut());
+    OATPP_ASSERT(ticks < 5 * 1000 * 1000);
+
+    connection.invalidator->invalidate(connection.object);
+    clientConnection.invalidator->invalidate(clientConnection.object);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Stalled handshake in coroutine mode...");
+
+    auto transportProvider = oatpp::network::virtual_::client::ConnectionProvider::createShared(fixture.getInterface());
+    ConnectionHandle transport;
+    std::thread clientThread([&transportProvider, &transport] {
+      transport = transportProvider->get();
+    });
+
+    auto connection = serverProvider->get();
+    OATPP_ASSERT(connection);
+    clientThread.join();
+    OATPP_ASSERT(transport);
+
+    std::atomic<v_int32> state(StalledCoroutine::RUNNING);
+    auto ticks = runStalledCoroutine(connection, false, state);
+
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_LOGD(TAG, "handshake result=%d, time=%dms", c->getHandshakeResult(), (v_int32)(ticks / 1000));
+    OATPP_ASSERT(state == StalledCoroutine::FAILED);
+    OATPP_ASSERT(c->getHandshakeResult() == MBEDTLS_ERR_SSL_TIMEOUT);
+    OATPP_ASSERT(c->isTimedOut());
+    OATPP_ASSERT(ticks < 5 * 1000 * 1000);
+
+    connection.invalidator->invalidate(connection.object);
+    transport.invalidator->invalidate(transport.object);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Stalled read in coroutine mode...");
+
+    auto clientProvider = fixture.getClientProvider();
+
+    ConnectionHandle clientConnection;
+    std::thread clientThread([&clientProvider, &clientConnection] {
+      clientConnection = clientProvider->get();
+    });
+
+    auto connection = serverProvider->get();
+    OATPP_ASSERT(connection);
+
+    /* Handshake is done by the coroutine too - the client thread is joined once it's finished */
+    std::atomic<v_int32> state(StalledCoroutine::RUNNING);
+    auto ticks = runStalledCoroutine(connection, true, state);
+    clientThread.join();
+    OATPP_ASSERT(clientConnection);
+
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_LOGD(TAG, "read time=%dms", (v_int32)(ticks / 1000));
+    OATPP_ASSERT(state == StalledCoroutine::FAILED);
+    OATPP_ASSERT(c->getHandshakeResult() == 0);
+    OATPP_ASSERT(c->isTimedOut());
+    OATPP_ASSERT(ticks < 5 * 1000 * 1000);
+
+    connection.invalidator->invalidate(connection.object);
+    clientConnection.invalidator->invalidate(clientConnection.object);
+
+  }
+
+}
+
+}}}
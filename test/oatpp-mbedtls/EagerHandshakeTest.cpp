@@ -0,0 +1,124 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "EagerHandshakeTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp/network/virtual_/client/ConnectionProvider.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void EagerHandshakeTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+
+  ConnectionFixture fixture(
+    "eager-handshake",
+    serverConfig,
+    oatpp::mbedtls::Config::createDefaultClientConfigShared()
+  );
+
+  auto serverProvider = fixture.getServerProvider();
+
+  /* Accepts wait for the eager handshake - it's refused without a handshake timeout */
+  bool refused = false;
+  try {
+    serverProvider->setEagerHandshake(true);
+  } catch (const std::runtime_error&) {
+    refused = true;
+  }
+  OATPP_ASSERT(refused);
+
+  serverConfig->setHandshakeTimeout(5000);
+  serverProvider->setEagerHandshake(true);
+
+  /* Config without a handshake timeout can't replace it now */
+  refused = false;
+  try {
+    serverProvider->setConfig(oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH));
+  } catch (const std::runtime_error&) {
+    refused = true;
+  }
+  OATPP_ASSERT(refused);
+
+  oatpp::async::Executor executor(1, 1, 1);
+
+  ConnectionFixture::AsyncConnection server(executor, [serverProvider] {
+    return serverProvider->getAsync();
+  });
+
+  {
+
+    OATPP_LOGD(TAG, "Plain text client...");
+
+    auto transportProvider = oatpp::network::virtual_::client::ConnectionProvider::createShared(fixture.getInterface());
+    auto transport = transportProvider->get();
+    OATPP_ASSERT(transport);
+
+    const char* request = "GET / HTTP/1.1\r\n\r\n";
+    OATPP_ASSERT(transport.object->writeExactSizeDataSimple(request, std::strlen(request)) == (v_io_size) std::strlen(request));
+
+    /* Server may send an alert, then it closes the connection */
+    v_char8 buffer[256];
+    while(transport.object->readSimple(buffer, sizeof(buffer)) > 0) {}
+
+    transport.invalidator->invalidate(transport.object);
+
+  }
+
+  /* getAsync() is still waiting - failed handshake is not its error */
+  OATPP_ASSERT(server.isRunning());
+
+  {
+
+    OATPP_LOGD(TAG, "TLS client...");
+
+    auto clientConnection = fixture.getClientProvider()->get();
+    OATPP_ASSERT(clientConnection);
+
+    OATPP_ASSERT(server.wait());
+    auto serverConnection = server.getConnection();
+    OATPP_ASSERT(serverConnection);
+
+    /* Handshake is done by getAsync() */
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(serverConnection.object);
+    OATPP_ASSERT(c->getHandshakeResult() == 0);
+    OATPP_ASSERT(!serverConnection.object->getInputStreamContext().getProperties().get("tls_ciphersuite").std_str().empty());
+
+    ConnectionFixture::invalidate(clientConnection);
+    ConnectionFixture::invalidate(serverConnection);
+
+  }
+
+  executor.waitTasksFinished();
+  executor.stop();
+  executor.join();
+
+}
+
+}}}
@@ -0,0 +1,193 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "EarlyDataTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <thread>
+#include <chrono>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+const char* const REQUEST = "GET / HTTP/1.1\r\n\r\n";
+
+/*
+ * Connect with early data. Server reads the request whether early data is accepted or not.
+ * Blocking client reads the 1st byte - TLS 1.3 client receives the ticket with the first application data.
+ * Returns client early data status.
+ */
+std::string connect(ConnectionFixture& fixture,
+                    oatpp::async::Executor* executor,
+                    ConnectionHandle& serverConnection,
+                    ConnectionHandle& clientConnection)
+{
+
+  auto serverProvider = fixture.getServerProvider();
+
+  std::thread serverThread([&serverProvider, &serverConnection] {
+    serverConnection = serverProvider->get();
+    OATPP_ASSERT(serverConnection);
+    serverConnection.object->initContexts();
+    v_char8 b = 'x';
+    OATPP_ASSERT(serverConnection.object->writeExactSizeDataSimple(&b, 1) == 1);
+    ConnectionFixture::readMessage(serverConnection, REQUEST);
+  });
+
+  if(executor == nullptr) {
+
+    clientConnection = fixture.getClientProvider()->getWithEarlyData(REQUEST);
+    OATPP_ASSERT(clientConnection);
+    v_char8 b;
+    OATPP_ASSERT(clientConnection.object->readExactSizeDataSimple(&b, 1) == 1);
+
+  } else {
+
+    auto clientProvider = fixture.getClientProvider();
+    ConnectionFixture::AsyncConnection client(*executor, [clientProvider] {
+      return clientProvider->getWithEarlyDataAsync(REQUEST);
+    });
+    OATPP_ASSERT(client.wait());
+    clientConnection = client.getConnection();
+    OATPP_ASSERT(clientConnection);
+
+  }
+
+  serverThread.join();
+
+  return clientConnection.object->getOutputStreamContext().getProperties().get("tls_early_data").std_str();
+
+}
+
+}
+
+void EarlyDataTest::onRun() {
+
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+
+  auto tickets = oatpp::mbedtls::server::SessionTickets::createShared();
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setSessionTickets(tickets);
+  serverConfig->setEarlyData(1024);
+
+  auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+  clientConfig->setEarlyData(1024);
+
+  ConnectionFixture fixture("early-data", serverConfig, clientConfig);
+  fixture.getClientProvider()->setSessionCache(oatpp::mbedtls::client::SessionCache::createShared());
+
+  {
+
+    /* 1st connection - no session to resume, 2nd connection - early data */
+    const char* expectedStatus[] = {"not_sent", "accepted"};
+
+    for(v_int32 i = 0; i < 2; i ++) {
+
+      ConnectionHandle serverConnection, connection;
+      auto clientStatus = connect(fixture, nullptr, serverConnection, connection);
+      OATPP_LOGD(TAG, "connection %d: early data '%s'", i, clientStatus.c_str());
+      OATPP_ASSERT(clientStatus == expectedStatus[i]);
+
+      if(i == 1) {
+        auto serverStatus = serverConnection.object->getInputStreamContext().getProperties().get("tls_early_data").std_str();
+        OATPP_ASSERT(serverStatus == "accepted");
+      }
+
+      ConnectionFixture::invalidate(connection);
+      ConnectionFixture::invalidate(serverConnection);
+
+    }
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Replayed ticket...");
+
+    /* Session of the 1st connection is saved when it's invalidated - till then the 2nd connection offers the same ticket */
+    ConnectionHandle server1, client1, server2, client2;
+    OATPP_ASSERT(connect(fixture, nullptr, server1, client1) == "accepted");
+    OATPP_ASSERT(connect(fixture, nullptr, server2, client2) == "rejected");
+
+    auto stats = tickets->getStatistics();
+    OATPP_ASSERT(stats.earlyDataAdmitted == 2);
+    OATPP_ASSERT(stats.earlyDataDenied == 1);
+
+    ConnectionFixture::invalidate(client1);
+    ConnectionFixture::invalidate(server1);
+    ConnectionFixture::invalidate(client2);
+    ConnectionFixture::invalidate(server2);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Ticket older than the anti-replay window...");
+
+    tickets->setEarlyDataWindow(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2200));
+
+    ConnectionHandle serverConnection, connection;
+    OATPP_ASSERT(connect(fixture, nullptr, serverConnection, connection) == "rejected");
+    OATPP_ASSERT(tickets->getStatistics().earlyDataDenied == 2);
+
+    ConnectionFixture::invalidate(connection);
+    ConnectionFixture::invalidate(serverConnection);
+
+    tickets->setEarlyDataWindow(60);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Asynchronous client...");
+
+    oatpp::async::Executor executor(1, 1, 1);
+
+    ConnectionHandle serverConnection, connection;
+    OATPP_ASSERT(connect(fixture, &executor, serverConnection, connection) == "accepted");
+
+    ConnectionFixture::invalidate(connection);
+    ConnectionFixture::invalidate(serverConnection);
+
+    executor.waitTasksFinished();
+    executor.stop();
+    executor.join();
+
+  }
+
+  auto stats = tickets->getStatistics();
+  OATPP_LOGD(TAG, "early data admitted=%d, denied=%d", (v_int32) stats.earlyDataAdmitted, (v_int32) stats.earlyDataDenied);
+  OATPP_ASSERT(stats.earlyDataAdmitted == 3);
+  OATPP_ASSERT(stats.earlyDataDenied == 2);
+
+#else
+  OATPP_LOGD(TAG, "Mbed TLS is built without MBEDTLS_SSL_EARLY_DATA. Skipped.");
+#endif
+
+}
+
+}}}
@@ -0,0 +1,255 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "HandshakeScalingTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <thread>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <chrono>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+/*
+ * Number of server handshakes in progress, and the max of it.
+ */
+class HandshakeGauge {
+private:
+  std::atomic<v_int32> m_current;
+  std::atomic<v_int32> m_peak;
+public:
+
+  HandshakeGauge()
+    : m_current(0)
+    , m_peak(0)
+  {}
+
+  void enter() {
+    v_int32 current = ++ m_current;
+    v_int32 peak = m_peak.load();
+    while(current > peak && !m_peak.compare_exchange_weak(peak, current)) {}
+  }
+
+  void leave() {
+    -- m_current;
+  }
+
+  v_int32 getPeak() const {
+    return m_peak;
+  }
+
+};
+
+int getHandshakeResult(const ConnectionHandle& connection) {
+  return std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object)->getHandshakeResult();
+}
+
+/*
+ * Stall one server handshake inside Mbed TLS on a transport read, and complete another handshake meanwhile.
+ * Handshakes sharing one config must not wait for each other's I/O.
+ */
+void runStalledHandshake() {
+
+  ConnectionFixture fixture(
+    "handshake-stall",
+    oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH),
+    oatpp::mbedtls::Config::createDefaultClientConfigShared(),
+    true
+  );
+
+  auto serverProvider = fixture.getServerProvider();
+  auto clientProvider = fixture.getClientProvider();
+
+  std::promise<std::shared_ptr<ConnectionFixture::Transport>> stalledTransportPromise;
+  auto stalledTransportFuture = stalledTransportPromise.get_future();
+
+  ConnectionHandle stalledServer;
+  std::thread stalledServerThread([&serverProvider, &stalledServer, &stalledTransportPromise] {
+    stalledServer = serverProvider->get();
+    OATPP_ASSERT(stalledServer);
+    auto transport = ConnectionFixture::getTransport(stalledServer);
+    transport->holdReads();
+    stalledTransportPromise.set_value(transport);
+    stalledServer.object->initContexts();
+  });
+
+  ConnectionHandle stalledClient;
+  std::thread stalledClientThread([&clientProvider, &stalledClient] {
+    stalledClient = clientProvider->get();
+  });
+
+  auto stalledTransport = stalledTransportFuture.get();
+  OATPP_ASSERT(stalledTransport->waitReadHeld());
+
+  /* Second handshake while the first one is blocked in the transport */
+  std::atomic<bool> connected(false);
+  ConnectionHandle serverConnection, clientConnection;
+  std::thread connectThread([&fixture, &serverConnection, &clientConnection, &connected] {
+    fixture.connect(serverConnection, clientConnection);
+    connected = true;
+  });
+
+  auto startTick = oatpp::base::Environment::getMicroTickCount();
+  while(!connected && oatpp::base::Environment::getMicroTickCount() - startTick < 10 * 1000 * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  OATPP_ASSERT(connected);
+  OATPP_ASSERT(getHandshakeResult(stalledServer) == oatpp::mbedtls::Connection::HANDSHAKE_PENDING);
+
+  connectThread.join();
+  OATPP_ASSERT(getHandshakeResult(serverConnection) == 0);
+
+  stalledTransport->releaseReads();
+  stalledServerThread.join();
+  stalledClientThread.join();
+
+  OATPP_ASSERT(getHandshakeResult(stalledServer) == 0);
+  OATPP_ASSERT(stalledClient);
+
+  ConnectionFixture::invalidate(clientConnection);
+  ConnectionFixture::invalidate(serverConnection);
+  ConnectionFixture::invalidate(stalledClient);
+  ConnectionFixture::invalidate(stalledServer);
+
+}
+
+}
+
+void HandshakeScalingTest::onRun() {
+
+  if(!m_useHandshakeWorkers && !m_useCryptoWorkers) {
+    OATPP_LOGD(TAG, "Stalled handshake...");
+    runStalledHandshake();
+  }
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+  if(m_useCryptoWorkers) {
+    serverConfig->setCryptoWorkerPool(oatpp::mbedtls::CryptoWorkerPool::createShared());
+    /* private key operations are offloaded in TLS 1.2 handshakes only */
+    serverConfig->setTLSVersions(MBEDTLS_SSL_VERSION_TLS1_2, MBEDTLS_SSL_VERSION_TLS1_2);
+  }
+#endif
+
+  ConnectionFixture fixture("handshake-scaling", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+  auto serverProvider = fixture.getServerProvider();
+  auto clientProvider = fixture.getClientProvider();
+
+  if(m_useHandshakeWorkers) {
+    serverProvider->enableHandshakeWorkers(m_maxThreads, 64);
+  }
+
+  v_int32 handshakesTotal = 0;
+  HandshakeGauge gauge;
+
+  for(v_int32 threadsCount = 1; threadsCount <= m_maxThreads; threadsCount *= 2) {
+
+    std::mutex serverConnectionsLock;
+    std::list<ConnectionHandle> serverConnections; // keep server side open until clients are done
+    std::atomic<v_int32> handshakes(0);
+
+    std::list<std::thread> threads;
+
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+
+    for(v_int32 i = 0; i < threadsCount; i ++) {
+
+      threads.push_back(std::thread([this, &serverProvider, &serverConnectionsLock, &serverConnections, &gauge] {
+        for(v_int32 j = 0; j < m_handshakesPerThread; j ++) {
+          auto connection = serverProvider->get();
+          OATPP_ASSERT(connection);
+          /* No-op with handshake workers - the pool measures them */
+          gauge.enter();
+          connection.object->initContexts();
+          gauge.leave();
+          std::lock_guard<std::mutex> lock(serverConnectionsLock);
+          serverConnections.push_back(connection);
+        }
+      }));
+
+      threads.push_back(std::thread([this, &clientProvider, &handshakes] {
+        for(v_int32 j = 0; j < m_handshakesPerThread; j ++) {
+          auto connection = clientProvider->get();
+          OATPP_ASSERT(connection);
+          ++ handshakes;
+          connection.invalidator->invalidate(connection.object);
+        }
+      }));
+
+    }
+
+    for(auto& thread : threads) {
+      thread.join();
+    }
+
+    auto ticks = oatpp::base::Environment::getMicroTickCount() - startTick;
+
+    OATPP_ASSERT(handshakes == threadsCount * m_handshakesPerThread);
+    handshakesTotal += handshakes;
+    OATPP_LOGD(TAG, "threads=%d, handshakes=%d, time=%dms, handshakes/sec=%.1f",
+               threadsCount, handshakes.load(), (v_int32)(ticks / 1000), (double) handshakes.load() * 1000000.0 / (double) ticks);
+
+    for(auto& connection : serverConnections) {
+      connection.invalidator->invalidate(connection.object);
+    }
+
+  }
+
+  v_int64 peakHandshakes = gauge.getPeak();
+
+  if(m_useHandshakeWorkers) {
+    auto stats = serverProvider->getHandshakeWorkers()->getStatistics();
+    OATPP_LOGD(TAG, "handshake workers: succeeded=%d, failed=%d, avg=%dus, max=%dus, avg queue=%dus",
+               (v_int32) stats.handshakesSucceeded, (v_int32) stats.handshakesFailed,
+               (v_int32) stats.averageHandshakeMicroseconds, (v_int32) stats.maxHandshakeMicroseconds,
+               (v_int32) stats.averageQueueMicroseconds);
+    OATPP_ASSERT(stats.handshakesSucceeded == handshakesTotal);
+    peakHandshakes = stats.peakHandshakingCount;
+  }
+
+  /* Handshakes run side by side, not one at a time */
+  OATPP_LOGD(TAG, "peak concurrent server handshakes=%d", (v_int32) peakHandshakes);
+  if(m_maxThreads > 1) {
+    OATPP_ASSERT(peakHandshakes > 1);
+  }
+
+  if(serverConfig->getCryptoWorkerPool()) {
+    auto stats = serverConfig->getCryptoWorkerPool()->getStatistics();
+    OATPP_LOGD(TAG, "crypto workers: operations=%d, avg=%dus, avg queue=%dus",
+               (v_int32) stats.operationsCompleted, (v_int32) stats.averageOperationMicroseconds,
+               (v_int32) stats.averageQueueMicroseconds);
+    OATPP_ASSERT(stats.operationsCompleted > 0);
+  }
+
+}
+
+}}}
@@ -0,0 +1,59 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_test_mbedtls_HandshakeScalingTest_hpp
+#define oatpp_test_mbedtls_HandshakeScalingTest_hpp
+
+#include "oatpp-test/UnitTest.hpp"
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+/**
+ * Run handshakes with growing number of threads and log handshakes/sec for each step.
+ * Check that server handshakes overlap when there is more than one thread,
+ * and that a handshake completes while another one is stalled on a transport read.
+ */
+class HandshakeScalingTest : public UnitTest {
+private:
+  v_int32 m_maxThreads;
+  v_int32 m_handshakesPerThread;
+  bool m_useHandshakeWorkers;
+  bool m_useCryptoWorkers;
+public:
+
+  HandshakeScalingTest(v_int32 maxThreads, v_int32 handshakesPerThread, bool useHandshakeWorkers = false, bool useCryptoWorkers = false)
+    : UnitTest("TEST[mbedtls::HandshakeScalingTest]")
+    , m_maxThreads(maxThreads)
+    , m_handshakesPerThread(handshakesPerThread)
+    , m_useHandshakeWorkers(useHandshakeWorkers)
+    , m_useCryptoWorkers(useCryptoWorkers)
+  {}
+
+  void onRun() override;
+
+};
+
+}}}
+
+#endif /* oatpp_test_mbedtls_HandshakeScalingTest_hpp */
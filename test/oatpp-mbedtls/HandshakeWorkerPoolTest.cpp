@@ -0,0 +1,106 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "HandshakeWorkerPoolTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include "oatpp/network/virtual_/client/ConnectionProvider.hpp"
+
+#include <list>
+#include <thread>
+#include <chrono>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+constexpr v_int32 WORKERS_COUNT = 2;
+
+template<class Condition>
+bool waitFor(const Condition& condition) {
+  auto startTick = oatpp::base::Environment::getMicroTickCount();
+  while(!condition() && oatpp::base::Environment::getMicroTickCount() - startTick < 10 * 1000 * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+}
+
+void HandshakeWorkerPoolTest::onRun() {
+
+  ConnectionFixture fixture(
+    "handshake-worker-pool",
+    oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH),
+    oatpp::mbedtls::Config::createDefaultClientConfigShared()
+  );
+
+  auto serverProvider = fixture.getServerProvider();
+  serverProvider->enableHandshakeWorkers(WORKERS_COUNT, 8);
+  auto pool = serverProvider->getHandshakeWorkers();
+
+  /* Connection handed out by get() is established */
+  fixture.run([](const ConnectionHandle& connection) {
+    auto c = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_ASSERT(c->getHandshakeResult() == 0);
+  });
+
+  OATPP_ASSERT(pool->getStatistics().handshakesSucceeded == 1);
+
+  /* Clients which never send the ClientHello keep all workers in the handshake */
+  auto transportProvider = oatpp::network::virtual_::client::ConnectionProvider::createShared(fixture.getInterface());
+  std::list<ConnectionHandle> silentClients;
+  for(v_int32 i = 0; i < WORKERS_COUNT; i ++) {
+    silentClients.push_back(transportProvider->get());
+    OATPP_ASSERT(silentClients.back());
+  }
+
+  /* Acceptor is running since the first get() - the next get() waits for a ready connection */
+  std::thread handlerThread([&serverProvider] {
+    auto connection = serverProvider->get();
+    OATPP_ASSERT(!connection);
+  });
+
+  OATPP_ASSERT(waitFor([&pool] { return pool->getStatistics().handshakingCount == WORKERS_COUNT; }));
+
+  serverProvider->stop();
+  handlerThread.join();
+
+  /* Workers are not left blocked - the pool can be joined */
+  OATPP_ASSERT(waitFor([&pool] {
+    auto stats = pool->getStatistics();
+    return stats.handshakingCount == 0 && stats.handshakesFailed == WORKERS_COUNT;
+  }));
+
+  auto stats = pool->getStatistics();
+  OATPP_LOGD(TAG, "succeeded=%d, failed=%d", (v_int32) stats.handshakesSucceeded, (v_int32) stats.handshakesFailed);
+
+  for(auto& client : silentClients) {
+    ConnectionFixture::invalidate(client);
+  }
+
+}
+
+}}}
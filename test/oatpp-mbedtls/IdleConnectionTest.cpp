@@ -0,0 +1,121 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "IdleConnectionTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <thread>
+#include <chrono>
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void IdleConnectionTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setIdleBufferRelease(100);
+  serverConfig->setIdleTimeout(1500);
+
+  ConnectionFixture fixture("idle-connection", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+
+  ConnectionHandle serverConnection, connection;
+  fixture.connect(serverConnection, connection,
+    [](const ConnectionHandle& connection) {
+      ConnectionFixture::readMessage(connection, "hello");
+    },
+    [](const ConnectionHandle& connection) {
+      OATPP_ASSERT(connection.object->writeExactSizeDataSimple("hello", 5) == 5);
+    }
+  );
+
+  auto tlsConnection = std::static_pointer_cast<oatpp::mbedtls::Connection>(serverConnection.object);
+  auto activeMemory = tlsConnection->getMemoryUsage();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+  auto idleMemory = tlsConnection->getMemoryUsage();
+  OATPP_LOGD(TAG, "active connection=%d bytes, idle connection=%d bytes", (v_int32) activeMemory, (v_int32) idleMemory);
+  OATPP_ASSERT(tlsConnection->areRecordBuffersReleased());
+  OATPP_ASSERT(idleMemory < activeMemory);
+#else
+  OATPP_LOGD(TAG, "Mbed TLS is built without MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH. Buffers are kept.");
+#endif
+
+  /* Message larger than the idle buffers - they are allocated again before it's read */
+  const std::string message(8000, 'x');
+
+  std::thread readerThread([&serverConnection, &message] {
+    ConnectionFixture::readMessage(serverConnection, message);
+  });
+
+  OATPP_ASSERT(connection.object->writeExactSizeDataSimple(message.data(), message.size()) == (v_io_size) message.size());
+  readerThread.join();
+
+  OATPP_ASSERT(!tlsConnection->areRecordBuffersReleased());
+  OATPP_ASSERT(!tlsConnection->isTimedOut());
+
+  /* Handler thread of a keep-alive connection waits for the next request inside read() */
+  std::thread parkedReaderThread([&serverConnection] {
+    ConnectionFixture::readMessage(serverConnection, "next");
+    OATPP_ASSERT(serverConnection.object->writeExactSizeDataSimple("ack", 3) == 3);
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+  OATPP_ASSERT(tlsConnection->areRecordBuffersReleased());
+  OATPP_ASSERT(tlsConnection->getMemoryUsage() < activeMemory);
+#endif
+
+  OATPP_ASSERT(connection.object->writeExactSizeDataSimple("next", 4) == 4);
+  /* Client reads everything the server sent so far - session tickets included */
+  ConnectionFixture::readMessage(connection, "ack");
+  parkedReaderThread.join();
+
+  OATPP_ASSERT(!tlsConnection->areRecordBuffersReleased());
+  OATPP_ASSERT(!tlsConnection->isTimedOut());
+
+  /* Idle timeout fires while the reader is parked - close_notify is written, then the reader is woken up */
+  std::thread reapedReaderThread([&serverConnection] {
+    v_char8 buffer[16];
+    OATPP_ASSERT(serverConnection.object->readSimple(buffer, sizeof(buffer)) <= 0);
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+  reapedReaderThread.join();
+
+  OATPP_ASSERT(tlsConnection->isTimedOut());
+
+  /* close_notify alert record arrives before the end of the stream */
+  auto clientTransport = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object)->getTransportStream();
+  v_char8 buffer[64];
+  OATPP_ASSERT(clientTransport.object->readSimple(buffer, sizeof(buffer)) > 0);
+
+  ConnectionFixture::invalidate(connection);
+
+}
+
+}}}
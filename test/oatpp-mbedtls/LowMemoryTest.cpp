@@ -0,0 +1,82 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "LowMemoryTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void LowMemoryTest::onRun() {
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setTrimPeerCertificate(true);
+
+  /* max_fragment_length is negotiated in TLS 1.2 */
+  auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+  clientConfig->setTLSVersions(MBEDTLS_SSL_VERSION_TLS1_2, MBEDTLS_SSL_VERSION_TLS1_2);
+  clientConfig->setMaxFragmentLength(1024);
+
+  ConnectionFixture fixture("low-memory", serverConfig, clientConfig);
+
+  /* Payload spans several records of the negotiated length */
+  const std::string payload(5000, 'x');
+
+  ConnectionHandle serverConnection, connection;
+  fixture.connect(serverConnection, connection,
+    [&payload](const ConnectionHandle& connection) {
+      ConnectionFixture::readMessage(connection, payload);
+    },
+    [&payload](const ConnectionHandle& connection) {
+      OATPP_ASSERT(connection.object->writeExactSizeDataSimple(payload.data(), payload.size()) == (v_io_size) payload.size());
+    }
+  );
+
+  auto serverMemory = std::static_pointer_cast<oatpp::mbedtls::Connection>(serverConnection.object)->getMemoryUsage();
+  auto clientMemory = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object)->getMemoryUsage();
+  OATPP_LOGD(TAG, "server connection=%d bytes, client connection=%d bytes", (v_int32) serverMemory, (v_int32) clientMemory);
+
+  OATPP_ASSERT(serverMemory > 0);
+  OATPP_ASSERT(clientMemory > 0);
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+  /* Both record buffers shrank below the size of a single default one */
+  OATPP_ASSERT(serverMemory < MBEDTLS_SSL_IN_CONTENT_LEN);
+  OATPP_ASSERT(clientMemory < MBEDTLS_SSL_IN_CONTENT_LEN);
+#endif
+
+  ConnectionFixture::invalidate(connection);
+  ConnectionFixture::invalidate(serverConnection);
+
+#else
+  OATPP_LOGD(TAG, "Mbed TLS is built without MBEDTLS_SSL_MAX_FRAGMENT_LENGTH. Skipped.");
+#endif
+
+}
+
+}}}
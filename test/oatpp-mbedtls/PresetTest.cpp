@@ -0,0 +1,75 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "PresetTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void PresetTest::onRun() {
+
+  auto preset = oatpp::mbedtls::Preset::createByName("fast-modern");
+  OATPP_ASSERT(!preset.getCipherSuites().empty());
+
+  std::string first = mbedtls_ssl_get_ciphersuite_name(preset.getCipherSuites().front());
+  bool aes = oatpp::mbedtls::Preset::hasAESAcceleration();
+  OATPP_LOGD(TAG, "AES acceleration=%d, first suite='%s'", (v_int32) aes, first.c_str());
+  OATPP_ASSERT((first.find("AES") != std::string::npos) == aes);
+
+  /* Entries not supported by the Mbed TLS build are skipped */
+  oatpp::mbedtls::Preset filtered;
+  filtered.addGroup(0xFFFF)
+          .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_ED25519)
+          .addSignatureAlgorithm(MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA256);
+  OATPP_ASSERT(filtered.getGroups().empty());
+  OATPP_ASSERT(filtered.getSignatureAlgorithms().size() == 1);
+  OATPP_ASSERT(filtered.getSignatureAlgorithms().front() == MBEDTLS_TLS1_3_SIG_RSA_PSS_RSAE_SHA256);
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setPreset(preset);
+
+  auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+  clientConfig->setPreset(preset);
+
+  ConnectionFixture fixture("preset", serverConfig, clientConfig);
+
+  ConnectionHandle serverConnection, connection;
+  fixture.connect(serverConnection, connection);
+
+  auto negotiated = serverConnection.object->getInputStreamContext().getProperties().get("tls_ciphersuite").std_str();
+  OATPP_LOGD(TAG, "negotiated '%s'", negotiated.c_str());
+
+  bool found = false;
+  for(auto id : preset.getCipherSuites()) {
+    found = found || negotiated == mbedtls_ssl_get_ciphersuite_name(id);
+  }
+  OATPP_ASSERT(found);
+
+  ConnectionFixture::invalidate(connection);
+  ConnectionFixture::invalidate(serverConnection);
+
+}
+
+}}}
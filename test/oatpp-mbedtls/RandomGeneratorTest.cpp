@@ -0,0 +1,80 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "RandomGeneratorTest.hpp"
+
+#include "oatpp-mbedtls/Config.hpp"
+
+#include <thread>
+#include <vector>
+#include <set>
+#include <string>
+#include <mutex>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void RandomGeneratorTest::onRun() {
+
+  const v_int32 threadsCount = 4;
+  const v_int32 drawsPerThread = 1000;
+
+  auto config = oatpp::mbedtls::Config::createShared();
+  config->setReseedInterval(100); // make shards reseed during the test
+  config->setRandomShards(threadsCount);
+
+  OATPP_ASSERT(config->getRandomGenerator());
+  OATPP_ASSERT(config->getRandomGenerator()->getShardsCount() == threadsCount);
+
+  std::mutex outputsLock;
+  std::set<std::string> outputs;
+
+  std::vector<std::thread> threads;
+  for(v_int32 i = 0; i < threadsCount; i ++) {
+    threads.push_back(std::thread([&config, &outputsLock, &outputs, drawsPerThread] {
+      std::set<std::string> local;
+      for(v_int32 j = 0; j < drawsPerThread; j ++) {
+        std::string output(32, '\0');
+        OATPP_ASSERT(config->getRandom((unsigned char*) &output[0], output.size()) == 0);
+        local.insert(output);
+      }
+      std::lock_guard<std::mutex> lock(outputsLock);
+      outputs.insert(local.begin(), local.end());
+    }));
+  }
+
+  for(auto& t : threads) {
+    t.join();
+  }
+
+  /* No two draws of different shards or of the same shard repeat */
+  OATPP_ASSERT(outputs.size() == (size_t) (threadsCount * drawsPerThread));
+
+  OATPP_LOGD(TAG, "contended draws=%d", (v_int32) config->getRandomGenerator()->getContentions());
+
+  config->setRandomShards(0);
+  OATPP_ASSERT(!config->getRandomGenerator());
+
+}
+
+}}}
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "ReadAheadTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void ReadAheadTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setReadAheadSize(16 * 1024);
+
+  auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+  clientConfig->setReadAheadSize(16 * 1024);
+
+  ConnectionFixture fixture("read-ahead", serverConfig, clientConfig, true);
+
+  const v_int32 messagesCount = 200;
+  const std::string message = "small record";
+
+  /*
+   * Server starts reading once this many messages are written - they fit the virtual pipe, so the client doesn't block.
+   * Otherwise a server as fast as the client would get one record per read.
+   */
+  const v_int32 messagesBuffered = 32;
+  std::atomic<v_int32> messagesWritten(0);
+
+  /* Records larger than the read-ahead buffer are read partly from the buffer, partly from the transport */
+  std::string payload(100000, '\0');
+  for(size_t i = 0; i < payload.size(); i ++) {
+    payload[i] = (char) ('a' + i % 26);
+  }
+
+  auto server = [&message, &payload, &messagesWritten](const ConnectionHandle& connection) {
+
+    while(messagesWritten < messagesBuffered) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto transport = ConnectionFixture::getTransport(connection);
+    auto readsBefore = transport->getReadsCount();
+
+    /* Client writes all messages first - several records arrive with one transport read */
+    for(v_int32 i = 0; i < messagesCount; i ++) {
+      ConnectionFixture::readMessage(connection, message);
+    }
+
+    auto reads = transport->getReadsCount() - readsBefore;
+    OATPP_LOGD("[ReadAheadTest::onRun()]", "records=%d, transport reads=%d", messagesCount, (v_int32) reads);
+    OATPP_ASSERT(reads < messagesCount);
+
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple(payload.data(), payload.size()) == (v_io_size) payload.size());
+
+    v_char8 ack;
+    OATPP_ASSERT(connection.object->readExactSizeDataSimple(&ack, 1) == 1);
+
+  };
+
+  auto client = [&message, &payload, &messagesWritten](const ConnectionHandle& connection) {
+    for(v_int32 i = 0; i < messagesCount; i ++) {
+      OATPP_ASSERT(connection.object->writeExactSizeDataSimple(message.data(), message.size()) == (v_io_size) message.size());
+      ++ messagesWritten;
+    }
+    ConnectionFixture::readMessage(connection, payload);
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple("!", 1) == 1);
+  };
+
+  fixture.run(server, client);
+
+}
+
+}}}
@@ -0,0 +1,296 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "SessionResumptionTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+const char* const TICKET_KEY_PATH = "session-resumption-test.key";
+
+/* 48-byte key file records - 16 bytes key name, 32 bytes AES key */
+void writeTicketKeys(const std::vector<v_char8>& seeds) {
+  std::ofstream out(TICKET_KEY_PATH, std::ios::binary | std::ios::trunc);
+  for(auto seed : seeds) {
+    for(v_int32 i = 0; i < 48; i ++) {
+      out.put((char)(seed + i));
+    }
+  }
+}
+
+void runConnections(ConnectionFixture& fixture, v_int32 connectionsCount) {
+
+  std::list<ConnectionHandle> serverConnections;
+
+  for(v_int32 i = 0; i < connectionsCount; i ++) {
+
+    ConnectionHandle serverConnection, clientConnection;
+    fixture.connect(serverConnection, clientConnection,
+      [](const ConnectionHandle& connection) {
+        /* TLS 1.3 client receives the ticket with the first application data */
+        v_char8 b = 'x';
+        OATPP_ASSERT(connection.object->writeExactSizeDataSimple(&b, 1) == 1);
+      },
+      [](const ConnectionHandle& connection) {
+        v_char8 b;
+        OATPP_ASSERT(connection.object->readExactSizeDataSimple(&b, 1) == 1);
+      }
+    );
+
+    ConnectionFixture::invalidate(clientConnection);
+    serverConnections.push_back(serverConnection);
+
+  }
+
+  for(auto& connection : serverConnections) {
+    ConnectionFixture::invalidate(connection);
+  }
+
+}
+
+}
+
+void SessionResumptionTest::onRun() {
+
+  {
+
+    OATPP_LOGD(TAG, "Resumption by session ID...");
+
+    auto serverCache = oatpp::mbedtls::server::SessionCache::createShared();
+    auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfig->setSessionCache(serverCache);
+    /* TLS 1.3 resumes by tickets only */
+    serverConfig->setTLSVersions(MBEDTLS_SSL_VERSION_TLS1_2, MBEDTLS_SSL_VERSION_TLS1_2);
+
+    auto clientCache = oatpp::mbedtls::client::SessionCache::createShared();
+    auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+
+    ConnectionFixture fixture("session-resumption", serverConfig, clientConfig);
+    fixture.getClientProvider()->setSessionCache(clientCache);
+
+    runConnections(fixture, m_connectionsCount);
+
+    auto clientStats = clientCache->getStatistics();
+    auto serverStats = serverCache->getStatistics();
+
+    OATPP_LOGD(TAG, "client: offered=%d, resumed=%d; server: hits=%d, misses=%d",
+               (v_int32) clientStats.offered, (v_int32) clientStats.resumed,
+               (v_int32) serverStats.hits, (v_int32) serverStats.misses);
+
+    OATPP_ASSERT(clientStats.size == 1);
+    OATPP_ASSERT(clientStats.offered == m_connectionsCount - 1);
+    OATPP_ASSERT(clientStats.resumed == m_connectionsCount - 1);
+    OATPP_ASSERT(serverStats.hits == m_connectionsCount - 1);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Resumption by session ticket...");
+
+    auto tickets = oatpp::mbedtls::server::SessionTickets::createShared();
+    auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfig->setSessionTickets(tickets);
+
+    auto clientCache = oatpp::mbedtls::client::SessionCache::createShared();
+    auto clientConfig = oatpp::mbedtls::Config::createDefaultClientConfigShared();
+
+    ConnectionFixture fixture("session-resumption", serverConfig, clientConfig);
+    fixture.getClientProvider()->setSessionCache(clientCache);
+
+    runConnections(fixture, m_connectionsCount);
+
+    auto clientStats = clientCache->getStatistics();
+    auto ticketStats = tickets->getStatistics();
+
+    OATPP_LOGD(TAG, "client: offered=%d, resumed=%d; tickets: issued=%d, accepted=%d, rejected=%d",
+               (v_int32) clientStats.offered, (v_int32) clientStats.resumed,
+               (v_int32) ticketStats.issued, (v_int32) ticketStats.accepted, (v_int32) ticketStats.rejected);
+
+    OATPP_ASSERT(clientStats.resumed == m_connectionsCount - 1);
+    OATPP_ASSERT(ticketStats.accepted == m_connectionsCount - 1);
+    OATPP_ASSERT(ticketStats.rejected == 0);
+
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    auto protocolStats = clientConfig->getProtocolStatistics();
+    OATPP_LOGD(TAG, "TLS 1.2 handshakes=%d, TLS 1.3 handshakes=%d", (v_int32) protocolStats.tls12Handshakes, (v_int32) protocolStats.tls13Handshakes);
+    OATPP_ASSERT(protocolStats.tls13Handshakes == m_connectionsCount);
+#endif
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Session tickets sharing a key file...");
+
+    writeTicketKeys({1});
+
+    auto ticketsA = oatpp::mbedtls::server::SessionTickets::createSharedWithKeyFile(TICKET_KEY_PATH, 43200, 1);
+    auto ticketsB = oatpp::mbedtls::server::SessionTickets::createSharedWithKeyFile(TICKET_KEY_PATH, 43200, 1);
+
+    auto serverConfigA = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfigA->setSessionTickets(ticketsA);
+    auto serverConfigB = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfigB->setSessionTickets(ticketsB);
+
+    auto clientCache = oatpp::mbedtls::client::SessionCache::createShared();
+
+    ConnectionFixture fixture("session-resumption", serverConfigA, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+    fixture.getClientProvider()->setSessionCache(clientCache);
+
+    /* Ticket issued by A is resumed by B */
+    runConnections(fixture, 1);
+    fixture.getServerProvider()->setConfig(serverConfigB);
+    runConnections(fixture, 1);
+
+    OATPP_ASSERT(ticketsA->getStatistics().issued >= 1);
+    OATPP_ASSERT(ticketsB->getStatistics().accepted == 1);
+
+    /* New key is prepended - B reloads the file and issues tickets with the new key */
+    writeTicketKeys({2, 1});
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    clientCache->clear();
+    runConnections(fixture, 1);
+
+    OATPP_ASSERT(ticketsB->getStatistics().keyUpdates == 1);
+
+    /* A reloads the file too and resumes the ticket issued by B with the new key */
+    fixture.getServerProvider()->setConfig(serverConfigA);
+    runConnections(fixture, 1);
+
+    auto statsA = ticketsA->getStatistics();
+    OATPP_LOGD(TAG, "A: keyUpdates=%d, accepted=%d", (v_int32) statsA.keyUpdates, (v_int32) statsA.accepted);
+    OATPP_ASSERT(statsA.keyUpdates == 1);
+    OATPP_ASSERT(statsA.accepted == 1);
+    OATPP_ASSERT(clientCache->getStatistics().resumed == 2);
+
+    std::remove(TICKET_KEY_PATH);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Session ticket key rotation...");
+
+    /*
+     * Ticket lifetime 3s, key rotation every 1s. Key is kept for a ticket lifetime after it's rotated out,
+     * so a ticket outlives its key's issuing period, and expires before the key is dropped.
+     * TLS 1.2 - the client offers the ticket without checking its lifetime, so expiration is seen by the server.
+     */
+    auto tickets = oatpp::mbedtls::server::SessionTickets::createShared(3, 1);
+    auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfig->setSessionTickets(tickets);
+    serverConfig->setTLSVersions(MBEDTLS_SSL_VERSION_TLS1_2, MBEDTLS_SSL_VERSION_TLS1_2);
+
+    ConnectionFixture fixture("session-resumption", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+
+    auto startTick = oatpp::base::Environment::getMicroTickCount();
+
+    /* Two clients get tickets with the first key */
+    auto cacheA = oatpp::mbedtls::client::SessionCache::createShared();
+    auto cacheB = oatpp::mbedtls::client::SessionCache::createShared();
+    fixture.getClientProvider()->setSessionCache(cacheA);
+    runConnections(fixture, 1);
+    fixture.getClientProvider()->setSessionCache(cacheB);
+    runConnections(fixture, 1);
+
+    /* Key is rotated - ticket with the old key is accepted */
+    std::this_thread::sleep_for(std::chrono::microseconds(2000 * 1000 - (oatpp::base::Environment::getMicroTickCount() - startTick)));
+    fixture.getClientProvider()->setSessionCache(cacheA);
+    runConnections(fixture, 1);
+
+    auto stats = tickets->getStatistics();
+    OATPP_ASSERT(stats.keyUpdates >= 1);
+    OATPP_ASSERT(stats.accepted == 1);
+    OATPP_ASSERT(cacheA->getStatistics().resumed == 1);
+
+    /* Lifetime has passed, old key is still known - ticket is expired */
+    std::this_thread::sleep_for(std::chrono::microseconds(4500 * 1000 - (oatpp::base::Environment::getMicroTickCount() - startTick)));
+    fixture.getClientProvider()->setSessionCache(cacheB);
+    runConnections(fixture, 1);
+
+    stats = tickets->getStatistics();
+    OATPP_LOGD(TAG, "keyUpdates=%d, accepted=%d, expired=%d, rejected=%d",
+               (v_int32) stats.keyUpdates, (v_int32) stats.accepted, (v_int32) stats.expired, (v_int32) stats.rejected);
+    OATPP_ASSERT(stats.expired == 1);
+    OATPP_ASSERT(stats.rejected == 0);
+    OATPP_ASSERT(cacheB->getStatistics().resumed == 0);
+
+  }
+
+  {
+
+    OATPP_LOGD(TAG, "Failed asynchronous handshake drops the offered session...");
+
+    auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+    serverConfig->setSessionTickets(oatpp::mbedtls::server::SessionTickets::createShared());
+
+    auto clientCache = oatpp::mbedtls::client::SessionCache::createShared();
+
+    ConnectionFixture fixture("session-resumption", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+    auto clientProvider = fixture.getClientProvider();
+    clientProvider->setSessionCache(clientCache);
+
+    runConnections(fixture, 1);
+    OATPP_ASSERT(clientCache->getStatistics().size == 1);
+
+    oatpp::async::Executor executor(1, 1, 1);
+
+    ConnectionFixture::AsyncConnection client(executor, [clientProvider] {
+      return clientProvider->getAsync();
+    });
+
+    /* Server drops the connection before the handshake */
+    auto serverConnection = fixture.getServerProvider()->get();
+    OATPP_ASSERT(serverConnection);
+    auto transport = std::static_pointer_cast<oatpp::mbedtls::Connection>(serverConnection.object)->getTransportStream();
+    transport.invalidator->invalidate(transport.object);
+
+    OATPP_ASSERT(!client.wait());
+
+    auto stats = clientCache->getStatistics();
+    OATPP_LOGD(TAG, "offered=%d, resumed=%d, size=%d", (v_int32) stats.offered, (v_int32) stats.resumed, (v_int32) stats.size);
+    OATPP_ASSERT(stats.offered == 1);
+    OATPP_ASSERT(stats.resumed == 0);
+    OATPP_ASSERT(stats.size == 0);
+
+    executor.waitTasksFinished();
+    executor.stop();
+    executor.join();
+
+  }
+
+}
+
+}}}
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#ifndef oatpp_test_mbedtls_SessionResumptionTest_hpp
+#define oatpp_test_mbedtls_SessionResumptionTest_hpp
+
+#include "oatpp-test/UnitTest.hpp"
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+/**
+ * Connect several times to the same server and check that sessions are resumed -
+ * by server session cache and by session tickets. Check that tickets are resumed across servers sharing a key file,
+ * that tickets outlive key rotation but not their lifetime, and that a session refused in a failed handshake is dropped.
+ */
+class SessionResumptionTest : public UnitTest {
+private:
+  v_int32 m_connectionsCount;
+public:
+
+  SessionResumptionTest(v_int32 connectionsCount)
+    : UnitTest("TEST[mbedtls::SessionResumptionTest]")
+    , m_connectionsCount(connectionsCount)
+  {}
+
+  void onRun() override;
+
+};
+
+}}}
+
+#endif /* oatpp_test_mbedtls_SessionResumptionTest_hpp */
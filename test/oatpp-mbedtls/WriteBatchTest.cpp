@@ -0,0 +1,99 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "WriteBatchTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+namespace {
+
+/* Max TLS record: 16 KB of plaintext plus the record header and the cipher expansion */
+constexpr v_int64 MAX_RECORD_SIZE = 16 * 1024 + 5 + 256;
+
+void runTransfer(v_buff_size batchSize) {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setWriteBatchSize(batchSize);
+
+  ConnectionFixture fixture("write-batch", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared(), true);
+
+  std::string payload(200000, '\0');
+  for(size_t i = 0; i < payload.size(); i ++) {
+    payload[i] = (char) ('a' + i % 26);
+  }
+
+  auto server = [&payload, batchSize](const ConnectionHandle& connection) {
+
+    auto transport = ConnectionFixture::getTransport(connection);
+    auto writesBefore = transport->getWritesCount();
+    auto recordsBefore = transport->getRecordsCount();
+
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple(payload.data(), payload.size()) == (v_io_size) payload.size());
+    /* Small write after a large one - goes out with the next batch */
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple("end", 3) == 3);
+    v_char8 ack;
+    OATPP_ASSERT(connection.object->readExactSizeDataSimple(&ack, 1) == 1);
+
+    auto writes = transport->getWritesCount() - writesBefore;
+    auto records = transport->getRecordsCount() - recordsBefore;
+    OATPP_LOGD("[WriteBatchTest::runTransfer()]", "batch=%d, records=%d, transport writes=%d, max write=%d",
+               (v_int32) batchSize, (v_int32) records, (v_int32) writes, (v_int32) transport->getMaxWriteSize());
+
+    if(batchSize >= MAX_RECORD_SIZE) {
+      /* Several records go with one transport write, and a write doesn't exceed the batch */
+      OATPP_ASSERT(writes < records);
+      OATPP_ASSERT(transport->getMaxWriteSize() <= batchSize);
+    } else {
+      /* Records larger than the batch are written directly - one write per record at most */
+      OATPP_ASSERT(writes <= records);
+    }
+
+  };
+
+  auto client = [&payload](const ConnectionHandle& connection) {
+    ConnectionFixture::readMessage(connection, payload + "end");
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple("!", 1) == 1);
+  };
+
+  fixture.run(server, client);
+
+}
+
+}
+
+void WriteBatchTest::onRun() {
+
+  OATPP_LOGD(TAG, "Batch of several records...");
+  runTransfer(65536);
+
+  OATPP_LOGD(TAG, "Batch smaller than a record...");
+  runTransfer(4096);
+
+}
+
+}}}
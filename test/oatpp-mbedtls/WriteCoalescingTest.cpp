@@ -0,0 +1,89 @@
+/***************************************************************************
+ *
+ * Project         _____    __   ____   _      _
+ *                (  _  )  /__\ (_  _)_| |_  _| |_
+ *                 )(_)(  /(__)\  )( (_   _)(_   _)
+ *                (_____)(__)(__)(__)  |_|    |_|
+ *
+ *
+ * Copyright 2018-present, Leonid Stryzhevskyi <lganzzzo@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************************/
+
+#include "WriteCoalescingTest.hpp"
+
+#include "ConnectionFixture.hpp"
+
+#include <string>
+
+namespace oatpp { namespace test { namespace mbedtls {
+
+void WriteCoalescingTest::onRun() {
+
+  auto serverConfig = oatpp::mbedtls::Config::createDefaultServerConfigShared(CERT_CRT_PATH, CERT_PEM_PATH);
+  serverConfig->setWriteCoalescing(16384);
+
+  ConnectionFixture fixture("write-coalescing", serverConfig, oatpp::mbedtls::Config::createDefaultClientConfigShared());
+
+  const v_int32 chunksCount = 50;
+  const std::string chunk = "0123456789";
+
+  std::string chunks;
+  for(v_int32 i = 0; i < chunksCount; i ++) {
+    chunks += chunk;
+  }
+
+  /* Larger than the coalescing size - gathered data goes first, then the chunk as is */
+  const std::string largeChunk(20000, 'x');
+
+  auto server = [&chunk, &largeChunk](const ConnectionHandle& connection) {
+
+    auto tlsConnection = std::static_pointer_cast<oatpp::mbedtls::Connection>(connection.object);
+    OATPP_ASSERT(tlsConnection->getWriteCoalescing() == 16384);
+
+    /* Explicit flush */
+    for(v_int32 i = 0; i < chunksCount; i ++) {
+      OATPP_ASSERT(connection.object->writeSimple(chunk.data(), chunk.size()) == (v_io_size) chunk.size());
+    }
+    OATPP_ASSERT(tlsConnection->getGatheredSize() == chunksCount * (v_buff_size) chunk.size());
+    async::Action action;
+    OATPP_ASSERT(tlsConnection->flush(action) == 0);
+
+    /* Flush before read - the client waits for the reply before it sends the next message */
+    OATPP_ASSERT(connection.object->writeSimple("pong", 4) == 4);
+    ConnectionFixture::readMessage(connection, "ping");
+
+    OATPP_ASSERT(connection.object->writeSimple(chunk.data(), chunk.size()) == (v_io_size) chunk.size());
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple(largeChunk.data(), largeChunk.size()) == (v_io_size) largeChunk.size());
+    OATPP_ASSERT(tlsConnection->flush(action) == 0);
+    OATPP_ASSERT(tlsConnection->getGatheredSize() == 0);
+
+    ConnectionFixture::readMessage(connection, "done");
+
+  };
+
+  auto client = [&chunks, &chunk, &largeChunk](const ConnectionHandle& connection) {
+    ConnectionFixture::readMessage(connection, chunks);
+    ConnectionFixture::readMessage(connection, "pong");
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple("ping", 4) == 4);
+    ConnectionFixture::readMessage(connection, chunk + largeChunk);
+    OATPP_ASSERT(connection.object->writeExactSizeDataSimple("done", 4) == 4);
+  };
+
+  fixture.run(server, client);
+
+}
+
+}}}
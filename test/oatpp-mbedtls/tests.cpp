@@ -4,11 +4,33 @@
 #include "FullTest.hpp"
 #include "FullAsyncTest.hpp"
 #include "FullAsyncClientTest.hpp"
+#include "HandshakeScalingTest.hpp"
+#include "SessionResumptionTest.hpp"
+#include "ConnectionPoolTest.hpp"
+#include "DeadlineTest.hpp"
+#include "EarlyDataTest.hpp"
+#include "CertificateStoreTest.hpp"
+#include "ConfigReloadTest.hpp"
+#include "RandomGeneratorTest.hpp"
+#include "PresetTest.hpp"
+#include "LowMemoryTest.hpp"
+#include "ContextPoolTest.hpp"
+#include "AllocatorTest.hpp"
+#include "IdleConnectionTest.hpp"
+#include "WriteCoalescingTest.hpp"
+#include "WriteBatchTest.hpp"
+#include "ReadAheadTest.hpp"
+#include "EagerHandshakeTest.hpp"
+#include "HandshakeWorkerPoolTest.hpp"
+
+#include "oatpp-mbedtls/Allocator.hpp"
 
 #include "oatpp/core/concurrency/SpinLock.hpp"
 #include "oatpp/core/base/Environment.hpp"
 
 #include <iostream>
+#include <thread>
+#include <cstring>
 
 namespace {
 
@@ -44,14 +66,164 @@ void runTests() {
 
   }
 
+  {
+
+    v_int32 maxThreads = (v_int32) std::thread::hardware_concurrency();
+    if(maxThreads < 1) {
+      maxThreads = 1;
+    }
+
+    oatpp::test::mbedtls::HandshakeScalingTest test(maxThreads, 10);
+    test.run();
+
+    oatpp::test::mbedtls::HandshakeScalingTest test_workers(maxThreads, 10, true);
+    test_workers.run();
+
+    oatpp::test::mbedtls::HandshakeScalingTest test_crypto_workers(maxThreads, 10, false, true);
+    test_crypto_workers.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::SessionResumptionTest test(10);
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::ConnectionPoolTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::DeadlineTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::EarlyDataTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::CertificateStoreTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::ConfigReloadTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::RandomGeneratorTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::PresetTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::LowMemoryTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::ContextPoolTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::AllocatorTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::IdleConnectionTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::WriteCoalescingTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::WriteBatchTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::ReadAheadTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::EagerHandshakeTest test;
+    test.run();
+
+  }
+
+  {
+
+    oatpp::test::mbedtls::HandshakeWorkerPoolTest test;
+    test.run();
+
+  }
+
 }
 
 }
 
-int main() {
+int main(int argc, char* argv[]) {
 
   oatpp::base::Environment::init();
 
+  /*
+   * Suite runs twice - on the default Mbed TLS allocator, and with '--allocator' on the module allocator.
+   * Allocator can't be uninstalled, so it's one process per run. It must be installed before the first Config is created.
+   */
+  if(argc > 1 && std::strcmp(argv[1], "--allocator") == 0) {
+    if(!oatpp::mbedtls::Allocator::isAvailable()) {
+      std::cout << "Mbed TLS is built without MBEDTLS_PLATFORM_MEMORY. Allocator run is skipped.\n";
+      oatpp::base::Environment::destroy();
+      return 0;
+    }
+    oatpp::mbedtls::Allocator::install();
+  }
+
   runTests();
 
   /* Print how much objects were created during app running, and what have left-probably leaked */
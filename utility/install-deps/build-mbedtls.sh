@@ -5,9 +5,20 @@ rm -rf tmp
 mkdir tmp
 cd tmp
 
-git clone -b 'mbedtls-2.16.3' --single-branch --depth 1 --recurse-submodules https://github.com/ARMmbed/mbedtls
+git clone -b 'v3.6.2' --single-branch --depth 1 --recurse-submodules https://github.com/Mbed-TLS/mbedtls
 
 cd mbedtls
+
+# handshakes of connections sharing one config run concurrently; server private key operations may be offloaded;
+# TLS 1.3 early data is opt-in; record buffers shrink to the negotiated max fragment length after handshake;
+# heap allocator can be replaced
+python3 scripts/config.py set MBEDTLS_THREADING_C
+python3 scripts/config.py set MBEDTLS_THREADING_PTHREAD
+python3 scripts/config.py set MBEDTLS_SSL_ASYNC_PRIVATE
+python3 scripts/config.py set MBEDTLS_SSL_EARLY_DATA
+python3 scripts/config.py set MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+python3 scripts/config.py set MBEDTLS_PLATFORM_MEMORY
+
 mkdir build && cd build
 
 cmake -DCMAKE_INSTALL_PREFIX:PATH=../../mbedtls-build ..